@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "popcount.h"
+
+
+/*
+ * Times each popcount kernel the CPU supports, on buffers that fit in the
+ * L1 cache, the L2 cache and neither, and prints the rate in GB/s.  Before
+ * that, every kernel is checked against the portable one on every length
+ * up to a few vectors, at every alignment.
+ */
+
+
+/* Each timing counts at least this many bytes, however small the buffer. */
+#define BYTES_PER_TIMING (256 * 1024 * 1024)
+#define DEFAULT_REPEATS 5
+
+static size_t buffer_sizes[] = { 4 * 1024, 256 * 1024, 64 * 1024 * 1024 };
+#define NUM_SIZES ((int) (sizeof(buffer_sizes) / sizeof(buffer_sizes[0])))
+
+
+typedef struct kernel {
+    const char *name;
+    size_t (*count)(const void *, size_t);
+    int (*supported)(void);
+} kernel;
+
+static int always(void) {
+    return 1;
+}
+
+static const kernel kernels[] = {
+    { "portable", popcount_portable, always },
+    { "popcnt", popcount_popcnt, popcount_has_popcnt },
+    { "avx2", popcount_avx2, popcount_has_avx2 },
+    { "avx512", popcount_avx512, popcount_has_avx512 },
+    { "dispatch", popcount_buffer, always },
+};
+
+#define NUM_KERNELS ((int) (sizeof(kernels) / sizeof(kernels[0])))
+
+
+static double seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+/* Random bytes; the counts don't depend on the data, but a check does. */
+static unsigned char * random_buffer(size_t size) {
+    unsigned char *buffer = malloc(size);
+    unsigned int seed = 1;
+    size_t i;
+
+    if (buffer == NULL) {
+        fprintf(stderr, "popbench: couldn't allocate %zu bytes\n", size);
+        exit(1);
+    }
+    for (i = 0; i < size; i++)
+        buffer[i] = (unsigned char) rand_r(&seed);
+    return buffer;
+}
+
+
+/*
+ * Compares each kernel with the portable one at every offset into a
+ * 64-byte line and every length up to 2048 bytes, which covers every path
+ * through the vector loops and their tails.  Returns the number of
+ * mismatches.
+ */
+static int check_kernels(const unsigned char *buffer) {
+    size_t offset, length, expected, got;
+    int errors = 0, k;
+
+    for (k = 1; k < NUM_KERNELS; k++) {
+        if (!kernels[k].supported())
+            continue;
+        for (offset = 0; offset < 64; offset++) {
+            for (length = 0; length <= 2048; length++) {
+                expected = popcount_portable(buffer + offset, length);
+                got = kernels[k].count(buffer + offset, length);
+                if (got != expected) {
+                    if (errors < 5)
+                        printf("%s: offset %zu length %zu gave %zu, not %zu\n",
+                               kernels[k].name, offset, length, got,
+                               expected);
+                    errors++;
+                }
+            }
+        }
+    }
+    return errors;
+}
+
+
+/* Returns the best rate in GB/s over "repeats" timings. */
+static double rate(const kernel *kern, const unsigned char *buffer,
+                   size_t size, int repeats) {
+    size_t passes = BYTES_PER_TIMING / size, pass;
+    volatile size_t sink = 0;
+    double best = 0, start, elapsed;
+    int r;
+
+    if (passes == 0)
+        passes = 1;
+
+    for (r = 0; r < repeats; r++) {
+        start = seconds();
+        for (pass = 0; pass < passes; pass++)
+            sink += kern->count(buffer, size);
+        elapsed = seconds() - start;
+        if (r == 0 || elapsed < best)
+            best = elapsed;
+    }
+    (void) sink;
+    return (double) passes * size / best / 1e9;
+}
+
+
+static void usage(char *program) {
+    fprintf(stderr, "usage: %s [-r repeats]\n", program);
+    fprintf(stderr, "\tChecks and times each popcount kernel this CPU "
+            "supports.\n");
+}
+
+
+int main(int argc, char **argv) {
+    size_t largest = buffer_sizes[NUM_SIZES - 1];
+    int repeats = DEFAULT_REPEATS;
+    unsigned char *buffer;
+    int errors, k, s, c;
+
+    while ((c = getopt(argc, argv, "r:")) != -1) {
+        if (c != 'r' || (repeats = atoi(optarg)) < 1) {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    buffer = random_buffer(largest);
+
+    errors = check_kernels(buffer);
+    if (errors != 0) {
+        printf("Kernel check FAIL (%d mismatches).\n", errors);
+        return 1;
+    }
+    printf("Kernel check PASS.\n\n");
+
+    printf("%-10s", "kernel");
+    for (s = 0; s < NUM_SIZES; s++)
+        printf("  %9zu KB", buffer_sizes[s] / 1024);
+    printf("\n");
+
+    for (k = 0; k < NUM_KERNELS; k++) {
+        printf("%-10s", kernels[k].name);
+        if (!kernels[k].supported()) {
+            printf("  (not supported by this CPU)\n");
+            continue;
+        }
+        for (s = 0; s < NUM_SIZES; s++) {
+            printf("  %7.2f GB/s",
+                   rate(&kernels[k], buffer, buffer_sizes[s], repeats));
+            fflush(stdout);
+        }
+        printf("\n");
+    }
+
+    free(buffer);
+    return 0;
+}
@@ -0,0 +1,285 @@
+#include "popcount.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <immintrin.h>
+
+
+/*
+ * Bulk popcount.  Every kernel counts the buffer in 64-bit words, loaded
+ * with memcpy() so the buffer needn't be aligned, and finishes the last few
+ * bytes one at a time.  The vector kernels handle as much of the buffer as
+ * they can in whole vectors first.
+ */
+
+
+/* The four registers CPUID returns; see popcount_cpuid.s. */
+typedef struct cpuid_regs {
+    unsigned int eax;
+    unsigned int ebx;
+    unsigned int ecx;
+    unsigned int edx;
+} cpuid_regs;
+
+void popcount_cpuid(unsigned int eax, unsigned int ecx, cpuid_regs *regs);
+unsigned long long popcount_xgetbv(void);
+
+
+static inline uint64_t load_word(const unsigned char *p) {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    return word;
+}
+
+
+/*
+ * The portable kernel counts each word with the usual shifts and masks:
+ * first the bits in each pair, then each nibble, then each byte, and the
+ * multiply adds the eight byte counts together into the top byte.
+ */
+static inline unsigned int popcount_word(uint64_t x) {
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (unsigned int) ((x * 0x0101010101010101ULL) >> 56);
+}
+
+size_t popcount_portable(const void *data, size_t length) {
+    const unsigned char *p = data;
+    size_t count = 0, i;
+
+    for (i = 0; i + 8 <= length; i += 8)
+        count += popcount_word(load_word(p + i));
+    for (; i < length; i++)
+        count += popcount_word(p[i]);
+    return count;
+}
+
+
+/*
+ * The POPCNT kernel.  Four counts are kept, so that four POPCNTs can be
+ * running at once instead of each waiting on the last one's add.
+ */
+__attribute__((target("popcnt")))
+static size_t popcnt_words(const unsigned char *p, size_t length) {
+    uint64_t c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+    size_t i;
+
+    for (i = 0; i + 32 <= length; i += 32) {
+        c0 += __builtin_popcountll(load_word(p + i));
+        c1 += __builtin_popcountll(load_word(p + i + 8));
+        c2 += __builtin_popcountll(load_word(p + i + 16));
+        c3 += __builtin_popcountll(load_word(p + i + 24));
+    }
+    for (; i + 8 <= length; i += 8)
+        c0 += __builtin_popcountll(load_word(p + i));
+    for (; i < length; i++)
+        c0 += __builtin_popcount(p[i]);
+    return c0 + c1 + c2 + c3;
+}
+
+__attribute__((target("popcnt")))
+size_t popcount_popcnt(const void *data, size_t length) {
+    return popcnt_words(data, length);
+}
+
+
+/*
+ * The AVX2 kernel is the Harley-Seal method.  A carry-save adder takes
+ * three vectors of bits, and gives back a vector of the sums and a vector
+ * of the carries, each bit position on its own.  Feeding 16 vectors
+ * through a tree of them gives one vector of 16s with the carries out of
+ * the top, plus running vectors of 1s, 2s, 4s and 8s, so only one vector
+ * in 16 needs its bits counted.
+ *
+ * That count uses a nibble lookup:  VPSHUFB looks up the number of bits in
+ * each nibble from a 16-entry table, and VPSADBW adds the byte counts up
+ * into the four 64-bit lanes.
+ */
+
+__attribute__((target("avx2")))
+static inline __m256i popcount_256(__m256i v) {
+    const __m256i lookup = _mm256_setr_epi8(
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    __m256i lo = _mm256_and_si256(v, low_mask);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+    __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+                                    _mm256_shuffle_epi8(lookup, hi));
+
+    return _mm256_sad_epu8(bytes, _mm256_setzero_si256());
+}
+
+/* A carry-save adder of a, b and c, into *sum and *carry. */
+__attribute__((target("avx2")))
+static inline void csa(__m256i *carry, __m256i *sum,
+                       __m256i a, __m256i b, __m256i c) {
+    __m256i u = _mm256_xor_si256(a, b);
+
+    *carry = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(u, c));
+    *sum = _mm256_xor_si256(u, c);
+}
+
+#define LOAD_256(p, k) _mm256_loadu_si256((const __m256i *) (p) + (k))
+
+__attribute__((target("avx2,popcnt")))
+size_t popcount_avx2(const void *data, size_t length) {
+    const unsigned char *p = data;
+    __m256i total = _mm256_setzero_si256();
+    __m256i ones = total, twos = total, fours = total, eights = total;
+    __m256i sixteens, twos_a, twos_b, fours_a, fours_b, eights_a, eights_b;
+    uint64_t lanes[4];
+    size_t i = 0;
+
+    for (; i + 16 * 32 <= length; i += 16 * 32) {
+        csa(&twos_a, &ones, ones, LOAD_256(p + i, 0), LOAD_256(p + i, 1));
+        csa(&twos_b, &ones, ones, LOAD_256(p + i, 2), LOAD_256(p + i, 3));
+        csa(&fours_a, &twos, twos, twos_a, twos_b);
+        csa(&twos_a, &ones, ones, LOAD_256(p + i, 4), LOAD_256(p + i, 5));
+        csa(&twos_b, &ones, ones, LOAD_256(p + i, 6), LOAD_256(p + i, 7));
+        csa(&fours_b, &twos, twos, twos_a, twos_b);
+        csa(&eights_a, &fours, fours, fours_a, fours_b);
+        csa(&twos_a, &ones, ones, LOAD_256(p + i, 8), LOAD_256(p + i, 9));
+        csa(&twos_b, &ones, ones, LOAD_256(p + i, 10), LOAD_256(p + i, 11));
+        csa(&fours_a, &twos, twos, twos_a, twos_b);
+        csa(&twos_a, &ones, ones, LOAD_256(p + i, 12), LOAD_256(p + i, 13));
+        csa(&twos_b, &ones, ones, LOAD_256(p + i, 14), LOAD_256(p + i, 15));
+        csa(&fours_b, &twos, twos, twos_a, twos_b);
+        csa(&eights_b, &fours, fours, fours_a, fours_b);
+        csa(&sixteens, &eights, eights, eights_a, eights_b);
+
+        total = _mm256_add_epi64(total, popcount_256(sixteens));
+    }
+
+    // weigh each running vector by the place it stands for
+    total = _mm256_slli_epi64(total, 4);
+    total = _mm256_add_epi64(total,
+                             _mm256_slli_epi64(popcount_256(eights), 3));
+    total = _mm256_add_epi64(total,
+                             _mm256_slli_epi64(popcount_256(fours), 2));
+    total = _mm256_add_epi64(total,
+                             _mm256_slli_epi64(popcount_256(twos), 1));
+    total = _mm256_add_epi64(total, popcount_256(ones));
+
+    for (; i + 32 <= length; i += 32)
+        total = _mm256_add_epi64(total, popcount_256(LOAD_256(p + i, 0)));
+
+    _mm256_storeu_si256((__m256i *) lanes, total);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+           popcnt_words(p + i, length - i);
+}
+
+
+/*
+ * The AVX-512 kernel has an instruction that does the whole job:
+ * VPOPCNTQ counts the bits in each of eight 64-bit lanes.  Four
+ * accumulators keep four of them in flight.
+ */
+
+#define LOAD_512(p, k) _mm512_loadu_si512((const __m512i *) (p) + (k))
+
+__attribute__((target("avx512f,avx512vpopcntdq,popcnt")))
+size_t popcount_avx512(const void *data, size_t length) {
+    const unsigned char *p = data;
+    __m512i c0 = _mm512_setzero_si512(), c1 = c0, c2 = c0, c3 = c0;
+    size_t i = 0;
+
+    for (; i + 4 * 64 <= length; i += 4 * 64) {
+        c0 = _mm512_add_epi64(c0, _mm512_popcnt_epi64(LOAD_512(p + i, 0)));
+        c1 = _mm512_add_epi64(c1, _mm512_popcnt_epi64(LOAD_512(p + i, 1)));
+        c2 = _mm512_add_epi64(c2, _mm512_popcnt_epi64(LOAD_512(p + i, 2)));
+        c3 = _mm512_add_epi64(c3, _mm512_popcnt_epi64(LOAD_512(p + i, 3)));
+    }
+    for (; i + 64 <= length; i += 64)
+        c0 = _mm512_add_epi64(c0, _mm512_popcnt_epi64(LOAD_512(p + i, 0)));
+
+    c0 = _mm512_add_epi64(_mm512_add_epi64(c0, c1), _mm512_add_epi64(c2, c3));
+    return _mm512_reduce_add_epi64(c0) + popcnt_words(p + i, length - i);
+}
+
+
+/*
+ * Feature checks.  A vector kernel needs both the CPU to have the
+ * instructions, and the OS to save the vector registers on a context
+ * switch, which it reports in XCR0.
+ */
+
+#define CPUID_1_ECX_POPCNT   (1u << 23)
+#define CPUID_1_ECX_OSXSAVE  (1u << 27)
+#define CPUID_1_ECX_AVX      (1u << 28)
+#define CPUID_7_EBX_AVX2     (1u << 5)
+#define CPUID_7_EBX_AVX512F  (1u << 16)
+#define CPUID_7_ECX_VPOPCNTDQ (1u << 14)
+
+#define XCR0_YMM    0x06    /* XMM and the upper halves of YMM. */
+#define XCR0_ZMM    0xe6    /* ...and the opmasks and all of ZMM. */
+
+
+/* Fills in leaves 1 and 7, or zeroes leaf 7 if the CPU hasn't got it. */
+static void read_features(cpuid_regs *leaf1, cpuid_regs *leaf7) {
+    cpuid_regs leaf0;
+
+    popcount_cpuid(0, 0, &leaf0);
+    popcount_cpuid(1, 0, leaf1);
+    if (leaf0.eax >= 7)
+        popcount_cpuid(7, 0, leaf7);
+    else
+        memset(leaf7, 0, sizeof(cpuid_regs));
+}
+
+/* Returns nonzero if the OS saves all of the state bits in "mask". */
+static int os_saves(const cpuid_regs *leaf1, unsigned long long mask) {
+    if (!(leaf1->ecx & CPUID_1_ECX_OSXSAVE))
+        return 0;
+    return (popcount_xgetbv() & mask) == mask;
+}
+
+
+int popcount_has_popcnt(void) {
+    cpuid_regs leaf1, leaf7;
+
+    read_features(&leaf1, &leaf7);
+    return (leaf1.ecx & CPUID_1_ECX_POPCNT) != 0;
+}
+
+
+int popcount_has_avx2(void) {
+    cpuid_regs leaf1, leaf7;
+
+    read_features(&leaf1, &leaf7);
+    return (leaf1.ecx & CPUID_1_ECX_POPCNT) &&
+           (leaf1.ecx & CPUID_1_ECX_AVX) &&
+           (leaf7.ebx & CPUID_7_EBX_AVX2) &&
+           os_saves(&leaf1, XCR0_YMM);
+}
+
+
+int popcount_has_avx512(void) {
+    cpuid_regs leaf1, leaf7;
+
+    read_features(&leaf1, &leaf7);
+    return (leaf1.ecx & CPUID_1_ECX_POPCNT) &&
+           (leaf7.ebx & CPUID_7_EBX_AVX512F) &&
+           (leaf7.ecx & CPUID_7_ECX_VPOPCNTDQ) &&
+           os_saves(&leaf1, XCR0_ZMM);
+}
+
+
+/* The kernel popcount_buffer() uses, chosen before main() runs. */
+static size_t (*popcount_impl)(const void *, size_t) = popcount_portable;
+
+__attribute__((constructor))
+static void popcount_init(void) {
+    if (popcount_has_avx512())
+        popcount_impl = popcount_avx512;
+    else if (popcount_has_avx2())
+        popcount_impl = popcount_avx2;
+    else if (popcount_has_popcnt())
+        popcount_impl = popcount_popcnt;
+}
+
+
+size_t popcount_buffer(const void *data, size_t length) {
+    return popcount_impl(data, length);
+}
@@ -0,0 +1,28 @@
+#ifndef POPCOUNT_H
+#define POPCOUNT_H
+
+#include <stddef.h>
+
+
+/*
+ * Counting the one-bits in a whole buffer.  popcount_buffer() uses the
+ * fastest kernel the CPU supports, chosen once at program startup.
+ */
+size_t popcount_buffer(const void *data, size_t length);
+
+
+/*
+ * The kernels popcount_buffer() chooses between.  Each one but the portable
+ * kernel may only be called if the matching popcount_has_*() function
+ * returns nonzero.
+ */
+size_t popcount_portable(const void *data, size_t length);
+size_t popcount_popcnt(const void *data, size_t length);
+size_t popcount_avx2(const void *data, size_t length);
+size_t popcount_avx512(const void *data, size_t length);
+
+int popcount_has_popcnt(void);
+int popcount_has_avx2(void);
+int popcount_has_avx512(void);
+
+#endif /* POPCOUNT_H */
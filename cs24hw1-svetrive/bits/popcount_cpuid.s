@@ -0,0 +1,49 @@
+.text
+
+
+#=============================================================================
+# void popcount_cpuid(unsigned int eax, unsigned int ecx, cpuid_regs *regs)
+#
+#     Invokes the CPUID instruction with %eax and %ecx set to the specified
+#     values, and stores the four result registers into regs.  Leaf 7 needs
+#     %ecx to be 0 to give the main feature flags.
+#
+.globl popcount_cpuid
+popcount_cpuid:
+    pushq %rbx               # cpuid clobbers rbx, which is callee-save
+
+    # cpuid also overwrites rdx, so keep the regs pointer somewhere else.
+    movq %rdx, %r8
+    movl %edi, %eax
+    movl %esi, %ecx
+    cpuid
+
+    movl %eax,   (%r8)
+    movl %ebx,  4(%r8)
+    movl %ecx,  8(%r8)
+    movl %edx, 12(%r8)
+
+    popq %rbx
+    ret
+
+
+#=============================================================================
+# unsigned long long popcount_xgetbv(void)
+#
+#     Returns XCR0, which says which register state the OS saves and restores
+#     on a context switch.  Only call this if CPUID leaf 1 reports OSXSAVE.
+#
+.globl popcount_xgetbv
+popcount_xgetbv:
+    xorl %ecx, %ecx
+    xgetbv
+
+    # The result is split across edx:eax; put it back together in rax.
+    shlq $32, %rdx
+    movl %eax, %eax
+    orq  %rdx, %rax
+    ret
+
+
+# The stack doesn't need to be executable.
+.section .note.GNU-stack, "", @progbits
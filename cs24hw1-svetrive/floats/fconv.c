@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "ffunc.h"
+
+
+/* Converts float files between the text format fsum reads and the binary
+ * float format described in ffunc.h.  Text output prints every value with
+ * 9 significant digits, which is enough to read back the same float.
+ */
+
+
+static void usage(char *program) {
+    fprintf(stderr, "usage: %s [-t] input output\n", program);
+    fprintf(stderr, "\tConverts a text float file to the binary format,\n");
+    fprintf(stderr, "\tor with -t, any float file to text.\n");
+}
+
+
+static int save_floats_text(const char *filename, const FloatArray *floats) {
+    FILE *output = fopen(filename, "w");
+    int i, ok;
+
+    if (output == NULL)
+        return -1;
+
+    ok = fprintf(output, "%d\n", floats->count) > 0;
+    for (i = 0; ok && i < floats->count; i++)
+        ok = fprintf(output, "%.9g\n", floats->values[i]) > 0;
+
+    if (fclose(output) != 0)
+        ok = 0;
+    return ok ? 0 : -1;
+}
+
+
+int main(int argc, char **argv) {
+    FloatArray floats;
+    int to_text = 0;
+    int c, result;
+
+    while ((c = getopt(argc, argv, "t")) != -1) {
+        if (c != 't') {
+            usage(argv[0]);
+            return 1;
+        }
+        to_text = 1;
+    }
+    if (argc - optind != 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    load_floats_file(argv[optind], &floats);
+
+    if (to_text)
+        result = save_floats_text(argv[optind + 1], &floats);
+    else
+        result = save_floats_binary(argv[optind + 1], &floats);
+
+    if (result != 0) {
+        fprintf(stderr, "%s: couldn't write %s\n", argv[0], argv[optind + 1]);
+        return 1;
+    }
+    return 0;
+}
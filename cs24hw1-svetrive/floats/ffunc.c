@@ -1,9 +1,16 @@
 #include "ffunc.h"
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <assert.h>
+#include <ctype.h>
+#include <float.h>
 #include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 
 /* Load a sequence of floating-point values from the specified
@@ -59,6 +66,286 @@ void load_floats(FILE *input, FloatArray *floats) {
 }
 
 
+/* Exact powers of ten as doubles.  10^22 is the largest one a double can
+ * hold exactly.
+ */
+static const double pow10_exact[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+#define MAX_FAST_POW10 22
+
+
+/* Parses the decimal number in the "length" characters at "text" into
+ * *value, the way strtof() would, and returns nonzero on success.
+ *
+ * The common case is handled without strtof().  A number with at most 15
+ * significant digits is an integer below 2^53 times a power of ten, and if
+ * that power is at most 10^22, both are exact doubles, so a single multiply
+ * or divide gives the correctly rounded double.  Rounding that to a float
+ * is only wrong when the double sits exactly halfway between two floats,
+ * and the true value didn't.  That case, subnormal and out of range
+ * results, and anything that isn't a plain decimal number ("inf", "nan",
+ * hex floats, too many digits) are all left to strtof().
+ */
+static int parse_float(const char *text, int length, float *value) {
+    const char *p = text, *end = text + length;
+    uint64_t mantissa = 0, bits;
+    int digits = 0, exponent = 0, exp_value = 0, exp_negative = 0;
+    int negative = 0, seen_digit = 0;
+    char buffer[64];
+    char *stop;
+    double d;
+
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = (*p++ == '-');
+
+    for (; p < end && isdigit((unsigned char) *p); p++) {
+        seen_digit = 1;
+        if (mantissa == 0 && *p == '0')
+            continue;
+        mantissa = 10 * mantissa + (*p - '0');
+        digits++;
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && isdigit((unsigned char) *p); p++) {
+            seen_digit = 1;
+            exponent--;
+            if (mantissa == 0 && *p == '0')
+                continue;
+            mantissa = 10 * mantissa + (*p - '0');
+            digits++;
+        }
+    }
+    if (seen_digit && p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        if (p < end && (*p == '-' || *p == '+'))
+            exp_negative = (*p++ == '-');
+        if (p == end || !isdigit((unsigned char) *p))
+            goto slow;
+        for (; p < end && isdigit((unsigned char) *p); p++) {
+            if (exp_value < 10000)
+                exp_value = 10 * exp_value + (*p - '0');
+        }
+        exponent += exp_negative ? -exp_value : exp_value;
+    }
+
+    if (!seen_digit || p != end || digits > 15)
+        goto slow;
+
+    if (mantissa == 0) {
+        *value = negative ? -0.0f : 0.0f;
+        return 1;
+    }
+    if (exponent < -MAX_FAST_POW10 || exponent > MAX_FAST_POW10)
+        goto slow;
+
+    if (exponent < 0)
+        d = (double) mantissa / pow10_exact[-exponent];
+    else
+        d = (double) mantissa * pow10_exact[exponent];
+
+    // halfway between two floats:  the 29 bits a float drops are 1000...0
+    memcpy(&bits, &d, sizeof(bits));
+    if (d < FLT_MIN || d > FLT_MAX || (bits & 0x1fffffff) == 0x10000000)
+        goto slow;
+
+    *value = negative ? (float) -d : (float) d;
+    return 1;
+
+slow:
+    if (length >= (int) sizeof(buffer))
+        return 0;
+    memcpy(buffer, text, length);
+    buffer[length] = '\0';
+    *value = strtof(buffer, &stop);
+    return stop == buffer + length;
+}
+
+
+/* Steps past whitespace, then returns the length of the token at *pos. */
+static int next_token(const char **pos, const char *end) {
+    const char *p = *pos, *start;
+
+    while (p < end && isspace((unsigned char) *p))
+        p++;
+    start = p;
+    while (p < end && !isspace((unsigned char) *p))
+        p++;
+    *pos = start;
+    return p - start;
+}
+
+
+/* Loads a text file in the load_floats() format from a mapping of the
+ * whole file.  Anything after the last value, such as the accurate sum at
+ * the end of f1.txt through f4.txt, is ignored just as load_floats()
+ * ignores it.
+ */
+static void parse_float_text(const char *text, size_t size,
+                             FloatArray *floats) {
+    const char *pos = text, *end = text + size;
+    float *values;
+    char buffer[32];
+    char *stop;
+    long count;
+    int length, i;
+
+    length = next_token(&pos, end);
+    if (length == 0 || length >= (int) sizeof(buffer)) {
+        printf("Error:  couldn't read count from input list\n");
+        exit(1);
+    }
+    memcpy(buffer, pos, length);
+    buffer[length] = '\0';
+    count = strtol(buffer, &stop, 10);
+    if (stop != buffer + length || count > INT32_MAX) {
+        printf("Error:  couldn't read count from input list\n");
+        exit(1);
+    }
+    pos += length;
+
+    if (count <= 0) {
+        printf("ERROR:  count must be positive; got %ld\n", count);
+        exit(1);
+    }
+
+    values = malloc(count * sizeof(float));
+    if (values == NULL) {
+        printf("ERROR:  couldn't allocate %u bytes!\n",
+               (unsigned int) (count * sizeof(float)));
+        exit(1);
+    }
+
+    for (i = 0; i < count; i++) {
+        length = next_token(&pos, end);
+        if (length == 0 || !parse_float(pos, length, &values[i])) {
+            printf("ERROR:  couldn't read a value from input list\n");
+            exit(1);
+        }
+        pos += length;
+    }
+
+    floats->count = (int) count;
+    floats->values = values;
+}
+
+
+/* Points the array at the values in a mapped binary float file.  The
+ * mapping is private, so sorting the values in place only copies the
+ * pages it touches, and the file itself is never changed.
+ */
+static void map_float_binary(unsigned char *data, size_t size,
+                             FloatArray *floats) {
+    uint32_t count;
+
+    count = (uint32_t) data[4] | (uint32_t) data[5] << 8 |
+            (uint32_t) data[6] << 16 | (uint32_t) data[7] << 24;
+    if (count == 0 || count > INT32_MAX ||
+        count > (size - FLOAT_BINARY_HEADER) / sizeof(float)) {
+        printf("ERROR:  binary float file is damaged\n");
+        exit(1);
+    }
+
+    floats->count = (int) count;
+    floats->values = (float *) (data + FLOAT_BINARY_HEADER);
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    {
+        uint32_t bits;
+        int i;
+
+        for (i = 0; i < floats->count; i++) {
+            memcpy(&bits, &floats->values[i], sizeof(bits));
+            bits = __builtin_bswap32(bits);
+            memcpy(&floats->values[i], &bits, sizeof(bits));
+        }
+    }
+#endif
+}
+
+
+/* Load the floating-point values in the named file, which may either be
+ * in the text format load_floats() reads, or in the binary float format.
+ * The file is mapped into memory rather than read.
+ */
+void load_floats_file(const char *filename, FloatArray *floats) {
+    unsigned char *data;
+    struct stat info;
+    int fd;
+
+    assert(filename != NULL);
+    assert(floats != NULL);
+
+    fd = open(filename, O_RDONLY);
+    if (fd == -1 || fstat(fd, &info) == -1) {
+        printf("ERROR:  couldn't open %s\n", filename);
+        exit(1);
+    }
+    if (info.st_size == 0) {
+        printf("Error:  couldn't read count from input list\n");
+        exit(1);
+    }
+
+    data = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        printf("ERROR:  couldn't map %s\n", filename);
+        exit(1);
+    }
+    madvise(data, info.st_size, MADV_SEQUENTIAL);
+
+    if (info.st_size >= FLOAT_BINARY_HEADER &&
+        memcmp(data, FLOAT_BINARY_TAG, 4) == 0) {
+        map_float_binary(data, info.st_size, floats);
+        return;
+    }
+
+    parse_float_text((const char *) data, info.st_size, floats);
+    munmap(data, info.st_size);
+}
+
+
+/* Write the values to the named file in the binary float format.  Returns
+ * 0 on success, or -1 if the file couldn't be written.
+ */
+int save_floats_binary(const char *filename, const FloatArray *floats) {
+    unsigned char header[FLOAT_BINARY_HEADER];
+    uint32_t count, bits;
+    FILE *output;
+    int i, ok;
+
+    assert(filename != NULL);
+    assert(floats != NULL);
+
+    output = fopen(filename, "wb");
+    if (output == NULL)
+        return -1;
+
+    count = (uint32_t) floats->count;
+    memcpy(header, FLOAT_BINARY_TAG, 4);
+    header[4] = count & 0xff;
+    header[5] = (count >> 8) & 0xff;
+    header[6] = (count >> 16) & 0xff;
+    header[7] = count >> 24;
+    ok = fwrite(header, 1, sizeof(header), output) == sizeof(header);
+
+    for (i = 0; ok && i < floats->count; i++) {
+        memcpy(&bits, &floats->values[i], sizeof(bits));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        bits = __builtin_bswap32(bits);
+#endif
+        ok = fwrite(&bits, sizeof(bits), 1, output) == 1;
+    }
+
+    if (fclose(output) != 0)
+        ok = 0;
+    return ok ? 0 : -1;
+}
+
+
 /* This comparison function can be used with the qsort() utility function
  * to order an array of floating-point values by increasing magnitude.  The
  * comparison function must return a negative value if arg 1 < arg 2,
@@ -93,10 +380,119 @@ int cmp_dec_fmag(const void *pf1, const void *pf2) {
 }
 
 
+/* Radix sort by magnitude.
+ *
+ * With the sign bit masked off, the bits of a float order the same way as
+ * its magnitude:  the exponent is above the mantissa, and both are plain
+ * unsigned integers.  So the values can be sorted by those 31 bits with an
+ * LSD radix sort, in three passes of RADIX_BITS bits, least significant
+ * first.  The histograms for all three passes are counted in one read of
+ * the input, and a pass is skipped when every value has the same digit
+ * there, as the top digit often does.
+ *
+ * Complementing the key sorts by decreasing magnitude instead.  Each pass
+ * is stable, so values of equal magnitude keep their input order both
+ * ways.
+ */
+
+#define RADIX_BITS 11
+#define RADIX_SIZE (1 << RADIX_BITS)
+#define RADIX_PASSES 3
+
+
+static inline uint32_t magnitude_key(float value, uint32_t flip) {
+    uint32_t bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+    return (bits ^ flip) & 0x7fffffff;
+}
+
+
+/* Sorts the values by magnitude with "flip" 0, or by decreasing magnitude
+ * with "flip" all ones.  Returns -1, without changing anything, if the
+ * scratch array can't be allocated.
+ */
+static int radix_sort_magnitude(float *values, int count, uint32_t flip) {
+    int counts[RADIX_PASSES][RADIX_SIZE];
+    float *scratch, *from, *to, *swap;
+    int pass, shift, digit, offset, total, i;
+    uint32_t key;
+
+    if (count < 2)
+        return 0;
+
+    scratch = malloc(count * sizeof(float));
+    if (scratch == NULL)
+        return -1;
+
+    memset(counts, 0, sizeof(counts));
+    for (i = 0; i < count; i++) {
+        key = magnitude_key(values[i], flip);
+        counts[0][key & (RADIX_SIZE - 1)]++;
+        counts[1][(key >> RADIX_BITS) & (RADIX_SIZE - 1)]++;
+        counts[2][key >> (2 * RADIX_BITS)]++;
+    }
+
+    from = values;
+    to = scratch;
+    for (pass = 0; pass < RADIX_PASSES; pass++) {
+        shift = pass * RADIX_BITS;
+
+        // every value has the same digit here, so the pass changes nothing
+        digit = (magnitude_key(from[0], flip) >> shift) & (RADIX_SIZE - 1);
+        if (counts[pass][digit] == count)
+            continue;
+
+        // turn the counts into the index each digit's values start at
+        total = 0;
+        for (digit = 0; digit < RADIX_SIZE; digit++) {
+            offset = counts[pass][digit];
+            counts[pass][digit] = total;
+            total += offset;
+        }
+
+        for (i = 0; i < count; i++) {
+            digit = (magnitude_key(from[i], flip) >> shift) & (RADIX_SIZE - 1);
+            to[counts[pass][digit]++] = from[i];
+        }
+
+        swap = from;
+        from = to;
+        to = swap;
+    }
+
+    if (from != values)
+        memcpy(values, from, count * sizeof(float));
+    free(scratch);
+    return 0;
+}
+
+
 /* This helper function sorts the input float-array by increasing magnitude,
- * using the qsort() utility function and the cmp_inc_fmag comparison function.
+ * with a radix sort on the bits of the values.  If there isn't memory for
+ * the radix sort's scratch array, it falls back to qsort().
  */
 void sort_incmag(FloatArray *floats) {
+    assert(floats != NULL);
+    if (radix_sort_magnitude(floats->values, floats->count, 0) != 0)
+        sort_incmag_qsort(floats);
+}
+
+
+/* This helper function sorts the input float-array by decreasing magnitude,
+ * the same way as sort_incmag().
+ */
+void sort_decmag(FloatArray *floats) {
+    assert(floats != NULL);
+    if (radix_sort_magnitude(floats->values, floats->count, ~0u) != 0)
+        sort_decmag_qsort(floats);
+}
+
+
+/* This helper function sorts the input float-array by increasing magnitude,
+ * using the qsort() utility function and the cmp_inc_fmag comparison function.
+ */
+void sort_incmag_qsort(FloatArray *floats) {
     assert(floats != NULL);
     qsort(floats->values, floats->count, sizeof(float), cmp_inc_fmag);
 }
@@ -105,7 +501,7 @@ void sort_incmag(FloatArray *floats) {
 /* This helper function sorts the input float-array by decreasing magnitude,
  * using the qsort() utility function and the cmp_dec_fmag comparison function.
  */
-void sort_decmag(FloatArray *floats) {
+void sort_decmag_qsort(FloatArray *floats) {
     assert(floats != NULL);
     qsort(floats->values, floats->count, sizeof(float), cmp_dec_fmag);
 }
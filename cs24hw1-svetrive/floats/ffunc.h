@@ -14,9 +14,29 @@ typedef struct FloatArray {
 } FloatArray;
 
 
+/* The binary float format:  the 4 bytes of FLOAT_BINARY_TAG, the number
+ * of values as a 32-bit little-endian integer, and then the values as
+ * little-endian IEEE single-precision floats.
+ */
+#define FLOAT_BINARY_TAG "\0FLT"
+#define FLOAT_BINARY_HEADER 8
+
+
 void load_floats(FILE *input, FloatArray *floats);
 
+/* Load a text or binary float file by mapping it.  Text is parsed without
+ * stdio; binary values are used where they sit in the mapping, so they
+ * must not be passed to free().
+ */
+void load_floats_file(const char *filename, FloatArray *floats);
+
+int save_floats_binary(const char *filename, const FloatArray *floats);
+
 void sort_incmag(FloatArray *floats);
 void sort_decmag(FloatArray *floats);
 
+/* The original qsort() versions of the sorts, kept for comparison. */
+void sort_incmag_qsort(FloatArray *floats);
+void sort_decmag_qsort(FloatArray *floats);
+
 #endif /* FFUNC_H */
@@ -3,8 +3,11 @@
 #include <string.h>
 #include <assert.h>
 #include <math.h>
+#include <unistd.h>
 
 #include "ffunc.h"
+#include "summation.h"
+#include "superacc.h"
 
 
 /* This function takes an array of single-precision floating point values,
@@ -20,71 +23,47 @@ float fsum(FloatArray *floats) {
     return sum;
 }
 
+/* This function computes the sum of the array by pairwise summation:  the
+ * array is split in half, each half is summed the same way, and the two
+ * sums are added.  The rounding error then only grows with the log of the
+ * number of values.  The work is done in place by pairwise_sum(), without
+ * copying the halves.
+ */
 float my_fsum(FloatArray *floats) {
-    // implementation of the pairwise summation
-    //assert(floats != NULL);
-    float s = 0;
-    // if the array is small
-    if (floats->count < 2) {
-      // just sum up all of the values
-      s = floats->values[0];
-      for (int i = 1; i < floats->count; i++) {
-        s = s + floats->values[i];
-      }
-    }
-    else {
-      // find where to split the array
-      FloatArray firstHalf;
-      FloatArray secondHalf;
-      int m = (floats->count / 2);
-      int n = floats->count - m;
-      // split into two arrays
-      float *values1 = malloc(m * sizeof(float));
-      if (values1 == NULL) {
-          printf("ERROR:  couldn't allocate %u bytes!\n",
-                 (unsigned int) (m * sizeof(float)));
-          exit(1);
-      }
-      float *values2 = malloc(n * sizeof(float));
-      if (values2 == NULL) {
-          printf("ERROR:  couldn't allocate %u bytes!\n",
-                 (unsigned int) (n * sizeof(float)));
-          exit(1);
-      }
-      /* Zero out the newly allocated memory. */
-      memset(values1, 0, m * sizeof(float));
-      memset(values2, 0, n * sizeof(float));
-
-      /* Load each floating-point value into its corresponding location
-       * in the array.
-       */
-      for (int i = 0; i < m; i++) {
-          values1[i] = floats->values[i];
-      }
-      for (int i = 0; i < n; i++) {
-          values2[i] = floats->values[i + m];
-      }
-      /* Finally, store the loaded values into the passed-in struct. */
-      firstHalf.count = m;
-      firstHalf.values = values1;
-      secondHalf.count = n;
-      secondHalf.values = values2;
-      // recursive function call on the two halves
-      s = my_fsum(&firstHalf) + my_fsum(&secondHalf);
-      // free the pointers
-      free(firstHalf.values);
-      free(secondHalf.values);
-    }
-    return s;
+    assert(floats != NULL);
+    return pairwise_sum(floats->values, 0, floats->count);
 }
 
 
-int main() {
+int main(int argc, char **argv) {
     FloatArray floats;
-    float sum1, sum2, sum3, my_sum;
+    float sum1, sum2, sum3, my_sum, exact;
+    int threads = 0;
+    int c;
 
-    load_floats(stdin, &floats);
-    printf("Loaded %d floats from stdin.\n", floats.count);
+    /* -t sets how many threads the exact sum uses; by default it uses
+     * every CPU.  The values are read from the named file, text or binary,
+     * or as text from stdin if there is no file.
+     */
+    while ((c = getopt(argc, argv, "t:")) != -1) {
+        if (c != 't' || (threads = atoi(optarg)) < 1) {
+            fprintf(stderr, "usage: %s [-t threads] [file]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (argc - optind > 1) {
+        fprintf(stderr, "usage: %s [-t threads] [file]\n", argv[0]);
+        return 1;
+    }
+
+    if (optind < argc) {
+        load_floats_file(argv[optind], &floats);
+        printf("Loaded %d floats from %s.\n", floats.count, argv[optind]);
+    }
+    else {
+        load_floats(stdin, &floats);
+        printf("Loaded %d floats from stdin.\n", floats.count);
+    }
 
     /* Compute a sum, in the order of input. */
     sum1 = fsum(&floats);
@@ -94,6 +73,11 @@ int main() {
      */
     my_sum = my_fsum(&floats);
 
+    /* The exact sum, rounded once.  It comes out the same however many
+     * threads are used.
+     */
+    exact = exact_sum(floats.values, 0, floats.count, threads);
+
     /* Compute a sum, in order of increasing magnitude. */
     sort_incmag(&floats);
     sum2 = fsum(&floats);
@@ -111,6 +95,7 @@ int main() {
 
 
     printf("My sum:  %e\n", my_sum);
+    printf("Exact sum:  %e\n", exact);
 
     return 0;
 }
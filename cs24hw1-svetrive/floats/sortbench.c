@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ffunc.h"
+
+
+/* Times the radix sorts in sort_incmag() and sort_decmag() against the
+ * qsort() versions they replaced, on a float file or on random values, and
+ * checks that both put the values in the same order of magnitude.
+ */
+
+
+#define DEFAULT_COUNT 1000000
+#define DEFAULT_REPEATS 5
+
+
+static double seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+/* Values with random signs and magnitudes from 10^-8 to 10^6, like f4.txt. */
+static void random_floats(FloatArray *floats, int count) {
+    unsigned int seed = 1;
+    int i;
+
+    floats->count = count;
+    floats->values = malloc(count * sizeof(float));
+    if (floats->values == NULL) {
+        fprintf(stderr, "sortbench: out of memory\n");
+        exit(1);
+    }
+    for (i = 0; i < count; i++) {
+        floats->values[i] = powf(10, -8 + 14.0f * rand_r(&seed) / RAND_MAX);
+        if (rand_r(&seed) & 1)
+            floats->values[i] = -floats->values[i];
+    }
+}
+
+
+/* Returns the best time of "repeats" sorts of a fresh copy of "input",
+ * leaving the last sorted copy in "output".
+ */
+static double time_sort(void (*sort)(FloatArray *), const FloatArray *input,
+                        FloatArray *output, int repeats) {
+    double best = 0, start, elapsed;
+    int r;
+
+    for (r = 0; r < repeats; r++) {
+        memcpy(output->values, input->values, input->count * sizeof(float));
+        output->count = input->count;
+        start = seconds();
+        sort(output);
+        elapsed = seconds() - start;
+        if (r == 0 || elapsed < best)
+            best = elapsed;
+    }
+    return best;
+}
+
+
+/* Returns nonzero if the two arrays have the same magnitude everywhere. */
+static int same_order(const FloatArray *a, const FloatArray *b) {
+    int i;
+
+    for (i = 0; i < a->count; i++) {
+        if (fabsf(a->values[i]) != fabsf(b->values[i]))
+            return 0;
+    }
+    return 1;
+}
+
+
+static void usage(char *program) {
+    fprintf(stderr, "usage: %s [-n count] [-r repeats] [file]\n", program);
+    fprintf(stderr, "\tSorts the floats in file, or count random floats.\n");
+}
+
+
+int main(int argc, char **argv) {
+    FloatArray input, by_qsort, by_radix;
+    int count = DEFAULT_COUNT, repeats = DEFAULT_REPEATS;
+    double qsort_time, radix_time;
+    int errors = 0;
+    int c;
+
+    while ((c = getopt(argc, argv, "n:r:")) != -1) {
+        switch (c) {
+        case 'n':
+            count = atoi(optarg);
+            break;
+
+        case 'r':
+            repeats = atoi(optarg);
+            break;
+
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (count < 1 || repeats < 1 || argc - optind > 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (optind < argc)
+        load_floats_file(argv[optind], &input);
+    else
+        random_floats(&input, count);
+
+    by_qsort.values = malloc(input.count * sizeof(float));
+    by_radix.values = malloc(input.count * sizeof(float));
+    if (by_qsort.values == NULL || by_radix.values == NULL) {
+        fprintf(stderr, "%s: out of memory\n", argv[0]);
+        return 1;
+    }
+
+    printf("%d floats, best of %d\n", input.count, repeats);
+    printf("order         qsort ms  radix ms  speedup\n");
+
+    qsort_time = time_sort(sort_incmag_qsort, &input, &by_qsort, repeats);
+    radix_time = time_sort(sort_incmag, &input, &by_radix, repeats);
+    printf("increasing  %10.2f  %8.2f  %6.1fx\n", qsort_time * 1e3,
+           radix_time * 1e3, qsort_time / radix_time);
+    if (!same_order(&by_qsort, &by_radix)) {
+        printf("Increasing order FAIL.\n");
+        errors++;
+    }
+
+    qsort_time = time_sort(sort_decmag_qsort, &input, &by_qsort, repeats);
+    radix_time = time_sort(sort_decmag, &input, &by_radix, repeats);
+    printf("decreasing  %10.2f  %8.2f  %6.1fx\n", qsort_time * 1e3,
+           radix_time * 1e3, qsort_time / radix_time);
+    if (!same_order(&by_qsort, &by_radix)) {
+        printf("Decreasing order FAIL.\n");
+        errors++;
+    }
+
+    return errors != 0;
+}
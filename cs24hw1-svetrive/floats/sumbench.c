@@ -0,0 +1,281 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ffunc.h"
+#include "summation.h"
+#include "superacc.h"
+
+
+/* Compares the summation algorithms on families of generated inputs chosen
+ * to be hard in different ways, at sizes growing by factors of ten.  For
+ * each algorithm it prints the time per value, and the error of the result
+ * in ULPs:  how many floats lie between it and the exact sum, correctly
+ * rounded, which superacc.c computes.
+ */
+
+
+#define DEFAULT_MIN_SIZE 1000
+#define DEFAULT_MAX_SIZE 10000000
+#define DEFAULT_REPEATS 3
+
+
+/* Input families. */
+
+/* Uniform in [0, 1):  easy, but a running sum still drifts as it grows. */
+static float gen_uniform(unsigned int *seed, int i) {
+    (void) i;
+    return (float) rand_r(seed) / ((float) RAND_MAX + 1);
+}
+
+/* Magnitudes spread evenly over 10^-8 to 10^6, with random signs. */
+static float gen_wide(unsigned int *seed, int i) {
+    float value = powf(10, -8 + 14.0f * rand_r(seed) / RAND_MAX);
+    (void) i;
+    return (rand_r(seed) & 1) ? -value : value;
+}
+
+/* Large values that almost all cancel:  every odd value undoes the one
+ * before it, except for a small perturbation, so the sum is tiny next to
+ * the values that make it up.
+ */
+static float gen_cancel(unsigned int *seed, int i) {
+    static float last;
+
+    if (i & 1)
+        return -last + (float) rand_r(seed) / RAND_MAX * 1e-3f;
+    last = ldexpf((float) rand_r(seed) / RAND_MAX, rand_r(seed) % 40);
+    return last;
+}
+
+
+typedef struct family {
+    const char *name;
+    float (*generate)(unsigned int *seed, int i);
+    int sort;           /* 1 sorts by increasing magnitude, -1 decreasing. */
+} family;
+
+static const family families[] = {
+    { "uniform", gen_uniform, 0 },
+    { "wide", gen_wide, 0 },
+    { "wide-increasing", gen_wide, 1 },
+    { "wide-decreasing", gen_wide, -1 },
+    { "cancel", gen_cancel, 0 },
+};
+
+#define NUM_FAMILIES ((int) (sizeof(families) / sizeof(families[0])))
+
+
+/* Algorithms.  Each sums the whole array; "scratch" is room for a copy of
+ * it, for the algorithms that need to reorder the values.
+ */
+
+static int threads = 0;
+
+static float run_naive(FloatArray *floats, float *scratch) {
+    float sum = 0;
+    int i;
+
+    (void) scratch;
+    for (i = 0; i < floats->count; i++)
+        sum += floats->values[i];
+    return sum;
+}
+
+static float run_sorted(FloatArray *floats, float *scratch) {
+    FloatArray copy = { floats->count, scratch };
+
+    memcpy(scratch, floats->values, floats->count * sizeof(float));
+    sort_incmag(&copy);
+    return run_naive(&copy, NULL);
+}
+
+static float run_pairwise_scalar(FloatArray *floats, float *scratch) {
+    (void) scratch;
+    return pairwise_sum_scalar(floats->values, 0, floats->count);
+}
+
+static float run_pairwise_avx2(FloatArray *floats, float *scratch) {
+    (void) scratch;
+    return pairwise_sum_avx2(floats->values, 0, floats->count);
+}
+
+static float run_kahan(FloatArray *floats, float *scratch) {
+    (void) scratch;
+    return kahan_sum(floats->values, 0, floats->count);
+}
+
+static float run_neumaier(FloatArray *floats, float *scratch) {
+    (void) scratch;
+    return neumaier_sum(floats->values, 0, floats->count);
+}
+
+static float run_exact(FloatArray *floats, float *scratch) {
+    (void) scratch;
+    return exact_sum(floats->values, 0, floats->count, 1);
+}
+
+static float run_exact_parallel(FloatArray *floats, float *scratch) {
+    (void) scratch;
+    return exact_sum(floats->values, 0, floats->count, threads);
+}
+
+
+typedef struct algorithm {
+    const char *name;
+    float (*run)(FloatArray *floats, float *scratch);
+    int needs_avx2;
+} algorithm;
+
+static const algorithm algorithms[] = {
+    { "naive", run_naive, 0 },
+    { "sorted-increasing", run_sorted, 0 },
+    { "pairwise-scalar", run_pairwise_scalar, 0 },
+    { "pairwise-avx2", run_pairwise_avx2, 1 },
+    { "kahan", run_kahan, 0 },
+    { "neumaier", run_neumaier, 0 },
+    { "exact", run_exact, 0 },
+    { "exact-parallel", run_exact_parallel, 0 },
+};
+
+#define NUM_ALGORITHMS ((int) (sizeof(algorithms) / sizeof(algorithms[0])))
+
+
+static double seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+/* Maps a float's bits onto integers in the same order as the floats, so
+ * that the difference of two is the number of floats between them.
+ */
+static int64_t ordered_bits(float value) {
+    int32_t bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+    return bits < 0 ? -(int64_t) (bits & 0x7fffffff) : bits;
+}
+
+/* The error of "value" in ULPs, or -1 if either is infinite or NaN. */
+static double ulp_error(float value, float exact) {
+    if (!isfinite(value) || !isfinite(exact))
+        return value == exact ? 0 : -1;
+    return (double) llabs(ordered_bits(value) - ordered_bits(exact));
+}
+
+
+static void generate(const family *fam, FloatArray *floats, int count) {
+    unsigned int seed = 1;
+    int i;
+
+    floats->count = count;
+    for (i = 0; i < count; i++)
+        floats->values[i] = fam->generate(&seed, i);
+
+    if (fam->sort > 0)
+        sort_incmag(floats);
+    else if (fam->sort < 0)
+        sort_decmag(floats);
+}
+
+
+static void usage(char *program) {
+    fprintf(stderr, "usage: %s [-n min_size] [-N max_size] [-r repeats] "
+            "[-t threads]\n", program);
+    fprintf(stderr, "\tTimes each summation algorithm, and measures its "
+            "error in ULPs,\n\ton every input family at sizes from "
+            "min_size to max_size.\n");
+    fprintf(stderr, "\tthreads is for exact-parallel; 0 uses every CPU.\n");
+}
+
+
+int main(int argc, char **argv) {
+    long min_size = DEFAULT_MIN_SIZE, max_size = DEFAULT_MAX_SIZE, size;
+    int repeats = DEFAULT_REPEATS;
+    FloatArray floats;
+    float *scratch;
+    float exact, result = 0;
+    double best, start, elapsed, error;
+    int has_avx2, f, a, r, c;
+
+    while ((c = getopt(argc, argv, "n:N:r:t:")) != -1) {
+        switch (c) {
+        case 'n':
+            min_size = atol(optarg);
+            break;
+
+        case 'N':
+            max_size = atol(optarg);
+            break;
+
+        case 'r':
+            repeats = atoi(optarg);
+            break;
+
+        case 't':
+            threads = atoi(optarg);
+            break;
+
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (min_size < 1 || max_size < min_size || max_size > 0x7fffffff ||
+        repeats < 1 || threads < 0 || optind != argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    floats.values = malloc(max_size * sizeof(float));
+    scratch = malloc(max_size * sizeof(float));
+    if (floats.values == NULL || scratch == NULL) {
+        fprintf(stderr, "%s: couldn't allocate %ld floats\n", argv[0],
+                max_size);
+        return 1;
+    }
+
+    __builtin_cpu_init();
+    has_avx2 = __builtin_cpu_supports("avx2");
+
+    printf("%-16s %11s  %-18s %9s %12s  %s\n", "family", "size",
+           "algorithm", "ns/value", "error (ulp)", "sum");
+
+    for (f = 0; f < NUM_FAMILIES; f++) {
+        for (size = min_size; size <= max_size; size *= 10) {
+            generate(&families[f], &floats, (int) size);
+            exact = exact_sum(floats.values, 0, floats.count, threads);
+
+            for (a = 0; a < NUM_ALGORITHMS; a++) {
+                if (algorithms[a].needs_avx2 && !has_avx2)
+                    continue;
+
+                best = 0;
+                for (r = 0; r < repeats; r++) {
+                    start = seconds();
+                    result = algorithms[a].run(&floats, scratch);
+                    elapsed = seconds() - start;
+                    if (r == 0 || elapsed < best)
+                        best = elapsed;
+                }
+
+                error = ulp_error(result, exact);
+                printf("%-16s %11ld  %-18s %9.3f ", families[f].name, size,
+                       algorithms[a].name, best * 1e9 / size);
+                if (error < 0)
+                    printf("%12s", "-");
+                else
+                    printf("%12.0f", error);
+                printf("  %.9g\n", result);
+            }
+        }
+    }
+
+    return 0;
+}
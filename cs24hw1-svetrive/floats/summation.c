@@ -0,0 +1,157 @@
+#include "summation.h"
+
+#include <immintrin.h>
+#include <math.h>
+
+
+/* Pairwise summation.
+ *
+ * Summing a range in two halves, recursively, bounds the rounding error by
+ * O(log n) instead of the O(n) of a running sum.  Splitting all the way
+ * down to single values would spend all the time in the recursion, so
+ * ranges of up to PAIRWISE_BLOCK values are summed by a kernel that adds
+ * value i into partial sum i % SUM_LANES, and then adds the partial sums
+ * together pairwise.  Each partial sum only sees PAIRWISE_BLOCK / SUM_LANES
+ * values, so the block adds very little error.
+ *
+ * Ranges are always split at a multiple of SUM_LANES, so every block but
+ * the last starts at a lane boundary and the vector kernel's loads line
+ * up with the partial sums.
+ */
+
+
+/* Adds the partial sums together, in the order the AVX2 kernel's register
+ * reductions do.  This and finish_block() are always inlined, so the AVX2
+ * kernel gets a VEX-encoded copy, and never calls SSE code with the upper
+ * halves of its registers still dirty.
+ */
+static inline __attribute__((always_inline))
+float reduce_lanes(const float *lanes) {
+    float s[8], a[4], b[2];
+    int j;
+
+    for (j = 0; j < 8; j++)
+        s[j] = (lanes[j] + lanes[8 + j]) + (lanes[16 + j] + lanes[24 + j]);
+    for (j = 0; j < 4; j++)
+        a[j] = s[j] + s[j + 4];
+    for (j = 0; j < 2; j++)
+        b[j] = a[j] + a[j + 2];
+    return b[0] + b[1];
+}
+
+
+/* Adds the values left over after the last whole group of SUM_LANES. */
+static inline __attribute__((always_inline))
+float finish_block(float *lanes, const float *values, int i, int n) {
+    int j;
+
+    for (j = 0; i + j < n; j++)
+        lanes[j] += values[i + j];
+    return reduce_lanes(lanes);
+}
+
+
+static float block_scalar(const float *values, int n) {
+    float lanes[SUM_LANES] = { 0 };
+    int i, j;
+
+    for (i = 0; i + SUM_LANES <= n; i += SUM_LANES) {
+        for (j = 0; j < SUM_LANES; j++)
+            lanes[j] += values[i + j];
+    }
+    return finish_block(lanes, values, i, n);
+}
+
+
+__attribute__((target("avx2")))
+static float block_avx2(const float *values, int n) {
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+    float lanes[SUM_LANES];
+    int i;
+
+    for (i = 0; i + SUM_LANES <= n; i += SUM_LANES) {
+        acc0 = _mm256_add_ps(acc0, _mm256_loadu_ps(values + i));
+        acc1 = _mm256_add_ps(acc1, _mm256_loadu_ps(values + i + 8));
+        acc2 = _mm256_add_ps(acc2, _mm256_loadu_ps(values + i + 16));
+        acc3 = _mm256_add_ps(acc3, _mm256_loadu_ps(values + i + 24));
+    }
+
+    _mm256_storeu_ps(lanes, acc0);
+    _mm256_storeu_ps(lanes + 8, acc1);
+    _mm256_storeu_ps(lanes + 16, acc2);
+    _mm256_storeu_ps(lanes + 24, acc3);
+    return finish_block(lanes, values, i, n);
+}
+
+
+/* The recursion shared by both kernels. */
+static float pairwise(const float *values, int n,
+                      float (*block)(const float *, int)) {
+    int half;
+
+    if (n <= PAIRWISE_BLOCK)
+        return block(values, n);
+
+    half = (n / 2) & ~(SUM_LANES - 1);
+    return pairwise(values, half, block) +
+           pairwise(values + half, n - half, block);
+}
+
+
+float pairwise_sum_scalar(const float *values, int start, int end) {
+    return pairwise(values + start, end - start, block_scalar);
+}
+
+
+float pairwise_sum_avx2(const float *values, int start, int end) {
+    return pairwise(values + start, end - start, block_avx2);
+}
+
+
+/* The kernel pairwise_sum() uses, chosen before main() runs. */
+static float (*pairwise_block)(const float *, int) = block_scalar;
+
+__attribute__((constructor))
+static void summation_init(void) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        pairwise_block = block_avx2;
+}
+
+
+float pairwise_sum(const float *values, int start, int end) {
+    return pairwise(values + start, end - start, pairwise_block);
+}
+
+
+/* Compensated summation. */
+
+float kahan_sum(const float *values, int start, int end) {
+    float sum = 0, c = 0, y, t;
+    int i;
+
+    for (i = start; i < end; i++) {
+        y = values[i] - c;
+        t = sum + y;
+        c = (t - sum) - y;
+        sum = t;
+    }
+    return sum;
+}
+
+
+float neumaier_sum(const float *values, int start, int end) {
+    float sum = 0, c = 0, t;
+    int i;
+
+    for (i = start; i < end; i++) {
+        t = sum + values[i];
+        if (fabsf(sum) >= fabsf(values[i]))
+            c += (sum - t) + values[i];
+        else
+            c += (values[i] - t) + sum;
+        sum = t;
+    }
+    return sum + c;
+}
@@ -0,0 +1,43 @@
+#ifndef SUMMATION_H
+#define SUMMATION_H
+
+
+/* Summation algorithms for arrays of floats.  Each one sums the values
+ * with indexes start to end - 1, without allocating any memory or
+ * changing the array.
+ */
+
+
+/* Pairwise summation stops splitting ranges at this many values, and sums
+ * each block across SUM_LANES independent partial sums instead.
+ */
+#define PAIRWISE_BLOCK 128
+
+/* The partial sums in a block:  four AVX2 registers of 8 floats each.  The
+ * scalar kernel keeps the same partial sums in the same order, so both
+ * kernels give bit-identical results.
+ */
+#define SUM_LANES 32
+
+
+/* Blocked pairwise summation, using the AVX2 kernel if the CPU has it. */
+float pairwise_sum(const float *values, int start, int end);
+
+/* The two kernels pairwise_sum() chooses between.  The AVX2 one may only
+ * be called if the CPU supports AVX2.
+ */
+float pairwise_sum_scalar(const float *values, int start, int end);
+float pairwise_sum_avx2(const float *values, int start, int end);
+
+
+/* Kahan's compensated summation:  the low-order bits lost by each addition
+ * are carried into the next one.
+ */
+float kahan_sum(const float *values, int start, int end);
+
+/* Neumaier's improvement of Kahan's algorithm, which also keeps the bits
+ * lost when a value is larger than the running sum.
+ */
+float neumaier_sum(const float *values, int start, int end);
+
+#endif /* SUMMATION_H */
@@ -0,0 +1,248 @@
+#include "superacc.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+
+/* Every finite float is an integer M < 2^24 times 2^(p - 149), for a bit
+ * position p from 0 to 253.  Adding it to the accumulator means adding
+ * M << (p % 32) into digits p / 32 and p / 32 + 1.  Neither digit gets
+ * more than 2^32 from one value, so a 64-bit digit can take 2^31 values
+ * (more than an int range can hold) before it could overflow.  Carries
+ * are only propagated, by normalize(), once a range has been added.
+ *
+ * Since the accumulator is an integer, adding is exact and merging two
+ * accumulators is exact too, so a sum split across any number of threads
+ * gives the same bits as one thread would.
+ */
+
+
+/* Ranges shorter than this aren't worth a thread of their own. */
+#define MIN_VALUES_PER_THREAD (1 << 16)
+
+
+/* Propagates carries so that every digit but the top one is in the range
+ * 0 to 2^32 - 1.  The top digit keeps the sign.
+ */
+static void normalize(long long *limbs) {
+    long long carry;
+    int i;
+
+    for (i = 0; i < SUPERACC_LIMBS - 1; i++) {
+        carry = limbs[i] >> 32;
+        limbs[i] &= 0xffffffffLL;
+        limbs[i + 1] += carry;
+    }
+}
+
+
+void superacc_init(superacc *acc) {
+    memset(acc, 0, sizeof(superacc));
+}
+
+
+/* Adds one value into "limbs", or notes it in *specials. */
+static inline void add_value(long long *limbs, int *specials, float value) {
+    uint32_t bits, mantissa, exponent;
+    uint64_t shifted;
+    long long sign;
+    int pos;
+
+    memcpy(&bits, &value, sizeof(bits));
+    exponent = (bits >> 23) & 0xff;
+    mantissa = bits & 0x7fffff;
+
+    if (exponent == 0xff) {
+        if (mantissa != 0)
+            *specials |= SUPERACC_NAN;
+        else
+            *specials |= (bits >> 31) ? SUPERACC_NEG_INF : SUPERACC_POS_INF;
+        return;
+    }
+
+    // subnormals share the position of the smallest normals
+    if (exponent == 0) {
+        pos = 0;
+    }
+    else {
+        mantissa |= 0x800000;
+        pos = exponent - 1;
+    }
+
+    // signs are often random, so negate with a mask rather than a branch
+    shifted = (uint64_t) mantissa << (pos & 31);
+    sign = -(long long) (bits >> 31);
+    limbs[pos >> 5] += ((long long) (shifted & 0xffffffff) ^ sign) - sign;
+    limbs[(pos >> 5) + 1] += ((long long) (shifted >> 32) ^ sign) - sign;
+}
+
+
+/* Neighbouring values usually have the same exponent, and so land in the
+ * same digits.  Alternating between two sets of digits lets one value's
+ * additions start before the last value's have been stored.
+ */
+void superacc_add(superacc *acc, const float *values, int start, int end) {
+    long long limbs[2][SUPERACC_LIMBS] = { { 0 } };
+    int i;
+
+    for (i = start; i + 1 < end; i += 2) {
+        add_value(limbs[0], &acc->specials, values[i]);
+        add_value(limbs[1], &acc->specials, values[i + 1]);
+    }
+    if (i < end)
+        add_value(limbs[0], &acc->specials, values[i]);
+
+    normalize(limbs[0]);
+    normalize(limbs[1]);
+    for (i = 0; i < SUPERACC_LIMBS; i++)
+        acc->limbs[i] += limbs[0][i] + limbs[1][i];
+    normalize(acc->limbs);
+}
+
+
+void superacc_merge(superacc *acc, const superacc *other) {
+    int i;
+
+    for (i = 0; i < SUPERACC_LIMBS; i++)
+        acc->limbs[i] += other->limbs[i];
+    normalize(acc->limbs);
+    acc->specials |= other->specials;
+}
+
+
+/* Returns the 64 bits of the digits starting at bit "pos". */
+static uint64_t bits_at(const uint32_t *digits, int pos) {
+    int i = pos / 32, shift = pos % 32;
+    uint64_t window;
+
+    window = ((uint64_t) digits[i + 1] << 32 | digits[i]) >> shift;
+    if (shift != 0)
+        window |= (uint64_t) digits[i + 2] << (64 - shift);
+    return window;
+}
+
+
+/* The largest sum of floats is nowhere near the top of the accumulator, so
+ * once normalized, the magnitude of the sum is always held in 32-bit
+ * digits, with the top digit included.
+ *
+ * The magnitude is rounded by taking its top 64 bits, with any lower bits
+ * that are set folded into the lowest one, and converting that to a float.
+ * The conversion rounds correctly, and since the folded bit is well below
+ * the rounding position, it only ever breaks what would look like a tie.
+ * Scaling the float into place is then exact, unless it overflows to
+ * infinity, which is the correct rounding in that case too.  A sum that
+ * ends up subnormal fits in the bottom 64 bits, so it is converted exactly.
+ * A sum of exactly zero comes out as +0.
+ */
+float superacc_round(const superacc *acc) {
+    long long limbs[SUPERACC_LIMBS];
+    uint32_t digits[SUPERACC_LIMBS + 2] = { 0 };
+    uint64_t window;
+    float magnitude;
+    int negative, top, low, i;
+
+    if ((acc->specials & SUPERACC_NAN) ||
+        (acc->specials & SUPERACC_POS_INF && acc->specials & SUPERACC_NEG_INF))
+        return NAN;
+    if (acc->specials & SUPERACC_POS_INF)
+        return INFINITY;
+    if (acc->specials & SUPERACC_NEG_INF)
+        return -INFINITY;
+
+    memcpy(limbs, acc->limbs, sizeof(limbs));
+    normalize(limbs);
+    negative = limbs[SUPERACC_LIMBS - 1] < 0;
+    if (negative) {
+        for (i = 0; i < SUPERACC_LIMBS; i++)
+            limbs[i] = -limbs[i];
+        normalize(limbs);
+    }
+    for (i = 0; i < SUPERACC_LIMBS; i++)
+        digits[i] = (uint32_t) limbs[i];
+
+    top = SUPERACC_LIMBS - 1;
+    while (top >= 0 && digits[top] == 0)
+        top--;
+    if (top < 0)
+        return 0.0f;
+
+    top = 32 * top + 31 - __builtin_clz(digits[top]);
+    if (top < 64) {
+        magnitude = (float) bits_at(digits, 0);
+        low = 0;
+    }
+    else {
+        low = top - 63;
+        window = bits_at(digits, low);
+        for (i = 0; i < low / 32; i++)
+            window |= digits[i] != 0;
+        window |= (digits[low / 32] & ((1u << (low % 32)) - 1)) != 0;
+        magnitude = (float) window;
+    }
+
+    magnitude = ldexpf(magnitude, low - 149);
+    return negative ? -magnitude : magnitude;
+}
+
+
+/* One thread's share of an exact_sum(). */
+typedef struct sum_task {
+    const float *values;
+    int start, end;
+    superacc acc;
+} sum_task;
+
+static void * sum_worker(void *arg) {
+    sum_task *task = (sum_task *) arg;
+
+    superacc_add(&task->acc, task->values, task->start, task->end);
+    return NULL;
+}
+
+
+/* The range is cut into one slice per thread, and the calling thread sums
+ * the first slice itself.  If a thread can't be started, its slice is
+ * summed by the calling thread instead; the answer is the same either way.
+ */
+float exact_sum(const float *values, int start, int end, int threads) {
+    int n = end - start;
+    int i;
+
+    // asking for the CPU count costs more than summing a short range
+    if (n < 2 * MIN_VALUES_PER_THREAD)
+        threads = 1;
+    else if (threads <= 0)
+        threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > n / MIN_VALUES_PER_THREAD)
+        threads = n / MIN_VALUES_PER_THREAD;
+    if (threads < 1)
+        threads = 1;
+
+    sum_task tasks[threads];
+    pthread_t ids[threads];
+    int started[threads];
+
+    for (i = 0; i < threads; i++) {
+        tasks[i].values = values;
+        tasks[i].start = start + (int) ((long long) n * i / threads);
+        tasks[i].end = start + (int) ((long long) n * (i + 1) / threads);
+        superacc_init(&tasks[i].acc);
+        started[i] = i > 0 &&
+            pthread_create(&ids[i], NULL, sum_worker, &tasks[i]) == 0;
+    }
+
+    for (i = 0; i < threads; i++) {
+        if (started[i])
+            pthread_join(ids[i], NULL);
+        else
+            sum_worker(&tasks[i]);
+        if (i > 0)
+            superacc_merge(&tasks[0].acc, &tasks[i].acc);
+    }
+
+    return superacc_round(&tasks[0].acc);
+}
@@ -0,0 +1,51 @@
+#ifndef SUPERACC_H
+#define SUPERACC_H
+
+
+/* Exact summation of floats, with a superaccumulator:  a fixed-point
+ * integer wide enough to hold any sum of floats without rounding.  Since
+ * nothing is rounded until the very end, the result is the exact sum
+ * rounded once to the nearest float, whatever order the values come in,
+ * and however they are split up between threads.
+ */
+
+
+/* The accumulator is SUPERACC_LIMBS 32-bit digits, each held in a 64-bit
+ * integer so that additions can carry into the spare bits for a while.
+ * Bit 0 of digit 0 is worth 2^-149, the smallest float, and the largest
+ * float's top bit lands in digit 8, so 10 digits leave 40 bits of
+ * headroom for the sum to grow in.
+ */
+#define SUPERACC_LIMBS 10
+
+/* Bits of the "specials" field, for the values with no fixed-point form. */
+#define SUPERACC_POS_INF 1
+#define SUPERACC_NEG_INF 2
+#define SUPERACC_NAN     4
+
+typedef struct superacc {
+    long long limbs[SUPERACC_LIMBS];
+    int specials;
+} superacc;
+
+
+/* Set the accumulator to zero. */
+void superacc_init(superacc *acc);
+
+/* Add the values with indexes start to end - 1 into the accumulator. */
+void superacc_add(superacc *acc, const float *values, int start, int end);
+
+/* Add the sum held in "other" into "acc". */
+void superacc_merge(superacc *acc, const superacc *other);
+
+/* Round the accumulated sum to the nearest float, ties to even. */
+float superacc_round(const superacc *acc);
+
+
+/* Sum the values with indexes start to end - 1 exactly, split across
+ * "threads" threads, or one per online CPU if "threads" is 0 or less.
+ * Short ranges use fewer threads than asked for.
+ */
+float exact_sum(const float *values, int start, int end, int threads);
+
+#endif /* SUPERACC_H */
@@ -0,0 +1,116 @@
+/*! \file
+ * Boundary-tag block operations shared by the myalloc backends whose blocks
+ * carry header and footer tags.  See btag.h.
+ *
+ * Adapted from Andre DeHon's CS24 2004, 2006 material.
+ * Copyright (C) California Institute of Technology, 2004-2010.
+ * All rights reserved.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "myalloc.h"
+#include "btag.h"
+
+
+static void unlink_block(myalloc_pool_t *pool, const btag_ops *ops,
+                         unsigned char *header) {
+    if (ops->unlink != NULL)
+        ops->unlink(pool, header);
+}
+
+
+void btag_place(myalloc_pool_t *pool, const btag_ops *ops,
+                unsigned char *header, int total, int size) {
+    unsigned char *tail = NULL;
+
+    if (total - size >= 2 * TAG_SIZE + ops->min_payload) {
+        tail = header + 2 * TAG_SIZE + size;
+        set_tags(tail, -(total - size - 2 * TAG_SIZE));
+        total = size;
+    }
+
+    // the block's footer has to be in place before the tail is freed
+    set_tags(header, -total);
+    if (tail != NULL)
+        myalloc_pool_free(pool, tail + TAG_SIZE);
+}
+
+
+/*
+ * The tags tell us in constant time whether the blocks on either side are
+ * free.  Growing into the right neighbour needs no copying; sliding into the
+ * left one (taking the right one too if it is free) needs a memmove of the
+ * old contents.  Neighbours are unlinked before their space is reused.
+ */
+unsigned char * btag_realloc(myalloc_pool_t *pool, const btag_ops *ops,
+                             unsigned char *oldptr, int size) {
+    unsigned char *header, *right, *left = NULL, *newptr;
+    int old_size, right_size = 0, left_size = 0;
+
+    if (oldptr == NULL)
+        return myalloc_pool_alloc(pool, size);
+
+    if (size < ops->min_payload)
+        size = ops->min_payload;
+
+    header = oldptr - TAG_SIZE;
+    old_size = abs(block_size(header));
+
+    // shrinking (or staying the same size) never moves the block
+    if (size <= old_size) {
+        btag_place(pool, ops, header, old_size, size);
+        return oldptr;
+    }
+
+    right = header + 2 * TAG_SIZE + old_size;
+    if (ops->contains(pool, right) && block_size(right) > 0)
+        right_size = 2 * TAG_SIZE + block_size(right);
+
+    if (old_size + right_size >= size) {
+        unlink_block(pool, ops, right);
+        btag_place(pool, ops, header, old_size + right_size, size);
+        return oldptr;
+    }
+
+    if (ops->contains(pool, header - TAG_SIZE) &&
+        *((int *) (header - TAG_SIZE)) > 0) {
+        left_size = 2 * TAG_SIZE + *((int *) (header - TAG_SIZE));
+        left = header - left_size;
+    }
+
+    if (left_size + old_size + right_size >= size) {
+        unlink_block(pool, ops, left);
+        if (right_size > 0)
+            unlink_block(pool, ops, right);
+        memmove(left + TAG_SIZE, oldptr, old_size);
+        btag_place(pool, ops, left, left_size + old_size + right_size, size);
+        return left + TAG_SIZE;
+    }
+
+    // no room around the block, so it has to move
+    newptr = myalloc_pool_alloc(pool, size);
+    if (newptr == NULL)
+        return NULL;
+    memcpy(newptr, oldptr, old_size);
+    myalloc_pool_free(pool, oldptr);
+    return newptr;
+}
+
+
+void btag_count_free(unsigned char *header, unsigned char *end,
+                     myalloc_stats *stats) {
+    int size;
+
+    while (header < end) {
+        size = block_size(header);
+        if (size > 0) {
+            stats->free_bytes += size;
+            stats->free_blocks++;
+            if (size > stats->largest_free)
+                stats->largest_free = size;
+        }
+        header += 2 * TAG_SIZE + abs(size);
+    }
+}
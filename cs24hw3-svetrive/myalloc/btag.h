@@ -0,0 +1,74 @@
+/*! \file
+ * Declarations for the boundary-tag block operations that the allocators
+ * with header/footer tags (myalloc.c, seg_myalloc.c, tree_myalloc.c and
+ * grow_myalloc.c) share:  splitting a block, resizing one in place, and
+ * adding up a pool's free blocks.  Include myalloc.h before this file.
+ *
+ * A block is an int tag holding its payload size, the payload, and another
+ * copy of the tag.  The size is negated while the block is allocated.
+ *
+ * These functions don't know how a backend indexes its free blocks or where
+ * its blocks end, so each backend describes that with a btag_ops.  Freeing
+ * and allocating go through the backend's own myalloc_pool_free() and
+ * myalloc_pool_alloc(), since each program links exactly one backend.
+ */
+
+#include <stdlib.h>
+
+
+/*! Size of one boundary tag (the header or the footer of a block). */
+#define TAG_SIZE ((int) sizeof(int))
+
+
+/*! The size in the tag at "header":  negative while the block is in use. */
+static inline int block_size(unsigned char *header) {
+    return *((int *) header);
+}
+
+/*! Writes "size" into both tags of the block at "header". */
+static inline void set_tags(unsigned char *header, int size) {
+    *((int *) header) = size;
+    *((int *) (header + TAG_SIZE + abs(size))) = size;
+}
+
+
+/*! What the shared operations need to know about a backend. */
+typedef struct btag_ops {
+    /*! Smallest payload a block may have. */
+    int min_payload;
+
+    /*! Returns nonzero if the tag at "tag" belongs to one of the pool's
+     *  blocks, so a neighbour's tag can be read there.
+     */
+    int (*contains)(myalloc_pool_t *pool, unsigned char *tag);
+
+    /*! Takes the free block at "header" out of the backend's index of free
+     *  blocks before its space is reused.  NULL if there is no index.
+     */
+    void (*unlink)(myalloc_pool_t *pool, unsigned char *header);
+} btag_ops;
+
+
+/* Turn the "total" payload bytes starting at "header" into an allocated
+ * block of "size" bytes.  A tail big enough to be a block of its own is
+ * split off and freed with myalloc_pool_free(), which coalesces it with a
+ * free right neighbour and files it wherever the backend keeps free blocks.
+ */
+void btag_place(myalloc_pool_t *pool, const btag_ops *ops,
+                unsigned char *header, int total, int size);
+
+
+/* Resize the block at "oldptr" to "size" bytes, as myalloc_pool_realloc()
+ * does:  shrink in place, grow into a free right neighbour, slide down into
+ * a free left neighbour, and only then allocate, copy and free.  Returns the
+ * (possibly moved) block, or NULL with the old block left alone.
+ */
+unsigned char * btag_realloc(myalloc_pool_t *pool, const btag_ops *ops,
+                             unsigned char *oldptr, int size);
+
+
+/* Add the free blocks from "header" up to "end" to the free_bytes,
+ * largest_free and free_blocks of "stats".
+ */
+void btag_count_free(unsigned char *header, unsigned char *end,
+                     myalloc_stats *stats);
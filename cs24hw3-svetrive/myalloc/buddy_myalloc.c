@@ -0,0 +1,421 @@
+/*! \file
+ * Implementation of a buddy-system memory allocator.  The allocator manages a
+ * small pool of memory, provides memory chunks on request, and reintegrates
+ * freed memory back into the pool.
+ *
+ * Every block is MIN_BLOCK_SIZE * 2^order bytes and starts at a multiple of
+ * its own size (relative to the start of the pool), so a block's buddy is
+ * found by flipping a single bit of its offset.  Free blocks of each order
+ * are kept on a doubly linked list stored inside the blocks themselves.
+ *
+ * Blocks carry no headers or footers.  Instead the pool keeps two bitmaps
+ * over the implicit binary tree of blocks:  one marking the blocks that are
+ * split into two halves, and one marking the blocks that are free.  A block
+ * that is neither is allocated (or lies past the end of the pool).  The
+ * bitmaps are malloc'd next to the pool rather than carved out of it, much
+ * like a kernel keeps its page-frame array apart from the pages themselves,
+ * so they cost about 1/128th of the pool on top of MEMORY_SIZE.
+ *
+ * Adapted from Andre DeHon's CS24 2004, 2006 material.
+ * Copyright (C) California Institute of Technology, 2004-2010.
+ * All rights reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "myalloc.h"
+
+
+/*! The size of an order-0 block, which must be able to hold free_links. */
+#define MIN_BLOCK_SIZE 32
+
+/*! Enough orders for any pool whose size fits in an int. */
+#define MAX_ORDERS 32
+
+
+/*! The links stored at the start of every free block. */
+typedef struct free_links {
+    unsigned char *prev;
+    unsigned char *next;
+} free_links;
+
+
+/*!
+ * The state of one allocator instance.  top_order is the order of the
+ * smallest block that covers the whole pool; when the pool size isn't a
+ * power of two, the part of that block past the end of the pool is simply
+ * never marked free, so nothing ever merges into it.
+ *
+ * Bit n of each bitmap describes tree node n, numbered heap-style with the
+ * order-top_order block as node 0 (see node_index()).
+ */
+struct myalloc_pool {
+    int size;
+    unsigned char *mem;
+    int top_order;
+
+    unsigned char *free_lists[MAX_ORDERS];
+    unsigned int nonempty_orders;
+
+    unsigned char *split_map;
+    unsigned char *free_map;
+
+    long allocs;
+    long headers_touched;
+};
+
+
+/*!
+ * MEMORY_SIZE specifies the size of the default pool, which init_myalloc()
+ * creates and myalloc() and myfree() work against.
+ */
+int MEMORY_SIZE;
+static myalloc_pool_t *default_pool;
+
+
+/* Block geometry. */
+
+static long order_size(int order) {
+    return (long) MIN_BLOCK_SIZE << order;
+}
+
+/*! Returns the smallest order whose blocks can hold "size" bytes. */
+static int order_of_size(long size) {
+    int order = 0;
+    while (order_size(order) < size)
+        order++;
+    return order;
+}
+
+/*! Returns the tree node for the block of "order" at pool offset "offset". */
+static long node_index(myalloc_pool_t *pool, int order, long offset) {
+    return ((1L << (pool->top_order - order)) - 1) + (offset / order_size(order));
+}
+
+
+/* Bitmap helpers. */
+
+static int test_bit(unsigned char *map, long n) {
+    return (map[n >> 3] >> (n & 7)) & 1;
+}
+
+static void set_bit(unsigned char *map, long n) {
+    map[n >> 3] |= (unsigned char) (1 << (n & 7));
+}
+
+static void clear_bit(unsigned char *map, long n) {
+    map[n >> 3] &= (unsigned char) ~(1 << (n & 7));
+}
+
+
+/* Free-list helpers.  These also keep the free bitmap in step. */
+
+static free_links * links(unsigned char *block) {
+    return (free_links *) block;
+}
+
+static void list_insert(myalloc_pool_t *pool, int order, long offset) {
+    unsigned char *block = pool->mem + offset;
+    free_links *l = links(block);
+
+    l->prev = NULL;
+    l->next = pool->free_lists[order];
+    if (l->next != NULL)
+        links(l->next)->prev = block;
+    pool->free_lists[order] = block;
+    pool->nonempty_orders |= 1u << order;
+
+    set_bit(pool->free_map, node_index(pool, order, offset));
+}
+
+static void list_remove(myalloc_pool_t *pool, int order, long offset) {
+    unsigned char *block = pool->mem + offset;
+    free_links *l = links(block);
+
+    if (l->prev != NULL)
+        links(l->prev)->next = l->next;
+    else
+        pool->free_lists[order] = l->next;
+    if (l->next != NULL)
+        links(l->next)->prev = l->prev;
+    if (pool->free_lists[order] == NULL)
+        pool->nonempty_orders &= ~(1u << order);
+
+    clear_bit(pool->free_map, node_index(pool, order, offset));
+}
+
+
+/*!
+ * Returns the order of the allocated block at "offset", found by walking down
+ * from the top of the tree for as long as the enclosing block is split.
+ */
+static int block_order(myalloc_pool_t *pool, long offset) {
+    int order = pool->top_order;
+
+    while (order > 0 &&
+           test_bit(pool->split_map, node_index(pool, order, offset)))
+        order--;
+
+    return order;
+}
+
+
+/*!
+ * Splits the free block of "order" at "offset", which must already be off
+ * its free list, until it is down to "target" order.  The upper half of each
+ * split goes onto the free list for its order.
+ */
+static void split_down(myalloc_pool_t *pool, int order, long offset,
+                       int target) {
+    while (order > target) {
+        set_bit(pool->split_map, node_index(pool, order, offset));
+        order--;
+        list_insert(pool, order, offset + order_size(order));
+    }
+}
+
+
+/*!
+ * This function initializes both the allocator state, and the memory pool of a
+ * new allocator instance.
+ *
+ * The pool is carved into the largest aligned power-of-two blocks that fit,
+ * from the front, and the ancestors of each one are marked split.
+ */
+myalloc_pool_t * myalloc_pool_create(int size) {
+    myalloc_pool_t *pool = (myalloc_pool_t *) malloc(sizeof(myalloc_pool_t));
+    unsigned char *mem = (unsigned char *) malloc(size);
+    long map_bytes, offset;
+    int order, k;
+
+    if (pool == 0 || mem == 0) {
+        fprintf(stderr,
+                "myalloc_pool_create: could not get %d bytes from the system\n",
+                size);
+        abort();
+    }
+    pool->size = size;
+    pool->mem = mem;
+    pool->top_order = order_of_size(size);
+
+    for (k = 0; k < MAX_ORDERS; k++)
+        pool->free_lists[k] = NULL;
+    pool->nonempty_orders = 0;
+    pool->allocs = 0;
+    pool->headers_touched = 0;
+
+    // the tree has 2^(top_order + 1) - 1 nodes
+    map_bytes = ((2L << pool->top_order) + 7) / 8;
+    pool->split_map = (unsigned char *) calloc(map_bytes, 1);
+    pool->free_map = (unsigned char *) calloc(map_bytes, 1);
+    if (pool->split_map == 0 || pool->free_map == 0) {
+        fprintf(stderr, "myalloc_pool_create: could not get %ld bytes for "
+                "the block bitmaps\n", 2 * map_bytes);
+        abort();
+    }
+
+    offset = 0;
+    while (offset + MIN_BLOCK_SIZE <= size) {
+        // the largest block that is aligned here and fits in the pool
+        order = 0;
+        while (order < pool->top_order &&
+               offset % order_size(order + 1) == 0 &&
+               offset + order_size(order + 1) <= size)
+            order++;
+
+        for (k = order + 1; k <= pool->top_order; k++)
+            set_bit(pool->split_map, node_index(pool, k, offset));
+        list_insert(pool, order, offset);
+
+        offset += order_size(order);
+    }
+
+    return pool;
+}
+
+
+/*!
+ * The smallest pool that can hold a block:  one block of order 0.
+ */
+int myalloc_pool_min_size() {
+    return MIN_BLOCK_SIZE;
+}
+
+
+/*!
+ * Attempt to allocate a chunk of memory of "size" bytes.  Return 0 if
+ * allocation fails.
+ *
+ * The request is rounded up to an order, and the smallest non-empty free list
+ * at or above that order is found with one bit scan.  The block is then split
+ * in half until it is the right order, so allocation is O(log n) in the size
+ * of the pool.
+ */
+unsigned char *myalloc_pool_alloc(myalloc_pool_t *pool, int size) {
+    int order = order_of_size(size);
+    unsigned int candidates;
+    int found;
+    long offset;
+
+    pool->allocs++;
+    candidates = (order < MAX_ORDERS) ? pool->nonempty_orders & (~0u << order) : 0;
+    if (candidates == 0) {
+        fprintf(stderr, "myalloc: cannot service request of size %d\n", size);
+        return (unsigned char *) 0;
+    }
+
+    found = __builtin_ctz(candidates);
+    offset = pool->free_lists[found] - pool->mem;
+    pool->headers_touched++;
+    list_remove(pool, found, offset);
+    split_down(pool, found, offset, order);
+
+    return pool->mem + offset;
+}
+
+
+/*!
+ * Free a previously allocated pointer.  oldptr should be an address returned by
+ * myalloc().
+ *
+ * The block's order comes from the split bitmap.  Then, as long as the
+ * block's buddy (its offset with the order's bit flipped) is free, the buddy
+ * is taken off its list and the two merge into their parent.  Both steps are
+ * O(log n) in the size of the pool.
+ */
+void myalloc_pool_free(myalloc_pool_t *pool, unsigned char *oldptr) {
+    long offset = oldptr - pool->mem;
+    int order = block_order(pool, offset);
+    long buddy;
+
+    while (order < pool->top_order) {
+        buddy = offset ^ order_size(order);
+        if (!test_bit(pool->free_map, node_index(pool, order, buddy)))
+            break;
+
+        list_remove(pool, order, buddy);
+        offset &= ~order_size(order);
+        order++;
+        clear_bit(pool->split_map, node_index(pool, order, offset));
+    }
+
+    list_insert(pool, order, offset);
+}
+
+
+/*!
+ * Resize a previously allocated pointer to "size" bytes, preserving its
+ * contents up to the smaller of the two sizes.  Return the (possibly moved)
+ * block, or 0 if the request can't be serviced, in which case the old block
+ * is left alone.
+ *
+ * A shrinking block is split in place, freeing its upper halves.  A growing
+ * block stays put if it is the lower half of each parent it needs and every
+ * upper half on the way up is free; otherwise it moves.
+ */
+unsigned char *myalloc_pool_realloc(myalloc_pool_t *pool, unsigned char *oldptr,
+                                    int size) {
+    long offset;
+    int order, target, o;
+    unsigned char *newptr;
+
+    if (oldptr == NULL)
+        return myalloc_pool_alloc(pool, size);
+
+    offset = oldptr - pool->mem;
+    order = block_order(pool, offset);
+    target = order_of_size(size);
+
+    if (target <= order) {
+        split_down(pool, order, offset, target);
+        return oldptr;
+    }
+
+    // can the block absorb the upper halves of its parents in place?
+    for (o = order; o < target && o < pool->top_order; o++) {
+        if ((offset & order_size(o)) != 0 ||
+            !test_bit(pool->free_map,
+                      node_index(pool, o, offset + order_size(o))))
+            break;
+    }
+
+    if (o == target) {
+        for (o = order; o < target; o++) {
+            list_remove(pool, o, offset + order_size(o));
+            clear_bit(pool->split_map, node_index(pool, o + 1, offset));
+        }
+        return oldptr;
+    }
+
+    newptr = myalloc_pool_alloc(pool, size);
+    if (newptr == NULL)
+        return NULL;
+    memcpy(newptr, oldptr, order_size(order));
+    myalloc_pool_free(pool, oldptr);
+    return newptr;
+}
+
+
+/*!
+ * Report on the pool's free space by walking the free list of each order.
+ */
+void myalloc_pool_stats(myalloc_pool_t *pool, myalloc_stats *stats) {
+    unsigned char *block;
+    int order;
+
+    stats->free_bytes = 0;
+    stats->largest_free = 0;
+    stats->free_blocks = 0;
+    stats->allocs = pool->allocs;
+    stats->headers_touched = pool->headers_touched;
+
+    for (order = 0; order < MAX_ORDERS; order++) {
+        for (block = pool->free_lists[order]; block != NULL;
+             block = links(block)->next) {
+            stats->free_bytes += order_size(order);
+            stats->free_blocks++;
+            stats->largest_free = order_size(order);
+        }
+    }
+}
+
+
+/*!
+ * Clean up the allocator state.
+ * All this really has to do is free the user memory pool and the bitmaps.
+ */
+void myalloc_pool_destroy(myalloc_pool_t *pool) {
+    free(pool->split_map);
+    free(pool->free_map);
+    free(pool->mem);
+    free(pool);
+}
+
+
+/*!
+ * The single-pool interface.  These work against the default pool of
+ * MEMORY_SIZE bytes, which init_myalloc() must create before myalloc() or
+ * myfree() will work at all.
+ */
+void init_myalloc() {
+    default_pool = myalloc_pool_create(MEMORY_SIZE);
+}
+
+unsigned char *myalloc(int size) {
+    return myalloc_pool_alloc(default_pool, size);
+}
+
+void myfree(unsigned char *oldptr) {
+    myalloc_pool_free(default_pool, oldptr);
+}
+
+unsigned char *myrealloc(unsigned char *oldptr, int size) {
+    return myalloc_pool_realloc(default_pool, oldptr, size);
+}
+
+void close_myalloc() {
+    myalloc_pool_destroy(default_pool);
+    default_pool = NULL;
+}
@@ -0,0 +1,449 @@
+/*! \file
+ * Implementation of a best-fit memory allocator whose pool grows on demand.
+ * The allocator manages a pool of memory, provides memory chunks on request,
+ * and reintegrates freed memory back into the pool.
+ *
+ * Instead of one fixed block of memory, the pool is a chain of regions, each
+ * mapped from the system with mmap().  The pool starts with one region and
+ * maps another whenever no free block is big enough, up to a limit of "size"
+ * bytes in all, so MEMORY_SIZE now bounds the pool's footprint rather than
+ * being claimed up front.  A region whose blocks have all been freed is
+ * unmapped again, so the memory the process holds follows the size of the
+ * live heap.  The first region is never unmapped, and one more empty region
+ * is kept in reserve, so a heap that hovers around a region boundary doesn't
+ * map and unmap a region on every other call.  The reserve still counts
+ * against the limit, so it is given up when a bigger region needs the room.
+ *
+ * Within a region, blocks use the same header/footer boundary tags as the
+ * other best-fit allocators, and free blocks are indexed in the same
+ * red-black tree.  Each region starts with a prologue tag and ends with an
+ * epilogue tag, both holding REGION_SENTINEL.  To the coalescing code these
+ * look like allocated neighbours, so blocks never merge across a region
+ * boundary, and no bounds checks are needed to stay inside the region.
+ *
+ * Adapted from Andre DeHon's CS24 2004, 2006 material.
+ * Copyright (C) California Institute of Technology, 2004-2010.
+ * All rights reserved.
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "myalloc.h"
+#include "btag.h"
+#include "rbtree.h"
+
+
+/*!
+ * The tag value at either end of a region.  It is negative, so it reads as
+ * allocated, and no real block is ever this large.
+ */
+#define REGION_SENTINEL INT_MIN
+
+/*! New regions are at least this big, so growing is rare. */
+#define MIN_REGION_SIZE (64 * 1024)
+
+
+/*! Smallest payload a block may have, so it can hold a node once freed. */
+#define MIN_PAYLOAD ((int) sizeof(rb_node))
+
+
+/*!
+ * The header at the start of every region.  It is followed by the prologue
+ * tag, the region's blocks, and the epilogue tag.  Its 24 bytes, the
+ * prologue and the first block's header put that block's payload 32 bytes
+ * into the page-aligned mapping, so it is 16-byte aligned.  Later payloads
+ * are only as aligned as the sizes of the blocks before them, as in the
+ * other best-fit allocators.
+ */
+typedef struct region {
+    struct region *prev;
+    struct region *next;
+    long size;               /*!< Bytes mapped for this region. */
+} region;
+
+/*! Bytes of a region taken by its header and sentinel tags. */
+#define REGION_OVERHEAD ((int) sizeof(region) + 2 * TAG_SIZE)
+
+
+/*!
+ * The state of one allocator instance:  the most memory it may map, the
+ * regions it has mapped so far (newest first), the last region to have
+ * been emptied, and its tree of free blocks.
+ */
+struct myalloc_pool {
+    int size;
+    long mapped;
+    region *regions;
+    region *spare;
+    rb_tree free_tree;
+
+    long allocs;
+    long headers_touched;
+};
+
+
+/*!
+ * MEMORY_SIZE specifies the size of the default pool, which init_myalloc()
+ * creates and myalloc() and myfree() work against.
+ */
+int MEMORY_SIZE;
+static myalloc_pool_t *default_pool;
+
+
+/* Node helpers.  The boundary tags are handled by btag.h. */
+
+static rb_node * node_of(unsigned char *header) {
+    return (rb_node *) (header + TAG_SIZE);
+}
+
+static unsigned char * header_of(rb_node *n) {
+    return (unsigned char *) n - TAG_SIZE;
+}
+
+
+/* The tree of free blocks (see rbtree.h) works with the nodes in their
+ * payloads, and the rest of the allocator with their headers.
+ */
+
+static void tree_insert(myalloc_pool_t *pool, unsigned char *header) {
+    rb_insert(&pool->free_tree, node_of(header));
+}
+
+static void tree_remove(myalloc_pool_t *pool, unsigned char *header) {
+    rb_remove(&pool->free_tree, node_of(header));
+}
+
+/*!
+ * Returns the header of the smallest free block with at least "size" payload
+ * bytes, lowest address first among ties, or NULL if no block is big enough.
+ */
+static unsigned char * tree_best_fit(myalloc_pool_t *pool, int size) {
+    rb_node *best = rb_best_fit(&pool->free_tree, size,
+                                &pool->headers_touched);
+
+    return (best == NULL) ? NULL : header_of(best);
+}
+
+
+/*!
+ * Every tag next to a block can be read:  at the ends of a region it is a
+ * sentinel, which reads as an allocated neighbour.
+ */
+static int in_region(myalloc_pool_t *pool, unsigned char *tag) {
+    return 1;
+}
+
+/*! How the shared boundary-tag code finds and unlinks free blocks. */
+static const btag_ops tag_ops = { MIN_PAYLOAD, in_region, tree_remove };
+
+
+/* Region helpers. */
+
+/*! Returns the header of the first block in a region. */
+static unsigned char * region_first_block(region *r) {
+    return (unsigned char *) (r + 1) + TAG_SIZE;
+}
+
+/*!
+ * Maps a region of "bytes" bytes, lays it out as one free block between the
+ * two sentinels, and adds that block to the tree.  Returns NULL if the system
+ * has no more memory.
+ */
+static region * region_map(myalloc_pool_t *pool, long bytes) {
+    region *r;
+    unsigned char *header;
+    int payload = (int) (bytes - REGION_OVERHEAD - 2 * TAG_SIZE);
+
+    r = (region *) mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (r == MAP_FAILED)
+        return NULL;
+
+    r->size = bytes;
+    r->prev = NULL;
+    r->next = pool->regions;
+    if (pool->regions != NULL)
+        pool->regions->prev = r;
+    pool->regions = r;
+    pool->mapped += bytes;
+
+    header = region_first_block(r);
+    *((int *) (header - TAG_SIZE)) = REGION_SENTINEL;
+    set_tags(header, payload);
+    *((int *) (header + 2 * TAG_SIZE + payload)) = REGION_SENTINEL;
+    tree_insert(pool, header);
+
+    return r;
+}
+
+/*! Returns nonzero if a region's blocks have all been freed. */
+static int region_empty(region *r) {
+    unsigned char *header = region_first_block(r);
+    int size = block_size(header);
+
+    return size > 0 &&
+           *((int *) (header + 2 * TAG_SIZE + size)) == REGION_SENTINEL;
+}
+
+/*! Unmaps a region, which the caller has already taken out of the tree. */
+static void region_unmap(myalloc_pool_t *pool, region *r) {
+    if (r->prev != NULL)
+        r->prev->next = r->next;
+    else
+        pool->regions = r->next;
+    if (r->next != NULL)
+        r->next->prev = r->prev;
+
+    pool->mapped -= r->size;
+    munmap(r, r->size);
+}
+
+/*!
+ * Maps a new region with room for a block of "size" payload bytes.  Regions
+ * are at least MIN_REGION_SIZE, rounded up to whole pages, but never take
+ * the pool past its limit.  If the limit is in the way and the spare region
+ * is still empty, the spare is unmapped to make room; its block was too
+ * small, or the caller would have found it.  Returns zero if the limit or
+ * the system won't allow a big enough region.
+ */
+static int grow(myalloc_pool_t *pool, int size) {
+    long needed = (long) size + REGION_OVERHEAD + 2 * TAG_SIZE;
+    long bytes = (needed > MIN_REGION_SIZE) ? needed : MIN_REGION_SIZE;
+    long page = sysconf(_SC_PAGESIZE);
+
+    if (needed > pool->size - pool->mapped && pool->spare != NULL &&
+        region_empty(pool->spare)) {
+        tree_remove(pool, region_first_block(pool->spare));
+        region_unmap(pool, pool->spare);
+        pool->spare = NULL;
+    }
+
+    // mmap() hands out whole pages, so use all of the last one
+    bytes = (bytes + page - 1) / page * page;
+    if (bytes > pool->size - pool->mapped)
+        bytes = pool->size - pool->mapped;
+    if (bytes < needed)
+        return 0;
+
+    return region_map(pool, bytes) != NULL;
+}
+
+
+/*!
+ * This function initializes the allocator state, and maps the first region
+ * of a new allocator instance.  "size" is the most memory the pool may ever
+ * map, counting region headers and sentinels; the first region is only as
+ * big as MIN_REGION_SIZE.
+ */
+myalloc_pool_t * myalloc_pool_create(int size) {
+    myalloc_pool_t *pool = (myalloc_pool_t *) malloc(sizeof(myalloc_pool_t));
+    long first = (size < MIN_REGION_SIZE) ? size : MIN_REGION_SIZE;
+
+    if (pool == 0) {
+        fprintf(stderr,
+                "myalloc_pool_create: could not get %d bytes from the system\n",
+                size);
+        abort();
+    }
+    pool->size = size;
+    pool->mapped = 0;
+    pool->regions = NULL;
+    pool->spare = NULL;
+
+    rb_init(&pool->free_tree);
+    pool->allocs = 0;
+    pool->headers_touched = 0;
+
+    if (first >= REGION_OVERHEAD + 2 * TAG_SIZE + MIN_PAYLOAD &&
+        region_map(pool, first) == NULL) {
+        fprintf(stderr,
+                "myalloc_pool_create: could not get %ld bytes from the system\n",
+                first);
+        abort();
+    }
+    return pool;
+}
+
+
+/*!
+ * The smallest pool that can hold a block:  one region's header and sentinels,
+ * and two tags around the smallest payload.
+ */
+int myalloc_pool_min_size() {
+    return REGION_OVERHEAD + 2 * TAG_SIZE + MIN_PAYLOAD;
+}
+
+
+/*!
+ * Attempt to allocate a chunk of memory of "size" bytes.  Return 0 if
+ * allocation fails.
+ *
+ * This is the same O(log n) best-fit search as the tree allocator.  When no
+ * free block is big enough, we map a new region and take the block from
+ * there, and only fail once the pool has reached its limit.
+ */
+unsigned char *myalloc_pool_alloc(myalloc_pool_t *pool, int size) {
+    unsigned char *best;
+    int best_size;
+
+    if (size < MIN_PAYLOAD)
+        size = MIN_PAYLOAD;
+
+    pool->allocs++;
+    best = tree_best_fit(pool, size);
+    if (best == NULL && grow(pool, size))
+        best = tree_best_fit(pool, size);
+
+    if (best == NULL) {
+        fprintf(stderr, "myalloc: cannot service request of size %d\n", size);
+        return (unsigned char *) 0;
+    }
+
+    tree_remove(pool, best);
+    best_size = block_size(best);
+
+    // split off the tail if it can hold a block of its own
+    if (best_size - size >= 2 * TAG_SIZE + MIN_PAYLOAD) {
+        unsigned char *rest = best + 2 * TAG_SIZE + size;
+        set_tags(rest, best_size - size - 2 * TAG_SIZE);
+        tree_insert(pool, rest);
+        best_size = size;
+    }
+
+    set_tags(best, -best_size);
+    return best + TAG_SIZE;
+}
+
+
+/*!
+ * Free a previously allocated pointer.  oldptr should be an address returned by
+ * myalloc().
+ *
+ * Coalescing works as in the tree allocator, except that the sentinels stop
+ * it at the ends of the region.  When the merged block has a sentinel on
+ * both sides, it is the whole region.  Unless that is the first region, it
+ * becomes the spare, and the previous spare goes back to the system if it
+ * is still empty.
+ */
+void myalloc_pool_free(myalloc_pool_t *pool, unsigned char *oldptr) {
+    unsigned char *header = oldptr - TAG_SIZE;
+    int size = abs(block_size(header));
+    int left_size;
+    region *r;
+
+    // merge with the right neighbour
+    unsigned char *right = header + 2 * TAG_SIZE + size;
+    if (block_size(right) > 0) {
+        tree_remove(pool, right);
+        size += 2 * TAG_SIZE + block_size(right);
+    }
+
+    // merge with the left neighbour
+    left_size = *((int *) (header - TAG_SIZE));
+    if (left_size > 0) {
+        unsigned char *left = header - 2 * TAG_SIZE - left_size;
+        tree_remove(pool, left);
+        size += 2 * TAG_SIZE + left_size;
+        header = left;
+    }
+
+    set_tags(header, size);
+
+    // a region with nothing left in it
+    if (*((int *) (header - TAG_SIZE)) == REGION_SENTINEL &&
+        *((int *) (header + 2 * TAG_SIZE + size)) == REGION_SENTINEL) {
+        r = (region *) (header - TAG_SIZE) - 1;
+        if (r->next != NULL) {
+            if (pool->spare != NULL && pool->spare != r &&
+                region_empty(pool->spare)) {
+                tree_remove(pool, region_first_block(pool->spare));
+                region_unmap(pool, pool->spare);
+            }
+            pool->spare = r;
+        }
+    }
+
+    tree_insert(pool, header);
+}
+
+
+/*!
+ * Resize a previously allocated pointer to "size" bytes, preserving its
+ * contents up to the smaller of the two sizes.  Return the (possibly moved)
+ * block, or 0 if the request can't be serviced, in which case the old block
+ * is left alone.
+ *
+ * This is the shared btag_realloc(), as in the tree allocator.  The
+ * sentinels keep a block from growing past its region, and if it has to
+ * move, myalloc_pool_alloc() may map a new region for it.
+ */
+unsigned char *myalloc_pool_realloc(myalloc_pool_t *pool, unsigned char *oldptr,
+                                    int size) {
+    return btag_realloc(pool, &tag_ops, oldptr, size);
+}
+
+
+/*!
+ * Report on the pool's free space by walking the blocks of every region,
+ * from the first block up to the epilogue.
+ */
+void myalloc_pool_stats(myalloc_pool_t *pool, myalloc_stats *stats) {
+    region *r;
+
+    stats->free_bytes = 0;
+    stats->largest_free = 0;
+    stats->free_blocks = 0;
+    stats->allocs = pool->allocs;
+    stats->headers_touched = pool->headers_touched;
+
+    // the epilogue is the last tag in the region's mapping
+    for (r = pool->regions; r != NULL; r = r->next) {
+        btag_count_free(region_first_block(r),
+                        (unsigned char *) r + r->size - TAG_SIZE, stats);
+    }
+}
+
+
+/*!
+ * Clean up the allocator state by unmapping every region.
+ */
+void myalloc_pool_destroy(myalloc_pool_t *pool) {
+    region *r, *next;
+
+    for (r = pool->regions; r != NULL; r = next) {
+        next = r->next;
+        munmap(r, r->size);
+    }
+    free(pool);
+}
+
+
+/*!
+ * The single-pool interface.  These work against the default pool of
+ * MEMORY_SIZE bytes, which init_myalloc() must create before myalloc() or
+ * myfree() will work at all.
+ */
+void init_myalloc() {
+    default_pool = myalloc_pool_create(MEMORY_SIZE);
+}
+
+unsigned char *myalloc(int size) {
+    return myalloc_pool_alloc(default_pool, size);
+}
+
+void myfree(unsigned char *oldptr) {
+    myalloc_pool_free(default_pool, oldptr);
+}
+
+unsigned char *myrealloc(unsigned char *oldptr, int size) {
+    return myalloc_pool_realloc(default_pool, oldptr, size);
+}
+
+void close_myalloc() {
+    myalloc_pool_destroy(default_pool);
+    default_pool = NULL;
+}
@@ -0,0 +1,246 @@
+/*! \file
+ * A multithreaded stress test and benchmark for the thread-caching front end
+ * in tcache.c.  Each thread keeps a set of live blocks and repeatedly frees
+ * and replaces random ones.  Some of the blocks are passed to the next thread
+ * over, which frees them, so cross-thread frees get exercised too.  Every
+ * block is filled with a pattern when it is allocated and checked when it is
+ * freed.
+ *
+ * For each thread count from 1 up to the maximum (doubling each time), the
+ * test runs once with the thread caches and once with only the locked shared
+ * pool, and reports operations per second for both.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "tcache.h"
+
+
+#define DEFAULT_MAX_THREADS 8
+#define DEFAULT_OPS 200000
+#define DEFAULT_POOL_SIZE (64 * 1024 * 1024)
+
+/*! How many live blocks each thread keeps. */
+#define SLOTS 256
+
+/*! One in this many frees hands the block to the next thread instead. */
+#define HANDOFF_RATE 8
+
+
+/*! A block and its size, as passed between threads. */
+typedef struct handoff {
+    unsigned char *block;
+    int size;
+} handoff;
+
+
+/*! Per-thread arguments and results. */
+typedef struct worker {
+    int id;
+    int nthreads;
+    int ops;
+    unsigned int seed;
+    long errors;
+} worker;
+
+
+/*!
+ * One mailbox per thread.  Thread i posts blocks to mailbox (i + 1) % n with
+ * an atomic exchange, and frees whatever it displaced, which was allocated
+ * by thread i - 1.
+ */
+static _Atomic(handoff *) mailboxes[64];
+
+
+/*! Picks a block size: mostly small, occasionally too big to be cached. */
+static int random_size(unsigned int *seed) {
+    if (rand_r(seed) % 64 == 0)
+        return 1024 + rand_r(seed) % 4096;
+    return 1 + rand_r(seed) % 512;
+}
+
+
+static void fill(unsigned char *block, int size) {
+    int i;
+    for (i = 0; i < size; i++)
+        block[i] = (unsigned char) (size + i);
+}
+
+
+/* Returns nonzero if the block still holds the pattern fill() put there. */
+static int intact(unsigned char *block, int size) {
+    int i;
+    for (i = 0; i < size; i++) {
+        if (block[i] != (unsigned char) (size + i))
+            return 0;
+    }
+    return 1;
+}
+
+
+static void check_and_free(worker *w, unsigned char *block, int size) {
+    if (!intact(block, size))
+        w->errors++;
+    tc_free(block);
+}
+
+
+void *run_worker(void *arg) {
+    worker *w = (worker *) arg;
+    unsigned char *blocks[SLOTS] = { NULL };
+    int sizes[SLOTS];
+    handoff *h, *old;
+    int i, slot;
+
+    for (i = 0; i < w->ops; i++) {
+        slot = rand_r(&w->seed) % SLOTS;
+
+        if (blocks[slot] != NULL) {
+            if (w->nthreads > 1 && rand_r(&w->seed) % HANDOFF_RATE == 0) {
+                h = (handoff *) malloc(sizeof(handoff));
+                h->block = blocks[slot];
+                h->size = sizes[slot];
+                old = atomic_exchange(&mailboxes[(w->id + 1) % w->nthreads], h);
+                if (old != NULL) {
+                    check_and_free(w, old->block, old->size);
+                    free(old);
+                }
+            }
+            else {
+                check_and_free(w, blocks[slot], sizes[slot]);
+            }
+            blocks[slot] = NULL;
+        }
+        else {
+            sizes[slot] = random_size(&w->seed);
+            blocks[slot] = tc_alloc(sizes[slot]);
+            if (blocks[slot] == NULL) {
+                fprintf(stderr, "thread %d: pool exhausted\n", w->id);
+                abort();
+            }
+            fill(blocks[slot], sizes[slot]);
+        }
+    }
+
+    for (slot = 0; slot < SLOTS; slot++) {
+        if (blocks[slot] != NULL)
+            check_and_free(w, blocks[slot], sizes[slot]);
+    }
+
+    tc_thread_exit();
+    return NULL;
+}
+
+
+/*!
+ * Runs one round with "nthreads" threads, and returns the number of
+ * operations per second.  Each alloc and each free counts as an operation.
+ */
+double run_round(int nthreads, int ops, int pool_size, int use_caches,
+                 long *errors) {
+    pthread_t threads[64];
+    worker workers[64];
+    struct timespec start, end;
+    double elapsed;
+    handoff *h;
+    int i;
+
+    tc_init(pool_size, use_caches);
+    for (i = 0; i < nthreads; i++)
+        atomic_init(&mailboxes[i], NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < nthreads; i++) {
+        workers[i].id = i;
+        workers[i].nthreads = nthreads;
+        workers[i].ops = ops;
+        workers[i].seed = i + 1;
+        workers[i].errors = 0;
+        pthread_create(&threads[i], NULL, run_worker, &workers[i]);
+    }
+    for (i = 0; i < nthreads; i++)
+        pthread_join(threads[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    // blocks still sitting in mailboxes
+    for (i = 0; i < nthreads; i++) {
+        h = atomic_exchange(&mailboxes[i], NULL);
+        if (h != NULL) {
+            if (!intact(h->block, h->size))
+                workers[i].errors++;
+            tc_free(h->block);
+            free(h);
+        }
+        *errors += workers[i].errors;
+    }
+    tc_close();
+
+    elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    return (double) nthreads * ops / elapsed;
+}
+
+
+void usage(char *program) {
+    printf("usage: %s [-t max_threads] [-n ops_per_thread] [-m pool_size]\n",
+           program);
+    printf("\tRuns the multithreaded allocator stress test.\n\n");
+    printf("\t-t max_threads sets the largest thread count to try (up to 64)\n");
+    printf("\t-n ops_per_thread sets how many operations each thread does\n");
+    printf("\t-m pool_size sets the size of the shared pool in bytes\n\n");
+}
+
+
+int main(int argc, char *argv[]) {
+    int max_threads = DEFAULT_MAX_THREADS;
+    int ops = DEFAULT_OPS;
+    int pool_size = DEFAULT_POOL_SIZE;
+    double cached, locked;
+    long errors = 0;
+    int nthreads;
+    int c;
+
+    while ((c = getopt(argc, argv, "t:n:m:h")) != -1) {
+        switch (c) {
+        case 't':
+            max_threads = atoi(optarg);
+            break;
+
+        case 'n':
+            ops = atoi(optarg);
+            break;
+
+        case 'm':
+            pool_size = atoi(optarg);
+            break;
+
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (max_threads < 1 || max_threads > 64 || ops < 1 || pool_size < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("threads  locked ops/sec  cached ops/sec  speedup\n");
+    for (nthreads = 1; nthreads <= max_threads; nthreads *= 2) {
+        locked = run_round(nthreads, ops, pool_size, 0, &errors);
+        cached = run_round(nthreads, ops, pool_size, 1, &errors);
+        printf("%7d  %14.0f  %14.0f  %7.2f\n", nthreads, locked, cached,
+               cached / locked);
+    }
+
+    if (errors != 0) {
+        printf("Data integrity FAIL (%ld corrupted blocks).\n", errors);
+        return 1;
+    }
+    printf("Data integrity PASS.\n");
+    return 0;
+}
@@ -12,22 +12,35 @@
 #include <stdlib.h>
 
 #include "myalloc.h"
+#include "btag.h"
 
 
 /*!
- * These variables are used to specify the size and address of the memory pool
- * that the simple allocator works against.  The memory pool is allocated within
- * init_myalloc(), and then myalloc() and free() work against this pool of
- * memory that mem points to.
+ * The state of one allocator instance:  the size and address of the memory
+ * pool it works against.  The memory pool is allocated within
+ * myalloc_pool_create(), and then myalloc_pool_alloc() and myalloc_pool_free()
+ * work against the pool of memory that mem points to.
+ */
+struct myalloc_pool {
+    int size;
+    unsigned char *mem;
+
+    long allocs;
+    long headers_touched;
+};
+
+
+/*!
+ * MEMORY_SIZE specifies the size of the default pool, which init_myalloc()
+ * creates and myalloc() and myfree() work against.
  */
 int MEMORY_SIZE;
-unsigned char *mem;
-static unsigned char *freeptr;
+static myalloc_pool_t *default_pool;
 
 
 /*!
- * This function initializes both the allocator state, and the memory pool.  It
- * must be called before myalloc() or myfree() will work at all.
+ * This function initializes both the allocator state, and the memory pool of a
+ * new allocator instance.
  *
  * Note that we allocate the entire memory pool using malloc().  This is so we
  * can create different memory-pool sizes for testing.  Obviously, in a real
@@ -35,23 +48,39 @@ static unsigned char *freeptr;
  * allocator would request a memory region from the operating system (see the
  * C standard function sbrk(), for example).
  */
-void init_myalloc() {
+myalloc_pool_t * myalloc_pool_create(int size) {
+    myalloc_pool_t *pool = (myalloc_pool_t *) malloc(sizeof(myalloc_pool_t));
+    unsigned char *mem;
 
     /*
      * Allocate the entire memory pool, from which our simple allocator will
      * serve allocation requests.
      */
-    mem = (unsigned char *) malloc(MEMORY_SIZE);
-    if (mem == 0) {
+    mem = (unsigned char *) malloc(size);
+    if (pool == 0 || mem == 0) {
         fprintf(stderr,
-                "init_myalloc: could not get %d bytes from the system\n",
-		MEMORY_SIZE);
+                "myalloc_pool_create: could not get %d bytes from the system\n",
+                size);
         abort();
     }
-    freeptr = mem;
-    *((int*) mem) = MEMORY_SIZE - 2*sizeof(int);
-    freeptr += MEMORY_SIZE - sizeof(int);
-    *((int*) freeptr) = MEMORY_SIZE - 2*sizeof(int);
+    pool->size = size;
+    pool->mem = mem;
+    pool->allocs = 0;
+    pool->headers_touched = 0;
+
+    *((int*) mem) = size - 2*sizeof(int);
+    *((int*) (mem + size - sizeof(int))) = size - 2*sizeof(int);
+    return pool;
+}
+
+
+/*!
+ * The smallest pool that can hold a block:  a header, a footer and one byte of
+ * payload.  myalloc_pool_create() writes the first block's tags without
+ * checking, so it must never be given less than this.
+ */
+int myalloc_pool_min_size() {
+    return 2 * sizeof(int) + 1;
 }
 
 
@@ -65,18 +94,22 @@ void init_myalloc() {
  * block for our allocation, we must access each one and check its size. As
  * a result, our allocation is O(n) in the number of blocks.
  */
-unsigned char *myalloc(int size) {
+unsigned char *myalloc_pool_alloc(myalloc_pool_t *pool, int size) {
+     unsigned char * mem = pool->mem;
      // points to the header of the first block
      unsigned char * current_block = mem;
      // get size of the first block
      int current_space = *((int *) current_block);
      // set initial best parameters
      unsigned char * best = NULL;
-     int best_size = MEMORY_SIZE;
+     int best_size = pool->size;
+
+     pool->allocs++;
+     pool->headers_touched++;
 
      // check if we've reached the end
      unsigned char * end = current_block + abs(current_space) + 2*sizeof(int);
-     while (end <= mem + MEMORY_SIZE) {
+     while (end <= mem + pool->size) {
        // check if this block fits and if it beats the current best block
        if (current_space >= size && current_space < best_size) {
           best = current_block;
@@ -89,6 +122,7 @@ unsigned char *myalloc(int size) {
          // current space dereferences the header to get the amount of
          // space available
          current_space =  *((int *) current_block);
+         pool->headers_touched++;
        }
        end = current_block + abs(current_space) + 2*sizeof(int);
      }
@@ -131,7 +165,8 @@ unsigned char *myalloc(int size) {
  * adjacent blocks runs in constant time with respect to the number of memory
  * blocks.
  */
-void myfree(unsigned char *oldptr) {
+void myalloc_pool_free(myalloc_pool_t *pool, unsigned char *oldptr) {
+  unsigned char * mem = pool->mem;
   unsigned char * header = oldptr;
   unsigned char * footer = oldptr;
   unsigned char * right = NULL;
@@ -141,7 +176,7 @@ void myfree(unsigned char *oldptr) {
   int right_size = 0;
 
   // check right block
-  if (oldptr + abs(size) +  sizeof(int) < mem + MEMORY_SIZE) {
+  if (oldptr + abs(size) +  sizeof(int) < mem + pool->size) {
     // get the header of the right block
     right = oldptr + abs(size) + sizeof(int);
     // get size from the header
@@ -183,12 +218,86 @@ void myfree(unsigned char *oldptr) {
   *((int*) footer) = size;
 }
 
+/*!
+ * Returns nonzero if "tag" lies inside the pool.  The pool has no free list
+ * to unlink neighbours from, since myalloc_pool_alloc() walks every block.
+ */
+static int in_pool(myalloc_pool_t *pool, unsigned char *tag) {
+  return tag >= pool->mem && tag < pool->mem + pool->size;
+}
+
+/*!
+ * How the shared boundary-tag code finds neighbours.  A tail is split off
+ * whenever it can hold at least one byte.
+ */
+static const btag_ops tag_ops = { 1, in_pool, NULL };
+
+
+/*!
+ * Resize a previously allocated pointer to "size" bytes, preserving its
+ * contents up to the smaller of the two sizes.  Return the (possibly moved)
+ * block, or 0 if the request can't be serviced, in which case the old block
+ * is left alone.
+ * The header and footer tags tell us in constant time whether the blocks on
+ * either side are free, so the shared btag_realloc() can shrink in place,
+ * grow into a free right or left neighbour, and only move the block when
+ * neither works.
+ */
+unsigned char *myalloc_pool_realloc(myalloc_pool_t *pool, unsigned char *oldptr,
+                                    int size) {
+  return btag_realloc(pool, &tag_ops, oldptr, size);
+}
+
+
+/*!
+ * Report on the pool's free space by walking every block through its
+ * header, the same way myalloc_pool_alloc() does.
+ */
+void myalloc_pool_stats(myalloc_pool_t *pool, myalloc_stats *stats) {
+  stats->free_bytes = 0;
+  stats->largest_free = 0;
+  stats->free_blocks = 0;
+  stats->allocs = pool->allocs;
+  stats->headers_touched = pool->headers_touched;
+
+  btag_count_free(pool->mem, pool->mem + pool->size, stats);
+}
+
+
 /*!
  * Clean up the allocator state.
  * All this really has to do is free the user memory pool. This function mostly
  * ensures that the test program doesn't leak memory, so it's easy to check
  * if the allocator does.
  */
+void myalloc_pool_destroy(myalloc_pool_t *pool) {
+    free(pool->mem);
+    free(pool);
+}
+
+
+/*!
+ * The single-pool interface.  These work against the default pool of
+ * MEMORY_SIZE bytes, which init_myalloc() must create before myalloc() or
+ * myfree() will work at all.
+ */
+void init_myalloc() {
+    default_pool = myalloc_pool_create(MEMORY_SIZE);
+}
+
+unsigned char *myalloc(int size) {
+    return myalloc_pool_alloc(default_pool, size);
+}
+
+void myfree(unsigned char *oldptr) {
+    myalloc_pool_free(default_pool, oldptr);
+}
+
+unsigned char *myrealloc(unsigned char *oldptr, int size) {
+    return myalloc_pool_realloc(default_pool, oldptr, size);
+}
+
 void close_myalloc() {
-    free(mem);
+    myalloc_pool_destroy(default_pool);
+    default_pool = NULL;
 }
@@ -3,6 +3,12 @@
  * pool of memory, provides memory chunks on request, and reintegrates freed
  * memory back into the pool.
  *
+ * Each allocator instance is a myalloc_pool_t with its own memory pool, so
+ * several pools can be used at once, from different threads if each pool is
+ * only used by one thread at a time.  The original functions (init_myalloc(),
+ * myalloc(), myrealloc(), myfree() and close_myalloc()) are thin wrappers
+ * that work against a single default pool of MEMORY_SIZE bytes.
+ *
  * Adapted from Andre DeHon's CS24 2004, 2006 material.
  * Copyright (C) California Institute of Technology, 2004-2009.
  * All rights reserved.
@@ -13,6 +19,55 @@
 extern int MEMORY_SIZE;
 
 
+/*! An allocator instance.  The contents are private to each implementation. */
+typedef struct myalloc_pool myalloc_pool_t;
+
+
+/* Create an allocator instance that manages a pool of "size" bytes. */
+myalloc_pool_t * myalloc_pool_create(int size);
+
+
+/* The smallest pool size that can hold a block at all.  Smaller pools must
+ * not be created, since some allocators write their bookkeeping without
+ * checking that it fits.
+ */
+int myalloc_pool_min_size();
+
+
+/* Attempt to allocate a chunk of memory of "size" bytes from "pool". */
+unsigned char * myalloc_pool_alloc(myalloc_pool_t *pool, int size);
+
+
+/* Free a pointer previously allocated from "pool". */
+void myalloc_pool_free(myalloc_pool_t *pool, unsigned char *oldptr);
+
+
+/* Resize a chunk allocated from "pool" to "size" bytes, moving it if needed. */
+unsigned char * myalloc_pool_realloc(myalloc_pool_t *pool, unsigned char *oldptr,
+                                     int size);
+
+
+/*!
+ * A snapshot of a pool's free space, plus counters of the work its
+ * allocations have done, for benchmarking and fragmentation reports.
+ */
+typedef struct myalloc_stats {
+    long free_bytes;        /*!< Total payload bytes in free blocks. */
+    long largest_free;      /*!< Payload bytes in the largest free block. */
+    long free_blocks;       /*!< Number of free blocks. */
+    long allocs;            /*!< myalloc_pool_alloc() calls so far. */
+    long headers_touched;   /*!< Blocks examined by those calls' searches. */
+} myalloc_stats;
+
+
+/* Fill in "stats" for "pool".  This walks the pool, so it isn't cheap. */
+void myalloc_pool_stats(myalloc_pool_t *pool, myalloc_stats *stats);
+
+
+/* Release an allocator instance along with its memory pool. */
+void myalloc_pool_destroy(myalloc_pool_t *pool);
+
+
 /* Initializes allocator state, and memory pool state too. */
 void init_myalloc();
 
@@ -25,5 +80,9 @@ unsigned char * myalloc(int size);
 void myfree(unsigned char *oldptr);
 
 
+/* Resize a previously allocated pointer to "size" bytes. */
+unsigned char * myrealloc(unsigned char *oldptr, int size);
+
+
 /* Clean up the allocator and memory pool state. */
 void close_myalloc();
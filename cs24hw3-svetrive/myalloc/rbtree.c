@@ -0,0 +1,261 @@
+/*! \file
+ * The red-black tree of free blocks shared by the best-fit myalloc backends.
+ * See rbtree.h.  The operations follow CLRS chapter 13.
+ *
+ * Adapted from Andre DeHon's CS24 2004, 2006 material.
+ * Copyright (C) California Institute of Technology, 2004-2010.
+ * All rights reserved.
+ */
+
+#include <stddef.h>
+
+#include "rbtree.h"
+
+
+#define NIL (&tree->nil_node)
+
+
+/*! The size of a node's block, from the boundary tag just before it. */
+static int node_size(rb_node *n) {
+    return *((int *) n - 1);
+}
+
+
+/*! Orders free blocks by size, then by address. */
+static int node_less(rb_node *a, rb_node *b) {
+    int sa = node_size(a), sb = node_size(b);
+    if (sa != sb)
+        return sa < sb;
+    return a < b;
+}
+
+
+void rb_init(rb_tree *tree) {
+    NIL->left = NIL->right = NIL->parent = NIL;
+    NIL->color = BLACK;
+    tree->root = NIL;
+}
+
+
+static void rotate_left(rb_tree *tree, rb_node *x) {
+    rb_node *y = x->right;
+
+    x->right = y->left;
+    if (y->left != NIL)
+        y->left->parent = x;
+    y->parent = x->parent;
+    if (x->parent == NIL)
+        tree->root = y;
+    else if (x == x->parent->left)
+        x->parent->left = y;
+    else
+        x->parent->right = y;
+    y->left = x;
+    x->parent = y;
+}
+
+static void rotate_right(rb_tree *tree, rb_node *x) {
+    rb_node *y = x->left;
+
+    x->left = y->right;
+    if (y->right != NIL)
+        y->right->parent = x;
+    y->parent = x->parent;
+    if (x->parent == NIL)
+        tree->root = y;
+    else if (x == x->parent->right)
+        x->parent->right = y;
+    else
+        x->parent->left = y;
+    y->right = x;
+    x->parent = y;
+}
+
+
+void rb_insert(rb_tree *tree, rb_node *z) {
+    rb_node *y = NIL;
+    rb_node *x = tree->root;
+
+    while (x != NIL) {
+        y = x;
+        x = node_less(z, x) ? x->left : x->right;
+    }
+
+    z->parent = y;
+    if (y == NIL)
+        tree->root = z;
+    else if (node_less(z, y))
+        y->left = z;
+    else
+        y->right = z;
+    z->left = NIL;
+    z->right = NIL;
+    z->color = RED;
+
+    // restore the red-black properties
+    while (z->parent->color == RED) {
+        if (z->parent == z->parent->parent->left) {
+            y = z->parent->parent->right;
+            if (y->color == RED) {
+                z->parent->color = BLACK;
+                y->color = BLACK;
+                z->parent->parent->color = RED;
+                z = z->parent->parent;
+            }
+            else {
+                if (z == z->parent->right) {
+                    z = z->parent;
+                    rotate_left(tree, z);
+                }
+                z->parent->color = BLACK;
+                z->parent->parent->color = RED;
+                rotate_right(tree, z->parent->parent);
+            }
+        }
+        else {
+            y = z->parent->parent->left;
+            if (y->color == RED) {
+                z->parent->color = BLACK;
+                y->color = BLACK;
+                z->parent->parent->color = RED;
+                z = z->parent->parent;
+            }
+            else {
+                if (z == z->parent->left) {
+                    z = z->parent;
+                    rotate_right(tree, z);
+                }
+                z->parent->color = BLACK;
+                z->parent->parent->color = RED;
+                rotate_left(tree, z->parent->parent);
+            }
+        }
+    }
+    tree->root->color = BLACK;
+}
+
+
+/*! Puts subtree v where subtree u used to hang. */
+static void transplant(rb_tree *tree, rb_node *u, rb_node *v) {
+    if (u->parent == NIL)
+        tree->root = v;
+    else if (u == u->parent->left)
+        u->parent->left = v;
+    else
+        u->parent->right = v;
+    v->parent = u->parent;
+}
+
+
+void rb_remove(rb_tree *tree, rb_node *z) {
+    rb_node *y = z;
+    rb_node *x, *w;
+    rb_color y_color = y->color;
+
+    if (z->left == NIL) {
+        x = z->right;
+        transplant(tree, z, z->right);
+    }
+    else if (z->right == NIL) {
+        x = z->left;
+        transplant(tree, z, z->left);
+    }
+    else {
+        y = z->right;
+        while (y->left != NIL)
+            y = y->left;
+        y_color = y->color;
+        x = y->right;
+        if (y->parent == z) {
+            x->parent = y;
+        }
+        else {
+            transplant(tree, y, y->right);
+            y->right = z->right;
+            y->right->parent = y;
+        }
+        transplant(tree, z, y);
+        y->left = z->left;
+        y->left->parent = y;
+        y->color = z->color;
+    }
+
+    if (y_color != BLACK)
+        return;
+
+    // restore the red-black properties
+    while (x != tree->root && x->color == BLACK) {
+        if (x == x->parent->left) {
+            w = x->parent->right;
+            if (w->color == RED) {
+                w->color = BLACK;
+                x->parent->color = RED;
+                rotate_left(tree, x->parent);
+                w = x->parent->right;
+            }
+            if (w->left->color == BLACK && w->right->color == BLACK) {
+                w->color = RED;
+                x = x->parent;
+            }
+            else {
+                if (w->right->color == BLACK) {
+                    w->left->color = BLACK;
+                    w->color = RED;
+                    rotate_right(tree, w);
+                    w = x->parent->right;
+                }
+                w->color = x->parent->color;
+                x->parent->color = BLACK;
+                w->right->color = BLACK;
+                rotate_left(tree, x->parent);
+                x = tree->root;
+            }
+        }
+        else {
+            w = x->parent->left;
+            if (w->color == RED) {
+                w->color = BLACK;
+                x->parent->color = RED;
+                rotate_right(tree, x->parent);
+                w = x->parent->left;
+            }
+            if (w->right->color == BLACK && w->left->color == BLACK) {
+                w->color = RED;
+                x = x->parent;
+            }
+            else {
+                if (w->left->color == BLACK) {
+                    w->right->color = BLACK;
+                    w->color = RED;
+                    rotate_left(tree, w);
+                    w = x->parent->left;
+                }
+                w->color = x->parent->color;
+                x->parent->color = BLACK;
+                w->left->color = BLACK;
+                rotate_right(tree, x->parent);
+                x = tree->root;
+            }
+        }
+    }
+    x->color = BLACK;
+}
+
+
+rb_node * rb_best_fit(rb_tree *tree, int size, long *touched) {
+    rb_node *best = NIL;
+    rb_node *n = tree->root;
+
+    while (n != NIL) {
+        (*touched)++;
+        if (node_size(n) >= size) {
+            best = n;
+            n = n->left;
+        }
+        else {
+            n = n->right;
+        }
+    }
+
+    return (best == NIL) ? NULL : best;
+}
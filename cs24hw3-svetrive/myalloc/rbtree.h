@@ -0,0 +1,53 @@
+/*! \file
+ * Declarations for the red-black tree that the best-fit myalloc backends
+ * (tree_myalloc.c and grow_myalloc.c) index their free blocks with.
+ *
+ * Each free block holds its rb_node at the start of its payload, so the
+ * node's address is the payload address, and the block's size is the int
+ * boundary tag just before it.  The tree is ordered by (size, address), so
+ * the leftmost node that is large enough is the smallest block that fits,
+ * lowest address first among equal sizes.
+ */
+
+
+/*! Node colors for the red-black tree. */
+typedef enum rb_color { RED, BLACK } rb_color;
+
+
+/*! The tree node stored at the start of every free block's payload. */
+typedef struct rb_node {
+    struct rb_node *left;
+    struct rb_node *right;
+    struct rb_node *parent;
+    rb_color color;
+} rb_node;
+
+
+/*!
+ * A tree of free blocks.  nil_node is the sentinel that stands in for every
+ * leaf and for the root's parent.  Its parent field is scribbled on during
+ * deletion, exactly as in CLRS, which is why each tree needs its own.
+ */
+typedef struct rb_tree {
+    rb_node *root;
+    rb_node nil_node;
+} rb_tree;
+
+
+/* Make "tree" empty. */
+void rb_init(rb_tree *tree);
+
+
+/* Add the free block whose payload starts at "node" to the tree. */
+void rb_insert(rb_tree *tree, rb_node *node);
+
+
+/* Remove the free block whose payload starts at "node" from the tree. */
+void rb_remove(rb_tree *tree, rb_node *node);
+
+
+/* Return the node of the smallest free block with at least "size" payload
+ * bytes, lowest address first among ties, or NULL if no block is big
+ * enough.  Every node looked at on the way down is counted in *touched.
+ */
+rb_node * rb_best_fit(rb_tree *tree, int size, long *touched);
@@ -0,0 +1,338 @@
+/*! \file
+ * Implementation of a segregated-fit memory allocator.  The allocator manages
+ * a small pool of memory, provides memory chunks on request, and reintegrates
+ * freed memory back into the pool.
+ *
+ * Blocks use the same header/footer boundary tags as the best-fit allocator:
+ * an int holding the payload size at each end, negated while the block is
+ * allocated.  Free blocks additionally store a pair of list pointers at the
+ * start of their payload, linking them into one of NUM_CLASSES free lists.
+ * Size class k holds free blocks whose payload is in [2^k, 2^(k+1)).
+ *
+ * Adapted from Andre DeHon's CS24 2004, 2006 material.
+ * Copyright (C) California Institute of Technology, 2004-2010.
+ * All rights reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "myalloc.h"
+#include "btag.h"
+
+
+/*! Number of power-of-two size classes; enough for any int payload size. */
+#define NUM_CLASSES 32
+
+
+/*!
+ * The links stored at the start of every free block's payload.  Allocated
+ * blocks don't carry these, so the smallest payload we ever hand out has to
+ * be big enough to hold them once the block is freed again.
+ */
+typedef struct free_links {
+    unsigned char *prev;   /*!< Header of the previous block in the class. */
+    unsigned char *next;   /*!< Header of the next block in the class. */
+} free_links;
+
+/*! Smallest payload a block may have. */
+#define MIN_PAYLOAD ((int) sizeof(free_links))
+
+
+/*!
+ * The state of one allocator instance:  the size and address of its memory
+ * pool, and the heads of its free lists, one per size class.  Bit k of
+ * nonempty_classes is set when free_lists[k] is non-empty.
+ */
+struct myalloc_pool {
+    int size;
+    unsigned char *mem;
+    unsigned char *free_lists[NUM_CLASSES];
+    unsigned int nonempty_classes;
+
+    long allocs;
+    long headers_touched;
+};
+
+
+/*!
+ * MEMORY_SIZE specifies the size of the default pool, which init_myalloc()
+ * creates and myalloc() and myfree() work against.
+ */
+int MEMORY_SIZE;
+static myalloc_pool_t *default_pool;
+
+
+/* Free-list helpers.  The boundary tags are handled by btag.h. */
+
+static free_links * links(unsigned char *header) {
+    return (free_links *) (header + TAG_SIZE);
+}
+
+
+/*! Returns the size class a free block with "size" payload bytes lives in. */
+static int size_class(int size) {
+    return 31 - __builtin_clz((unsigned int) size);
+}
+
+
+/*!
+ * Returns the smallest size class whose blocks are all at least "size" bytes,
+ * i.e. the class of size rounded up to a power of two.
+ */
+static int fit_class(int size) {
+    int k = size_class(size);
+    if (size & (size - 1))
+        k++;
+    return k;
+}
+
+
+/*! Pushes the free block at "header" onto the front of its class list. */
+static void list_insert(myalloc_pool_t *pool, unsigned char *header) {
+    int k = size_class(block_size(header));
+    free_links *l = links(header);
+
+    l->prev = NULL;
+    l->next = pool->free_lists[k];
+    if (pool->free_lists[k] != NULL)
+        links(pool->free_lists[k])->prev = header;
+    pool->free_lists[k] = header;
+    pool->nonempty_classes |= 1u << k;
+}
+
+
+/*! Unlinks the free block at "header" from its class list. */
+static void list_remove(myalloc_pool_t *pool, unsigned char *header) {
+    int k = size_class(block_size(header));
+    free_links *l = links(header);
+
+    if (l->prev != NULL)
+        links(l->prev)->next = l->next;
+    else
+        pool->free_lists[k] = l->next;
+
+    if (l->next != NULL)
+        links(l->next)->prev = l->prev;
+
+    if (pool->free_lists[k] == NULL)
+        pool->nonempty_classes &= ~(1u << k);
+}
+
+
+/*! Returns nonzero if "tag" lies inside the pool. */
+static int in_pool(myalloc_pool_t *pool, unsigned char *tag) {
+    return tag >= pool->mem && tag < pool->mem + pool->size;
+}
+
+/*! How the shared boundary-tag code finds and unlinks free blocks. */
+static const btag_ops tag_ops = { MIN_PAYLOAD, in_pool, list_remove };
+
+
+/*!
+ * This function initializes both the allocator state, and the memory pool of a
+ * new allocator instance.
+ *
+ * The whole pool starts out as one free block, filed under its size class.
+ */
+myalloc_pool_t * myalloc_pool_create(int size) {
+    myalloc_pool_t *pool = (myalloc_pool_t *) malloc(sizeof(myalloc_pool_t));
+    unsigned char *mem = (unsigned char *) malloc(size);
+    int k;
+
+    if (pool == 0 || mem == 0) {
+        fprintf(stderr,
+                "myalloc_pool_create: could not get %d bytes from the system\n",
+                size);
+        abort();
+    }
+    pool->size = size;
+    pool->mem = mem;
+
+    for (k = 0; k < NUM_CLASSES; k++)
+        pool->free_lists[k] = NULL;
+    pool->nonempty_classes = 0;
+    pool->allocs = 0;
+    pool->headers_touched = 0;
+
+    if (size - 2 * TAG_SIZE >= MIN_PAYLOAD) {
+        set_tags(mem, size - 2 * TAG_SIZE);
+        list_insert(pool, mem);
+    }
+    return pool;
+}
+
+
+/*!
+ * The smallest pool that can hold a block:  two tags around the smallest
+ * payload.
+ */
+int myalloc_pool_min_size() {
+    return 2 * TAG_SIZE + MIN_PAYLOAD;
+}
+
+
+/*!
+ * Attempt to allocate a chunk of memory of "size" bytes.  Return 0 if
+ * allocation fails.
+ *
+ * We round the request up to a power of two and take the head of the first
+ * non-empty class at or above that, which is guaranteed to fit; the bitmap
+ * of non-empty classes makes finding it a single bit scan.  Only when every
+ * such class is empty do we fall back to a first-fit walk of the one class
+ * that may still hold a large enough block.  Allocation is therefore O(1)
+ * except in that near-full case.
+ */
+unsigned char *myalloc_pool_alloc(myalloc_pool_t *pool, int size) {
+    unsigned char *block = NULL;
+    unsigned int candidates;
+    int block_bytes;
+    int k;
+
+    if (size < MIN_PAYLOAD)
+        size = MIN_PAYLOAD;
+
+    pool->allocs++;
+    k = fit_class(size);
+    candidates = (k < NUM_CLASSES) ? pool->nonempty_classes & (~0u << k) : 0;
+    if (candidates != 0) {
+        block = pool->free_lists[__builtin_ctz(candidates)];
+        pool->headers_touched++;
+    }
+    else {
+        // the class size falls in may still hold a block that's big enough
+        for (block = pool->free_lists[size_class(size)]; block != NULL;
+             block = links(block)->next) {
+            pool->headers_touched++;
+            if (block_size(block) >= size)
+                break;
+        }
+    }
+
+    if (block == NULL) {
+        fprintf(stderr, "myalloc: cannot service request of size %d\n", size);
+        return (unsigned char *) 0;
+    }
+
+    list_remove(pool, block);
+    block_bytes = block_size(block);
+
+    // split off the tail if it can hold a block of its own
+    if (block_bytes - size >= 2 * TAG_SIZE + MIN_PAYLOAD) {
+        unsigned char *rest = block + 2 * TAG_SIZE + size;
+        set_tags(rest, block_bytes - size - 2 * TAG_SIZE);
+        list_insert(pool, rest);
+        block_bytes = size;
+    }
+
+    set_tags(block, -block_bytes);
+    return block + TAG_SIZE;
+}
+
+
+/*!
+ * Free a previously allocated pointer.  oldptr should be an address returned by
+ * myalloc().
+ *
+ * Coalescing works exactly as in the best-fit allocator, using the footer of
+ * the left neighbour and the header of the right neighbour.  Any neighbour we
+ * merge with is unlinked from its class first, and the merged block is filed
+ * under its new class, so freeing stays constant time.
+ */
+void myalloc_pool_free(myalloc_pool_t *pool, unsigned char *oldptr) {
+    unsigned char *header = oldptr - TAG_SIZE;
+    int size = abs(block_size(header));
+
+    // merge with the right neighbour
+    unsigned char *right = header + 2 * TAG_SIZE + size;
+    if (right < pool->mem + pool->size && block_size(right) > 0) {
+        list_remove(pool, right);
+        size += 2 * TAG_SIZE + block_size(right);
+    }
+
+    // merge with the left neighbour
+    if (header > pool->mem) {
+        int left_size = *((int *) (header - TAG_SIZE));
+        if (left_size > 0) {
+            unsigned char *left = header - 2 * TAG_SIZE - left_size;
+            list_remove(pool, left);
+            size += 2 * TAG_SIZE + left_size;
+            header = left;
+        }
+    }
+
+    set_tags(header, size);
+    list_insert(pool, header);
+}
+
+
+/*!
+ * Resize a previously allocated pointer to "size" bytes, preserving its
+ * contents up to the smaller of the two sizes.  Return the (possibly moved)
+ * block, or 0 if the request can't be serviced, in which case the old block
+ * is left alone.
+ *
+ * The shared btag_realloc() shrinks in place, grows into a free right or
+ * left neighbour, or moves the block; neighbours are taken out of their
+ * class list before their space is reused.
+ */
+unsigned char *myalloc_pool_realloc(myalloc_pool_t *pool, unsigned char *oldptr,
+                                    int size) {
+    return btag_realloc(pool, &tag_ops, oldptr, size);
+}
+
+
+/*!
+ * Report on the pool's free space by walking every block through its
+ * boundary tags.
+ */
+void myalloc_pool_stats(myalloc_pool_t *pool, myalloc_stats *stats) {
+    stats->free_bytes = 0;
+    stats->largest_free = 0;
+    stats->free_blocks = 0;
+    stats->allocs = pool->allocs;
+    stats->headers_touched = pool->headers_touched;
+
+    // a pool too small for even one block has no tags at all
+    if (pool->size - 2 * TAG_SIZE >= MIN_PAYLOAD)
+        btag_count_free(pool->mem, pool->mem + pool->size, stats);
+}
+
+
+/*!
+ * Clean up the allocator state.
+ * All this really has to do is free the user memory pool. This function mostly
+ * ensures that the test program doesn't leak memory, so it's easy to check
+ * if the allocator does.
+ */
+void myalloc_pool_destroy(myalloc_pool_t *pool) {
+    free(pool->mem);
+    free(pool);
+}
+
+
+/*!
+ * The single-pool interface.  These work against the default pool of
+ * MEMORY_SIZE bytes, which init_myalloc() must create before myalloc() or
+ * myfree() will work at all.
+ */
+void init_myalloc() {
+    default_pool = myalloc_pool_create(MEMORY_SIZE);
+}
+
+unsigned char *myalloc(int size) {
+    return myalloc_pool_alloc(default_pool, size);
+}
+
+void myfree(unsigned char *oldptr) {
+    myalloc_pool_free(default_pool, oldptr);
+}
+
+unsigned char *myrealloc(unsigned char *oldptr, int size) {
+    return myalloc_pool_realloc(default_pool, oldptr, size);
+}
+
+void close_myalloc() {
+    myalloc_pool_destroy(default_pool);
+    default_pool = NULL;
+}
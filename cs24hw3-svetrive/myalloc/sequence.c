@@ -23,6 +23,7 @@ SEQLIST *seq_add_front(int size, unsigned char *ref_block, SEQLIST *next) {
   result->alloc = 1;
   result->freed = 0;
   result->size = size;
+  result->index = 0;
   result->ref_block = ref_block;
   result->myalloc_block = (unsigned char *) 0;
   result->tofree = (SEQLIST *) 0;
@@ -43,6 +44,7 @@ SEQLIST *seq_set_next_allocate(int size, unsigned char *ref_block,
   result->alloc = 1;
   result->freed = 0;
   result->size = size;
+  result->index = prev->index + 1;
   result->ref_block = ref_block;
   result->myalloc_block = (unsigned char *) 0;
   result->tofree = (SEQLIST *) 0;
@@ -65,6 +67,7 @@ SEQLIST *seq_set_next_free(SEQLIST *tofree, SEQLIST *prev) {
   result->alloc = 0;
   result->freed = 0;
   result->size = 0;
+  result->index = prev->index + 1;
   result->ref_block = (unsigned char *) 0;
   result->myalloc_block = (unsigned char *) 0;
   result->tofree = tofree;
@@ -74,10 +77,25 @@ SEQLIST *seq_set_next_free(SEQLIST *tofree, SEQLIST *prev) {
   return result;
 }
 
+SEQLIST *seq_set_next_realloc(SEQLIST *toresize, int size,
+                              unsigned char *ref_block, SEQLIST *prev) {
+
+  SEQLIST *result = seq_set_next_allocate(size, ref_block, prev);
+
+  result->alloc = 2;
+  result->tofree = toresize;
+
+  return result;
+}
+
 int seq_alloc(SEQLIST *seq) {
   return seq->alloc;
 }
 
+int seq_realloc(SEQLIST *seq) {
+  return seq->alloc == 2;
+}
+
 int seq_freed(SEQLIST *seq) {
   return seq->freed;
 }
@@ -94,6 +112,10 @@ int seq_size(SEQLIST *seq) {
   return seq->size;
 }
 
+int seq_index(SEQLIST *seq) {
+  return seq->index;
+}
+
 unsigned char * seq_ref_block(SEQLIST *seq) {
   return seq->ref_block;
 }
@@ -132,6 +154,16 @@ SEQLIST * find_nth_allocated_block(SEQLIST *seq, int n) {
   abort();
 }
 
+int seq_length(SEQLIST *seq) {
+  int cnt = 0;
+  SEQLIST *sptr;
+
+  for (sptr = seq; !seq_null(sptr); sptr = seq_next(sptr))
+    cnt++;
+
+  return cnt;
+}
+
 void seq_print(SEQLIST *seq) {
   int cnt = 0;
   SEQLIST *sptr;
@@ -140,7 +172,10 @@ void seq_print(SEQLIST *seq) {
     cnt++;
     printf("\t");
     if (seq_alloc(sptr)) {
-      printf("ALLOC");
+      if (seq_realloc(sptr))
+        printf("RALLOC");
+      else
+        printf("ALLOC");
 
       if (seq_freed(sptr))
         printf(" FREED ");
@@ -149,6 +184,9 @@ void seq_print(SEQLIST *seq) {
 
       printf("%d r=%p m=%p ", seq_size(sptr), seq_ref_block(sptr),
              seq_myalloc_block(sptr));
+
+      if (seq_realloc(sptr))
+        printf("from r %p", seq_ref_block(seq_tofree(sptr)));
     }
     else {    // dealloc
       printf("FREE  ");
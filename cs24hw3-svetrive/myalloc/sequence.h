@@ -10,13 +10,15 @@
 
 typedef struct sequence_struct {
   int alloc; // is this block an allocate
-             // 1=allocate; 0=free
+             // 1=allocate; 0=free; 2=reallocate
   int freed; // has this block been freed
   int size; // in bytes
+  int index; // position of this entry in the sequence, starting at 0
   unsigned char *ref_block; // ref. block for checking data
   unsigned char *myalloc_block; // pointer to block from myalloc
   struct sequence_struct *tofree; // for a free, the sequence_struct
-                                  // whose allocation should be freed
+                                  // whose allocation should be freed;
+                                  // for a reallocate, the one resized
   struct sequence_struct *next;  // next pointer
 } SEQLIST;
 
@@ -25,10 +27,15 @@ SEQLIST *seq_add_front(int size, unsigned char *ref_block, SEQLIST *next);
 // add to tail ... allocate and free version
 SEQLIST *seq_set_next_allocate(int size, unsigned char *ref_block, SEQLIST *prev);
 SEQLIST *seq_set_next_free(SEQLIST *tofree, SEQLIST *prev);
+// a reallocate is an allocate that takes over the block of "toresize"
+SEQLIST *seq_set_next_realloc(SEQLIST *toresize, int size,
+                              unsigned char *ref_block, SEQLIST *prev);
 // accessors
 int seq_alloc(SEQLIST *seq);
+int seq_realloc(SEQLIST *seq);
 int seq_freed(SEQLIST *seq);
 int seq_size(SEQLIST *seq);
+int seq_index(SEQLIST *seq);
 unsigned char *seq_ref_block(SEQLIST *seq);
 unsigned char *seq_myalloc_block(SEQLIST *seq);
 SEQLIST  *seq_next(SEQLIST *seq);
@@ -40,6 +47,7 @@ void seq_set_myalloc_block(SEQLIST *seq,unsigned char *myalloc_block);
 void seq_free(SEQLIST *seq);
 // utilities
 SEQLIST *find_nth_allocated_block(SEQLIST *seq,int n);
+int seq_length(SEQLIST *seq);
 void seq_print(SEQLIST *seq);
 void seq_cleanup(SEQLIST *seq);
 
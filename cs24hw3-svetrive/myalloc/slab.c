@@ -0,0 +1,301 @@
+/*! \file
+ * Implementation of a slab allocator of fixed-size objects, layered on the
+ * myalloc pool.
+ *
+ * Each slab is one myalloc() block:  a slab header followed by SLAB_OBJECTS
+ * objects.  The free objects of a slab are linked through their first word,
+ * so allocating is a pop off the list and freeing is a push.  Alongside the
+ * list, a 64-bit occupancy map has one bit per object.  It tells us in one
+ * comparison whether a slab is full or empty, and it catches double frees.
+ *
+ * Slabs with at least one free object sit on the cache's partial list, and
+ * every allocation comes from the slab at its head.  Full slabs are on no
+ * list at all.  When a slab's last object is freed, the slab goes back to
+ * the pool, except that one empty slab is kept in reserve so that a single
+ * object being allocated and freed over and over doesn't hit the pool every
+ * time.
+ *
+ * A freed object's slab is found by binary search in an array of every
+ * slab, sorted by address, so objects don't need a header of their own.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "myalloc.h"
+#include "slab.h"
+
+
+/*! Objects and slab headers are aligned to this many bytes. */
+#define SLAB_ALIGN 8
+
+
+/*! The header at the start of every slab. */
+typedef struct slab {
+    struct slab *prev;          /*!< Neighbours on the partial list. */
+    struct slab *next;
+    unsigned char *block;       /*!< What myalloc() returned for this slab. */
+    unsigned char *objects;     /*!< The first object. */
+    unsigned char *free_list;   /*!< Free objects, linked through word 0. */
+    uint64_t used;              /*!< Bit i is set while object i is live. */
+} slab;
+
+
+struct slab_cache {
+    int obj_size;
+
+    /*! Slabs with free objects; allocation takes from the head. */
+    slab *partial;
+
+    /*! One empty slab kept back from the pool, or NULL. */
+    slab *spare;
+
+    /*! Every slab this cache owns, including the spare, sorted by address. */
+    slab **slabs;
+    int num_slabs;
+    int max_slabs;
+};
+
+
+/*! A slab with every object allocated. */
+#define SLAB_FULL (~(uint64_t) 0)
+
+
+static unsigned char ** next_link(unsigned char *obj) {
+    return (unsigned char **) obj;
+}
+
+
+static uintptr_t align_up(uintptr_t n) {
+    return (n + SLAB_ALIGN - 1) & ~(uintptr_t) (SLAB_ALIGN - 1);
+}
+
+
+/* Partial-list helpers. */
+
+static void partial_push(slab_cache *cache, slab *s) {
+    s->prev = NULL;
+    s->next = cache->partial;
+    if (cache->partial != NULL)
+        cache->partial->prev = s;
+    cache->partial = s;
+}
+
+static void partial_remove(slab_cache *cache, slab *s) {
+    if (s->prev != NULL)
+        s->prev->next = s->next;
+    else
+        cache->partial = s->next;
+    if (s->next != NULL)
+        s->next->prev = s->prev;
+}
+
+
+/* Sorted slab array helpers. */
+
+/*!
+ * Returns the index of the last slab that starts at or below "addr", or -1
+ * if "addr" is below every slab.
+ */
+static int find_slab(slab_cache *cache, unsigned char *addr) {
+    int low = 0, high = cache->num_slabs - 1, mid;
+
+    while (low <= high) {
+        mid = low + (high - low) / 2;
+        if ((unsigned char *) cache->slabs[mid] <= addr)
+            low = mid + 1;
+        else
+            high = mid - 1;
+    }
+    return high;
+}
+
+static void index_insert(slab_cache *cache, slab *s) {
+    int i;
+
+    if (cache->num_slabs == cache->max_slabs) {
+        cache->max_slabs = (cache->max_slabs == 0) ? 16 : 2 * cache->max_slabs;
+        cache->slabs = (slab **) realloc(cache->slabs,
+                                         cache->max_slabs * sizeof(slab *));
+        if (cache->slabs == NULL) {
+            fprintf(stderr, "slab_alloc: could not grow the slab index\n");
+            abort();
+        }
+    }
+
+    i = find_slab(cache, (unsigned char *) s) + 1;
+    memmove(&cache->slabs[i + 1], &cache->slabs[i],
+            (cache->num_slabs - i) * sizeof(slab *));
+    cache->slabs[i] = s;
+    cache->num_slabs++;
+}
+
+static void index_remove(slab_cache *cache, slab *s) {
+    int i = find_slab(cache, (unsigned char *) s);
+
+    memmove(&cache->slabs[i], &cache->slabs[i + 1],
+            (cache->num_slabs - i - 1) * sizeof(slab *));
+    cache->num_slabs--;
+}
+
+
+/*!
+ * Gets a new slab from the pool and threads all of its objects onto its free
+ * list, lowest address first.  Returns NULL if the pool is full.
+ */
+static slab * slab_grow(slab_cache *cache) {
+    unsigned char *block, *obj;
+    slab *s;
+    int i;
+
+    // room for the header and objects, plus slack to align them
+    block = myalloc(sizeof(slab) + SLAB_OBJECTS * cache->obj_size +
+                    2 * SLAB_ALIGN);
+    if (block == NULL)
+        return NULL;
+
+    s = (slab *) align_up((uintptr_t) block);
+    s->block = block;
+    s->objects = (unsigned char *) align_up((uintptr_t) (s + 1));
+    s->used = 0;
+
+    s->free_list = NULL;
+    for (i = SLAB_OBJECTS - 1; i >= 0; i--) {
+        obj = s->objects + i * cache->obj_size;
+        *next_link(obj) = s->free_list;
+        s->free_list = obj;
+    }
+
+    index_insert(cache, s);
+    return s;
+}
+
+
+/*! Gives a slab, whose objects must all be free, back to the pool. */
+static void slab_release(slab_cache *cache, slab *s) {
+    index_remove(cache, s);
+    myfree(s->block);
+}
+
+
+/*!
+ * Creates an empty cache.  No memory is taken from the pool until the first
+ * allocation.  Objects are rounded up to a multiple of SLAB_ALIGN bytes, so
+ * every object can hold the free-list link and stays aligned.
+ */
+slab_cache * slab_create(int obj_size) {
+    slab_cache *cache = (slab_cache *) malloc(sizeof(slab_cache));
+
+    if (cache == NULL) {
+        fprintf(stderr, "slab_create: could not allocate the cache\n");
+        abort();
+    }
+
+    if (obj_size < (int) sizeof(unsigned char *))
+        obj_size = sizeof(unsigned char *);
+    cache->obj_size = (int) align_up(obj_size);
+    cache->partial = NULL;
+    cache->spare = NULL;
+    cache->slabs = NULL;
+    cache->num_slabs = 0;
+    cache->max_slabs = 0;
+
+    return cache;
+}
+
+
+/*!
+ * Allocates one object.  The slab at the head of the partial list always has
+ * a free object; when there is none, the spare slab is used, and only after
+ * that do we take a new slab from the pool.
+ */
+unsigned char * slab_alloc(slab_cache *cache) {
+    slab *s = cache->partial;
+    unsigned char *obj;
+
+    if (s == NULL) {
+        if (cache->spare != NULL) {
+            s = cache->spare;
+            cache->spare = NULL;
+        }
+        else {
+            s = slab_grow(cache);
+            if (s == NULL)
+                return NULL;
+        }
+        partial_push(cache, s);
+    }
+
+    obj = s->free_list;
+    s->free_list = *next_link(obj);
+    s->used |= (uint64_t) 1 << ((obj - s->objects) / cache->obj_size);
+
+    if (s->used == SLAB_FULL)
+        partial_remove(cache, s);
+
+    return obj;
+}
+
+
+/*!
+ * Frees one object.  A slab that was full goes back on the partial list, and
+ * a slab that is now empty goes back to the pool, or becomes the spare if
+ * there isn't one already.  Freeing an object that isn't live in this cache
+ * is reported and ignored.
+ */
+void slab_free(slab_cache *cache, unsigned char *obj) {
+    slab *s;
+    uint64_t bit;
+    long offset;
+    int i;
+
+    i = find_slab(cache, obj);
+    if (i < 0) {
+        fprintf(stderr, "slab_free: %p is not in this cache\n", obj);
+        return;
+    }
+    s = cache->slabs[i];
+
+    offset = obj - s->objects;
+    if (offset < 0 || offset >= (long) SLAB_OBJECTS * cache->obj_size ||
+        offset % cache->obj_size != 0) {
+        fprintf(stderr, "slab_free: %p is not in this cache\n", obj);
+        return;
+    }
+
+    bit = (uint64_t) 1 << (offset / cache->obj_size);
+    if ((s->used & bit) == 0) {
+        fprintf(stderr, "slab_free: %p is already free\n", obj);
+        return;
+    }
+
+    if (s->used == SLAB_FULL)
+        partial_push(cache, s);
+
+    s->used &= ~bit;
+    *next_link(obj) = s->free_list;
+    s->free_list = obj;
+
+    if (s->used == 0) {
+        partial_remove(cache, s);
+        if (cache->spare == NULL)
+            cache->spare = s;
+        else
+            slab_release(cache, s);
+    }
+}
+
+
+/*!
+ * Releases the cache.  Every slab goes back to the pool, whether or not its
+ * objects were freed, so any objects still held become invalid.
+ */
+void slab_destroy(slab_cache *cache) {
+    while (cache->num_slabs > 0)
+        slab_release(cache, cache->slabs[cache->num_slabs - 1]);
+
+    free(cache->slabs);
+    free(cache);
+}
@@ -0,0 +1,36 @@
+/*! \file
+ * Declarations for a slab allocator of fixed-size objects, layered on the
+ * myalloc pool.
+ *
+ * A slab cache hands out objects of one size.  It takes slabs, each big
+ * enough for SLAB_OBJECTS objects, from the default pool with myalloc(), and
+ * carves them up itself, so a run of same-sized requests costs one pool
+ * allocation per slab instead of one best-fit search and split per object.
+ * Slabs whose objects have all been freed go back to the pool.
+ *
+ * init_myalloc() must have been called before the first slab_create().
+ */
+
+
+/*! How many objects each slab holds; one bit each in the occupancy map. */
+#define SLAB_OBJECTS 64
+
+
+/*! A cache of objects of a single size.  The contents are private. */
+typedef struct slab_cache slab_cache;
+
+
+/* Create a cache that hands out objects of "obj_size" bytes. */
+slab_cache * slab_create(int obj_size);
+
+
+/* Allocate one object from "cache", or return NULL if the pool is full. */
+unsigned char * slab_alloc(slab_cache *cache);
+
+
+/* Free an object previously returned by slab_alloc() on the same cache. */
+void slab_free(slab_cache *cache, unsigned char *obj);
+
+
+/* Give every slab back to the pool and release the cache. */
+void slab_destroy(slab_cache *cache);
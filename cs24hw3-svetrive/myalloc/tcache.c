@@ -0,0 +1,312 @@
+/*! \file
+ * Implementation of a thread-safe front end to the myalloc pool allocators.
+ *
+ * Every block handed out carries a small hidden header recording the thread
+ * cache that owns it and its size class.  Small blocks are rounded up to a
+ * size class and, once freed, are kept on the owning thread's free list for
+ * that class instead of going back to the shared pool.  Large blocks, and
+ * every block when caching is off, come straight from the shared pool under
+ * its mutex.
+ *
+ * A thread that frees a block it doesn't own pushes it onto the owner's
+ * remote-free list with a compare-and-swap.  The owner takes the whole list
+ * with a single atomic exchange when one of its own free lists runs dry, so
+ * the list is never popped one element at a time and has no ABA problem.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "myalloc.h"
+#include "tcache.h"
+
+
+/*! Size classes are MIN_CLASS_SIZE, 2*MIN_CLASS_SIZE, ... */
+#define MIN_CLASS_SIZE 16
+#define NUM_CLASSES 7
+
+/*! Requests larger than this bypass the thread caches. */
+#define MAX_CACHED_SIZE (MIN_CLASS_SIZE << (NUM_CLASSES - 1))
+
+/*!
+ * When a thread has more than this many free blocks of one class, half of
+ * them go back to the shared pool in one batch.
+ */
+#define MAX_CACHED_BLOCKS 64
+
+
+struct tc_cache;
+
+/*!
+ * The header in front of every block.  It is 16 bytes so the caller's
+ * pointer keeps whatever alignment the backend gave the header.
+ */
+typedef struct tc_header {
+    struct tc_cache *owner;   /*!< The owning cache, or NULL if uncached. */
+    int size_class;           /*!< The block's size class, or -1. */
+    int pad;
+} tc_header;
+
+
+/*! One thread's cache of free small blocks. */
+typedef struct tc_cache {
+    /*! Free blocks of each class, linked through their first word. */
+    unsigned char *bins[NUM_CLASSES];
+    int counts[NUM_CLASSES];
+
+    /*! Blocks freed by other threads, waiting to be sorted into bins. */
+    _Atomic(unsigned char *) remote_free;
+
+    /*! Cleared by tc_thread_exit(); frees to a dead cache go to the pool. */
+    atomic_int alive;
+
+    /*! All caches ever created, so tc_close() can clean them up. */
+    struct tc_cache *next_cache;
+} tc_cache;
+
+
+/*! The shared pool, and the lock that protects it and the cache list. */
+static myalloc_pool_t *central;
+static pthread_mutex_t central_lock = PTHREAD_MUTEX_INITIALIZER;
+static tc_cache *all_caches;
+static int caching;
+
+/*! The calling thread's cache, created on its first small allocation. */
+static __thread tc_cache *my_cache;
+
+
+static tc_header * header_of(unsigned char *ptr) {
+    return (tc_header *) (ptr - sizeof(tc_header));
+}
+
+static unsigned char ** next_link(unsigned char *ptr) {
+    return (unsigned char **) ptr;
+}
+
+
+/*! Returns the smallest size class that holds "size" bytes. */
+static int size_class(int size) {
+    int k = 0;
+    while ((MIN_CLASS_SIZE << k) < size)
+        k++;
+    return k;
+}
+
+
+/*!
+ * Allocates a block with room for the header from the shared pool, and
+ * fills in the header.  Returns the caller's pointer, or NULL.
+ */
+static unsigned char * central_alloc(int size, tc_cache *owner, int k) {
+    unsigned char *block;
+    tc_header *h;
+
+    pthread_mutex_lock(&central_lock);
+    block = myalloc_pool_alloc(central, size + sizeof(tc_header));
+    pthread_mutex_unlock(&central_lock);
+
+    if (block == NULL)
+        return NULL;
+
+    h = (tc_header *) block;
+    h->owner = owner;
+    h->size_class = k;
+    return block + sizeof(tc_header);
+}
+
+
+/*! Gives "count" blocks from the front of a list back to the shared pool. */
+static unsigned char * central_free_list(unsigned char *list, int count) {
+    unsigned char *next;
+
+    pthread_mutex_lock(&central_lock);
+    while (list != NULL && count-- > 0) {
+        next = *next_link(list);
+        myalloc_pool_free(central, (unsigned char *) header_of(list));
+        list = next;
+    }
+    pthread_mutex_unlock(&central_lock);
+
+    return list;
+}
+
+
+/*! Returns the calling thread's cache, creating it if necessary. */
+static tc_cache * get_cache() {
+    tc_cache *c = my_cache;
+    int k;
+
+    if (c != NULL)
+        return c;
+
+    c = (tc_cache *) malloc(sizeof(tc_cache));
+    if (c == NULL) {
+        fprintf(stderr, "tc_alloc: could not allocate a thread cache\n");
+        abort();
+    }
+    for (k = 0; k < NUM_CLASSES; k++) {
+        c->bins[k] = NULL;
+        c->counts[k] = 0;
+    }
+    atomic_init(&c->remote_free, NULL);
+    atomic_init(&c->alive, 1);
+
+    pthread_mutex_lock(&central_lock);
+    c->next_cache = all_caches;
+    all_caches = c;
+    pthread_mutex_unlock(&central_lock);
+
+    my_cache = c;
+    return c;
+}
+
+
+/*! Moves every block other threads have freed to us into our bins. */
+static void drain_remote(tc_cache *c) {
+    unsigned char *list = atomic_exchange(&c->remote_free, NULL);
+    unsigned char *next;
+    int k;
+
+    while (list != NULL) {
+        next = *next_link(list);
+        k = header_of(list)->size_class;
+        *next_link(list) = c->bins[k];
+        c->bins[k] = list;
+        c->counts[k]++;
+        list = next;
+    }
+}
+
+
+/*! Gives all of a cache's free blocks back to the shared pool. */
+static void flush_cache(tc_cache *c) {
+    int k;
+
+    drain_remote(c);
+    for (k = 0; k < NUM_CLASSES; k++) {
+        central_free_list(c->bins[k], c->counts[k]);
+        c->bins[k] = NULL;
+        c->counts[k] = 0;
+    }
+}
+
+
+/*!
+ * Sets up the shared pool.  With use_caches zero, every call goes straight
+ * to the locked pool, which is useful as a baseline.
+ */
+void tc_init(int pool_size, int use_caches) {
+    central = myalloc_pool_create(pool_size);
+    all_caches = NULL;
+    caching = use_caches;
+    my_cache = NULL;
+}
+
+
+/*!
+ * Allocates "size" bytes.  Small requests are served from the calling
+ * thread's bin for their class when it has anything, after first collecting
+ * blocks that other threads have returned to it.
+ */
+unsigned char * tc_alloc(int size) {
+    tc_cache *c;
+    unsigned char *block;
+    int k;
+
+    if (!caching || size > MAX_CACHED_SIZE)
+        return central_alloc(size, NULL, -1);
+
+    k = size_class(size);
+    c = get_cache();
+
+    if (c->bins[k] == NULL)
+        drain_remote(c);
+
+    block = c->bins[k];
+    if (block != NULL) {
+        c->bins[k] = *next_link(block);
+        c->counts[k]--;
+        return block;
+    }
+
+    return central_alloc(MIN_CLASS_SIZE << k, c, k);
+}
+
+
+/*!
+ * Frees a block from any thread.  Our own small blocks go onto our bins,
+ * other threads' go back to their owner, and everything else (including
+ * blocks whose owner has exited) goes back to the shared pool.
+ */
+void tc_free(unsigned char *ptr) {
+    tc_header *h = header_of(ptr);
+    tc_cache *owner = h->owner;
+    unsigned char *head;
+    int k = h->size_class;
+
+    if (owner == NULL || !atomic_load(&owner->alive)) {
+        pthread_mutex_lock(&central_lock);
+        myalloc_pool_free(central, (unsigned char *) h);
+        pthread_mutex_unlock(&central_lock);
+        return;
+    }
+
+    if (owner == my_cache) {
+        *next_link(ptr) = owner->bins[k];
+        owner->bins[k] = ptr;
+        owner->counts[k]++;
+
+        if (owner->counts[k] > MAX_CACHED_BLOCKS) {
+            owner->bins[k] = central_free_list(owner->bins[k],
+                                               MAX_CACHED_BLOCKS / 2);
+            owner->counts[k] -= MAX_CACHED_BLOCKS / 2;
+        }
+        return;
+    }
+
+    // hand the block back to the thread that owns it
+    head = atomic_load(&owner->remote_free);
+    do {
+        *next_link(ptr) = head;
+    } while (!atomic_compare_exchange_weak(&owner->remote_free, &head, ptr));
+}
+
+
+/*!
+ * Returns the calling thread's cached blocks to the shared pool.  Threads
+ * should call this before they exit.  Blocks the thread still holds stay
+ * valid, and are freed straight to the pool from then on.
+ */
+void tc_thread_exit() {
+    tc_cache *c = my_cache;
+
+    if (c == NULL)
+        return;
+
+    atomic_store(&c->alive, 0);
+    flush_cache(c);
+    my_cache = NULL;
+}
+
+
+/*!
+ * Tears down every cache and the shared pool.  This must only be called once
+ * no other thread is using the allocator.  Blocks freed to a cache after its
+ * thread exited are collected here.
+ */
+void tc_close() {
+    tc_cache *c, *next;
+
+    for (c = all_caches; c != NULL; c = next) {
+        next = c->next_cache;
+        flush_cache(c);
+        free(c);
+    }
+    all_caches = NULL;
+    my_cache = NULL;
+
+    myalloc_pool_destroy(central);
+    central = NULL;
+}
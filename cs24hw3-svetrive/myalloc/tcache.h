@@ -0,0 +1,32 @@
+/*! \file
+ * Declarations for a thread-safe front end to the myalloc pool allocators.
+ *
+ * A single myalloc pool sits underneath, protected by a mutex.  When caching
+ * is turned on, each thread also keeps its own free lists of recently freed
+ * small blocks, so most small allocations and frees never touch the lock.  A
+ * block freed by a thread other than the one that allocated it is handed back
+ * to its owner through a lock-free list, and the owner picks it up on its
+ * next allocation.
+ *
+ * The front end works with any of the myalloc.h backends.
+ */
+
+
+/* Set up the shared pool of "pool_size" bytes, with or without thread caches. */
+void tc_init(int pool_size, int use_caches);
+
+
+/* Allocate "size" bytes.  Safe to call from any thread. */
+unsigned char * tc_alloc(int size);
+
+
+/* Free a block returned by tc_alloc(), from any thread. */
+void tc_free(unsigned char *ptr);
+
+
+/* Return the calling thread's cached blocks to the shared pool. */
+void tc_thread_exit();
+
+
+/* Tear down the caches and the shared pool. */
+void tc_close();
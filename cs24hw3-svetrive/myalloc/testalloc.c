@@ -10,16 +10,28 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <getopt.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <time.h>
 
 #include "errno.h"
 #include "myalloc.h"
 #include "sequence.h"
+#include "trace.h"
 
 #define VERBOSE 0
 
 #define DEFAULT_MAX_ALLOCATION 16000
 #define DEFAULT_RANDOM_SEED 1
+#define DEFAULT_REALLOC_PERCENT 10
+
+// number of reallocations in the last try_sequence() that lost data
+int realloc_mismatches = 0;
+
+// set in benchmark mode, where nothing but the report may go to stdout
+int report_only = 0;
 
 // some random numbers...
 
@@ -67,17 +79,46 @@ void fill_data(unsigned char *p1, unsigned char *p2, int len) {
 }
 
 
+int same_data(unsigned char *p1, unsigned char *p2, int len);
+
+// the number of bytes a reallocate must carry over from the block it resizes
+int realloc_kept_size(SEQLIST *seq) {
+  int old_size = seq_size(seq_tofree(seq));
+  return (old_size < seq_size(seq)) ? old_size : seq_size(seq);
+}
+
+
 // try applying sequence
 int try_sequence(SEQLIST *test_sequence, int mem_size) {
   SEQLIST *sptr;
   unsigned char *mblock;
+  int kept;
 
   // reset the memory allocator being tested
   MEMORY_SIZE = mem_size;
   init_myalloc();
+  realloc_mismatches = 0;
 
   for (sptr = test_sequence; !seq_null(sptr); sptr = seq_next(sptr)) {
-    if (seq_alloc(sptr)) {     // allocate a block
+    if (seq_realloc(sptr)) {     // resize a block
+      mblock = myrealloc(seq_myalloc_block(seq_tofree(sptr)), seq_size(sptr));
+      if (mblock == 0) {
+        return 0; // failed -- return indication
+      }
+      seq_set_myalloc_block(sptr, mblock);
+
+      // the old contents must have come along, wherever the block is now
+      kept = realloc_kept_size(sptr);
+      if (!same_data(seq_ref_block(seq_tofree(sptr)), mblock, kept)) {
+        if (VERBOSE)
+          printf("realloc of %p to %d lost data\n",
+                 seq_myalloc_block(seq_tofree(sptr)), seq_size(sptr));
+        realloc_mismatches++;
+      }
+      fill_data(seq_ref_block(sptr) + kept, mblock + kept,
+                seq_size(sptr) - kept);
+    }
+    else if (seq_alloc(sptr)) {     // allocate a block
       mblock = myalloc(seq_size(sptr));
       if (mblock == 0) {
         return 0; // failed -- return indication
@@ -129,6 +170,269 @@ int binary_search_required_memory(SEQLIST *test_sequence, int low, int high) {
 }
 
 
+// try applying sequence to a private allocator instance.
+//  Unlike try_sequence(), this doesn't record anything in the SEQLIST:
+//  the addresses handed out go into blocks[], indexed by seq_index(),
+//  so several trials can replay the same sequence at once.
+int try_sequence_pool(SEQLIST *test_sequence, int mem_size,
+                      unsigned char **blocks) {
+  SEQLIST *sptr;
+  unsigned char *mblock;
+  myalloc_pool_t *pool;
+  int result = 1;
+  int kept;
+
+  pool = myalloc_pool_create(mem_size);
+
+  for (sptr = test_sequence; !seq_null(sptr); sptr = seq_next(sptr)) {
+    if (seq_realloc(sptr)) {     // resize a block
+      mblock = myalloc_pool_realloc(pool, blocks[seq_index(seq_tofree(sptr))],
+                                    seq_size(sptr));
+      if (mblock == 0) {
+        result = 0; // failed
+        break;
+      }
+      blocks[seq_index(sptr)] = mblock;
+      kept = realloc_kept_size(sptr);
+      fill_data(seq_ref_block(sptr) + kept, mblock + kept,
+                seq_size(sptr) - kept);
+    }
+    else if (seq_alloc(sptr)) {     // allocate a block
+      mblock = myalloc_pool_alloc(pool, seq_size(sptr));
+      if (mblock == 0) {
+        result = 0; // failed
+        break;
+      }
+      blocks[seq_index(sptr)] = mblock;
+      fill_data(seq_ref_block(sptr), mblock, seq_size(sptr));
+    }
+    else {    // dealloc
+      myalloc_pool_free(pool, blocks[seq_index(seq_tofree(sptr))]);
+    }
+  }
+
+  myalloc_pool_destroy(pool);
+  return result;
+}
+
+
+// time one replay of the sequence against a fresh pool of mem_size bytes,
+//  without touching the blocks' contents, so only the allocator is measured.
+//  Returns the elapsed time in seconds, or a negative value if it ran out
+//  of memory.
+double time_sequence(SEQLIST *test_sequence, int mem_size) {
+  SEQLIST *sptr;
+  unsigned char **blocks;
+  unsigned char *mblock;
+  myalloc_pool_t *pool;
+  struct timespec start, end;
+  double elapsed;
+
+  blocks = malloc(sizeof(unsigned char *) * seq_length(test_sequence));
+  if (blocks == NULL) {
+    fprintf(stderr, "real memory exhausted.\n");
+    abort();
+  }
+  pool = myalloc_pool_create(mem_size);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (sptr = test_sequence; !seq_null(sptr); sptr = seq_next(sptr)) {
+    if (!seq_alloc(sptr)) {
+      myalloc_pool_free(pool, blocks[seq_index(seq_tofree(sptr))]);
+      continue;
+    }
+
+    if (seq_realloc(sptr))
+      mblock = myalloc_pool_realloc(pool, blocks[seq_index(seq_tofree(sptr))],
+                                    seq_size(sptr));
+    else
+      mblock = myalloc_pool_alloc(pool, seq_size(sptr));
+    if (mblock == NULL)
+      break;
+    blocks[seq_index(sptr)] = mblock;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  if (!seq_null(sptr))
+    elapsed = -1.0;
+
+  myalloc_pool_destroy(pool);
+  free(blocks);
+  return elapsed;
+}
+
+
+// A fixed set of worker threads that run try_sequence_pool() on a batch of
+//  candidate memory sizes.  The workers are started once and reused for
+//  every round of the search.
+typedef struct search_pool {
+  SEQLIST *test_sequence;
+  int nthreads;
+  pthread_t *threads;
+
+  pthread_mutex_t lock;
+  pthread_cond_t work_ready;   // signalled when a new batch is posted
+  pthread_cond_t work_done;    // signalled when the last job of a batch ends
+
+  int *mem_sizes;              // the current batch of candidate sizes
+  int *results;                // try_sequence_pool() result for each one
+  int njobs;
+  int next_job;
+  int jobs_done;
+  int shutdown;
+} search_pool;
+
+
+void *search_worker(void *arg) {
+  search_pool *sp = (search_pool *) arg;
+  unsigned char **blocks =
+    malloc(sizeof(unsigned char *) * seq_length(sp->test_sequence));
+  int job;
+
+  if (blocks == NULL) {
+    fprintf(stderr, "real memory exhausted.\n");
+    abort();
+  }
+
+  pthread_mutex_lock(&sp->lock);
+  while (1) {
+    while (!sp->shutdown && sp->next_job >= sp->njobs)
+      pthread_cond_wait(&sp->work_ready, &sp->lock);
+    if (sp->shutdown)
+      break;
+
+    job = sp->next_job++;
+    pthread_mutex_unlock(&sp->lock);
+
+    sp->results[job] =
+      try_sequence_pool(sp->test_sequence, sp->mem_sizes[job], blocks);
+
+    pthread_mutex_lock(&sp->lock);
+    sp->jobs_done++;
+    if (sp->jobs_done == sp->njobs)
+      pthread_cond_signal(&sp->work_done);
+  }
+  pthread_mutex_unlock(&sp->lock);
+
+  free(blocks);
+  return NULL;
+}
+
+
+// search over memory sizes between low and high using nthreads workers.
+//  Whether a size works isn't monotonic in the size, so different probes
+//  can find different boundaries.  To give the same answer as
+//  binary_search_required_memory() whatever nthreads is, each round tries
+//  every size the serial search could probe in its next few steps (the top
+//  levels of its decision tree, as many as nthreads can cover) at once, and
+//  then follows the path the serial search would take through them.
+//  Reports the smallest size that can accommodate the sequence.
+int parallel_search_required_memory(SEQLIST *test_sequence, int low, int high,
+                                    int nthreads) {
+  // invariant: low not achievable, high is achievable
+  search_pool sp;
+  int *node_low, *node_high, *node_job;
+  int depth, nodes, i, n, node, parent, mid;
+
+  sp.test_sequence = test_sequence;
+  sp.nthreads = nthreads;
+  sp.threads = malloc(sizeof(pthread_t) * nthreads);
+  sp.mem_sizes = malloc(sizeof(int) * nthreads);
+  sp.results = malloc(sizeof(int) * nthreads);
+
+  // the decision tree is kept as a heap:  node i's children are 2i + 1, where
+  //  its size worked, and 2i + 2, where it didn't
+  for (depth = 1; (2 << depth) - 1 <= nthreads; depth++)
+    ;
+  nodes = (1 << depth) - 1;
+  node_low = malloc(sizeof(int) * nodes);
+  node_high = malloc(sizeof(int) * nodes);
+  node_job = malloc(sizeof(int) * nodes);
+  if (sp.threads == NULL || sp.mem_sizes == NULL || sp.results == NULL ||
+      node_low == NULL || node_high == NULL || node_job == NULL) {
+    fprintf(stderr, "real memory exhausted.\n");
+    abort();
+  }
+  pthread_mutex_init(&sp.lock, NULL);
+  pthread_cond_init(&sp.work_ready, NULL);
+  pthread_cond_init(&sp.work_done, NULL);
+  sp.njobs = sp.next_job = sp.jobs_done = 0;
+  sp.shutdown = 0;
+
+  for (i = 0; i < nthreads; i++)
+    pthread_create(&sp.threads[i], NULL, search_worker, &sp);
+
+  while (low + 1 < high) {
+    // lay out the next "depth" levels of the serial search, with the same
+    //  midpoints it would pick, and queue a job for every node with a gap
+    node_low[0] = low;
+    node_high[0] = high;
+    n = 0;
+    for (i = 0; i < nodes; i++) {
+      node_job[i] = -1;
+      if (i > 0) {
+        parent = (i - 1) / 2;
+        if (node_job[parent] == -1)
+          continue;       // the search has already ended above this node
+        mid = sp.mem_sizes[node_job[parent]];
+        node_low[i] = (i % 2) ? node_low[parent] : mid;
+        node_high[i] = (i % 2) ? mid : node_high[parent];
+      }
+      if (node_low[i] + 1 < node_high[i]) {
+        node_job[i] = n;
+        sp.mem_sizes[n++] = (node_low[i] + node_high[i] + 1) / 2;
+      }
+    }
+
+    pthread_mutex_lock(&sp.lock);
+    sp.njobs = n;
+    sp.next_job = 0;
+    sp.jobs_done = 0;
+    pthread_cond_broadcast(&sp.work_ready);
+    while (sp.jobs_done < sp.njobs)
+      pthread_cond_wait(&sp.work_done, &sp.lock);
+    pthread_mutex_unlock(&sp.lock);
+
+    // take the serial search's path down the tree
+    for (node = 0; node < nodes && node_job[node] != -1; ) {
+      i = node_job[node];
+      if (sp.results[i]) {
+        if (VERBOSE)
+          printf("\tSucceeded for %d\n", sp.mem_sizes[i]);
+        high = sp.mem_sizes[i];
+        node = 2 * node + 1;
+      }
+      else {
+        if (VERBOSE)
+          printf("\tFailed for %d\n", sp.mem_sizes[i]);
+        low = sp.mem_sizes[i];
+        node = 2 * node + 2;
+      }
+    }
+  }
+
+  pthread_mutex_lock(&sp.lock);
+  sp.shutdown = 1;
+  pthread_cond_broadcast(&sp.work_ready);
+  pthread_mutex_unlock(&sp.lock);
+  for (i = 0; i < nthreads; i++)
+    pthread_join(sp.threads[i], NULL);
+
+  pthread_mutex_destroy(&sp.lock);
+  pthread_cond_destroy(&sp.work_ready);
+  pthread_cond_destroy(&sp.work_done);
+  free(sp.threads);
+  free(sp.mem_sizes);
+  free(sp.results);
+  free(node_low);
+  free(node_high);
+  free(node_job);
+
+  return high;
+}
+
+
 // allocate (from normal malloc) a block of size blocks
 //  and put data into it
 // This supports data integrity tests.
@@ -219,8 +523,10 @@ int check_data(SEQLIST *test_sequence) {
 
 
 // create a test sequence which never uses more than max_used_memory
-//   and allocates a total of max_used_memory*allocation_factor
-SEQLIST *generate_sequence(int max_used_memory, int allocation_factor) {
+//   and allocates a total of max_used_memory*allocation_factor.
+//   About realloc_percent of the allocations resize a live block instead.
+SEQLIST *generate_sequence(int max_used_memory, int allocation_factor,
+                           int realloc_percent) {
   int used_memory = 0;
   int total_allocated = 0;
   int next_block_size = 0;
@@ -231,6 +537,7 @@ SEQLIST *generate_sequence(int max_used_memory, int allocation_factor) {
   SEQLIST *tail_sequence = NULL;
 
   unsigned char *new_block_ref;
+  SEQLIST *toresize;
 
   while (total_allocated < allocation_factor * max_used_memory) {
     next_block_size = random_block_size(max_used_memory);
@@ -256,8 +563,27 @@ SEQLIST *generate_sequence(int max_used_memory, int allocation_factor) {
     // allocate a reference buffer for the new block
     new_block_ref = allocate_and_fill(next_block_size);
 
+    // sometimes resize a live block instead of allocating a new one
+    if (realloc_percent > 0 && allocated_blocks > 0 &&
+        random_int(100) <= realloc_percent) {
+      toresize =
+        find_nth_allocated_block(test_sequence, random_int(allocated_blocks));
+
+      // the resized block starts out with the contents of the old one
+      fill_data(seq_ref_block(toresize), new_block_ref,
+                (seq_size(toresize) < next_block_size) ?
+                seq_size(toresize) : next_block_size);
+
+      tail_sequence = seq_set_next_realloc(toresize, next_block_size,
+                                           new_block_ref, tail_sequence);
+
+      // the new size replaces the old block, which no longer counts as live
+      used_memory -= seq_size(toresize);
+      allocated_blocks--;
+      seq_free(toresize);
+    }
     // now allocate that block
-    if (seq_null(test_sequence)) {
+    else if (seq_null(test_sequence)) {
       // special case for first allocation
       test_sequence = seq_add_front(next_block_size, new_block_ref, (SEQLIST *) 0);
       tail_sequence = test_sequence;
@@ -281,8 +607,9 @@ SEQLIST *generate_sequence(int max_used_memory, int allocation_factor) {
   }
 
   // just so can manually see this is doing something sensible
-  printf("Actual maximum memory usage %d (%f)\n", actual_max_used_memory,
-         ((double) actual_max_used_memory / (double) max_used_memory));
+  if (!report_only)
+    printf("Actual maximum memory usage %d (%f)\n", actual_max_used_memory,
+           ((double) actual_max_used_memory / (double) max_used_memory));
 
   return test_sequence;
 }
@@ -354,6 +681,165 @@ done:
 
 }
 
+// A basic test that myrealloc() keeps a block's contents as it shrinks,
+// grows into a free right neighbour, and slides into a free left neighbour.
+// Whether each step happens in place is reported but not required, since
+// not every allocator can do it.
+void realloc_test() {
+  unsigned char pattern[300];
+  unsigned char * a;
+  unsigned char * b;
+  unsigned char * c;
+  unsigned char * p;
+  int failure = 0;
+  int i;
+
+  printf("Performing a basic test of reallocation.\n");
+
+  for (i = 0; i < 300; i++)
+    pattern[i] = (unsigned char) (i * 37 + 11);
+
+  MEMORY_SIZE = 1024;
+  init_myalloc();
+
+  a = myalloc(200);
+  b = myalloc(200);
+  c = myalloc(200);
+  if (a == NULL || b == NULL || c == NULL) {
+    printf("Couldn't allocate three blocks of size 200 in a 1024 byte pool.\n");
+    failure = 1;
+    goto done;
+  }
+  fill_data(pattern, b, 200);
+
+  // grow to the right
+  myfree(c);
+  p = myrealloc(b, 300);
+  if (p == NULL || !same_data(pattern, p, 200)) {
+    printf("Failed to grow a block into its free right neighbour.\n");
+    failure = 1;
+    goto done;
+  }
+  if (p != b)
+    printf("Growing into the right neighbour moved the block.\n");
+  fill_data(pattern, p, 300);
+
+  // shrink in place
+  b = myrealloc(p, 100);
+  if (b == NULL || !same_data(pattern, b, 100)) {
+    printf("Failed to shrink a block.\n");
+    failure = 1;
+    goto done;
+  }
+  if (b != p)
+    printf("Shrinking moved the block.\n");
+
+  // fill the space to the right, so only the left neighbour can help
+  c = myalloc(500);
+  if (c == NULL) {
+    printf("Shrinking didn't give the tail back to the pool.\n");
+    failure = 1;
+    goto done;
+  }
+  myfree(a);
+  p = myrealloc(b, 300);
+  if (p == NULL || !same_data(pattern, p, 100)) {
+    printf("Failed to grow a block into its free left neighbour.\n");
+    failure = 1;
+    goto done;
+  }
+  if (p != a)
+    printf("Growing into the left neighbour didn't reuse its space.\n");
+
+done:
+  if (!failure) {
+    printf("Passed realloc test.\n");
+  }
+  close_myalloc();
+}
+
+// The reallocation test for the buddy allocator, whose blocks can't grow
+// into just any free neighbour.  It checks what buddy_myalloc.c promises:
+// shrinking splits the block in place and frees its upper half, a lower
+// buddy grows in place when its upper buddy is free, and an upper buddy
+// moves.  Contents must survive every step.
+void buddy_realloc_test() {
+  unsigned char pattern[300];
+  unsigned char * a;
+  unsigned char * b;
+  unsigned char * c;
+  unsigned char * p;
+  int failure = 0;
+  int i;
+
+  printf("Performing a basic test of buddy reallocation.\n");
+
+  for (i = 0; i < 300; i++)
+    pattern[i] = (unsigned char) (i * 37 + 11);
+
+  MEMORY_SIZE = 1024;
+  init_myalloc();
+
+  // a 256-byte block at the start of the pool
+  a = myalloc(200);
+  if (a == NULL) {
+    printf("Couldn't allocate a block of size 200 in a 1024 byte pool.\n");
+    failure = 1;
+    goto done;
+  }
+  fill_data(pattern, a, 200);
+
+  // shrink to 128 bytes, which frees the upper half for the next request
+  p = myrealloc(a, 100);
+  if (p != a || !same_data(pattern, p, 100)) {
+    printf("Failed to shrink a block in place.\n");
+    failure = 1;
+    goto done;
+  }
+  c = myalloc(100);
+  if (c != a + 128) {
+    printf("Shrinking didn't free the block's upper half.\n");
+    failure = 1;
+    goto done;
+  }
+
+  // grow back to 256 bytes, absorbing the now free upper buddy
+  myfree(c);
+  p = myrealloc(a, 200);
+  if (p != a || !same_data(pattern, p, 100)) {
+    printf("Failed to grow a lower buddy into its free upper buddy.\n");
+    failure = 1;
+    goto done;
+  }
+  fill_data(pattern, a, 200);
+
+  // the next 256-byte block is an upper buddy, so growing has to move it
+  b = myalloc(200);
+  if (b == NULL) {
+    printf("Couldn't allocate second block of size 200 in 1024 byte pool.\n");
+    failure = 1;
+    goto done;
+  }
+  fill_data(pattern, b, 200);
+  p = myrealloc(b, 300);
+  if (p == NULL || !same_data(pattern, p, 200)) {
+    printf("Failed to move an upper buddy to grow it.\n");
+    failure = 1;
+    goto done;
+  }
+  if (!same_data(pattern, a, 200)) {
+    printf("Growing a block changed its neighbour.\n");
+    failure = 1;
+  }
+
+done:
+  if (!failure) {
+    printf("Passed realloc test.\n");
+  }
+  close_myalloc();
+}
+
+
 // Allocates chunks of the given size until unable to anymore, then
 // deallocates all of them - returns the number of chunks allocated.
 int uniform_chunks(int chunk_size, int memory_size) {
@@ -419,16 +905,22 @@ int uniform_chunk_test() {
 }
 
 
+int write_trace(SEQLIST *test_sequence, char *path);
+
 /* This test runs a series of random allocations and deallocations,
  * to see how much overhead is required by the allocator in question
  * for a certain number of bytes to be allocated.  During the test,
  * the allocated regions are verified to not overlap with each other,
- * and so forth.
+ * and so forth.  Returns 1 if the sequence was to be recorded to
+ * "trace_out" but couldn't be, and 0 otherwise.
  */
-void utilization_test(int max_allocation) {
+int utilization_test(int max_allocation, int realloc_percent, int nthreads,
+                     char *trace_out) {
   int max_used_memory;
   int allocation_factor;
   int memory_required;
+  double replay_time;
+  int status = 0;
 
   SEQLIST *test_sequence;
 
@@ -438,10 +930,14 @@ void utilization_test(int max_allocation) {
   printf("running with MAX_USED_MEMORY=%d and ALLOCATION_FACTOR=%d\n",
     max_used_memory, allocation_factor);
 
-  test_sequence = generate_sequence(max_used_memory, allocation_factor);
+  test_sequence = generate_sequence(max_used_memory, allocation_factor,
+                                    realloc_percent);
   if (VERBOSE)
     seq_print(test_sequence);
 
+  if (trace_out != NULL && write_trace(test_sequence, trace_out) != 0)
+    status = 1;
+
   // check that allocation can actually do something.
   // This becomes upper bound on binary search.
   if (try_sequence(test_sequence, max_used_memory * allocation_factor * 2)) {
@@ -451,14 +947,21 @@ void utilization_test(int max_allocation) {
     close_myalloc();
 
     // binary search for smallest MEMORY_SIZE which can accommodate
-    memory_required = binary_search_required_memory(test_sequence,
-      max_used_memory - 1, max_used_memory * allocation_factor * 2);
+    if (nthreads > 1) {
+      memory_required = parallel_search_required_memory(test_sequence,
+        max_used_memory - 1, max_used_memory * allocation_factor * 2,
+        nthreads);
+    }
+    else {
+      memory_required = binary_search_required_memory(test_sequence,
+        max_used_memory - 1, max_used_memory * allocation_factor * 2);
+    }
 
     // run it one more time at the identified size.
     // this makes sure that the data is set from a successful run.
     if (try_sequence(test_sequence, memory_required)) {
-      // check if data contents are intact
-      if (check_data(test_sequence)) {
+      // check if data contents are intact, including across reallocations
+      if (check_data(test_sequence) || realloc_mismatches) {
         printf("Data integrity FAIL.\n");
       }
       else {
@@ -468,6 +971,13 @@ void utilization_test(int max_allocation) {
       // print statistics
       printf("Memory utilization: (%d/%d)=%f\n", max_used_memory, memory_required,
              ((double) max_used_memory / (double) memory_required));
+
+      replay_time = time_sequence(test_sequence, memory_required);
+      if (replay_time > 0.0) {
+        printf("Replay throughput: %d ops in %f sec (%.0f ops/sec)\n",
+               seq_length(test_sequence), replay_time,
+               seq_length(test_sequence) / replay_time);
+      }
     }
     else {
       printf("Consistency problem: binary_search_required_memory "
@@ -478,15 +988,657 @@ void utilization_test(int max_allocation) {
     printf("Requires more memory than the no-free case.\n");
   }
   seq_cleanup(test_sequence);
+  return status;
+}
+
+
+// convert a test sequence to a trace in memory.
+//  Handles are numbered in allocation order, and a reallocate keeps the
+//  handle of the block it resizes.
+trace *sequence_trace(SEQLIST *test_sequence) {
+  trace_record *records;
+  SEQLIST *sptr;
+  int *handles;
+  int next_handle = 0;
+  int n = 0;
+
+  records = calloc(seq_length(test_sequence), sizeof(trace_record));
+  handles = malloc(sizeof(int) * seq_length(test_sequence));
+  if (records == NULL || handles == NULL) {
+    fprintf(stderr, "real memory exhausted.\n");
+    abort();
+  }
+
+  for (sptr = test_sequence; !seq_null(sptr); sptr = seq_next(sptr), n++) {
+    if (seq_realloc(sptr)) {
+      handles[seq_index(sptr)] = handles[seq_index(seq_tofree(sptr))];
+      records[n].op = TRACE_REALLOC;
+      records[n].size = seq_size(sptr);
+    }
+    else if (seq_alloc(sptr)) {
+      handles[seq_index(sptr)] = next_handle++;
+      records[n].op = TRACE_ALLOC;
+      records[n].size = seq_size(sptr);
+    }
+    else {
+      handles[seq_index(sptr)] = handles[seq_index(seq_tofree(sptr))];
+      records[n].op = TRACE_FREE;
+    }
+    records[n].handle = handles[seq_index(sptr)];
+  }
+
+  free(handles);
+  return trace_from_records(records, n, next_handle);
+}
+
+
+// record a test sequence as a binary trace file.  Returns 0 on success, or
+//  1 if the file couldn't be created or written.
+int write_trace(SEQLIST *test_sequence, char *path) {
+  trace_writer *w;
+  trace *t;
+  const trace_record *r;
+
+  w = trace_open(path);
+  if (w == NULL)
+    return 1;
+
+  t = sequence_trace(test_sequence);
+  for (r = t->records; r < t->records + t->num_records; r++) {
+    if (r->op == TRACE_ALLOC)
+      trace_record_alloc(w, r->handle, r->size);
+    else if (r->op == TRACE_REALLOC)
+      trace_record_realloc(w, r->handle, r->size);
+    else
+      trace_record_free(w, r->handle);
+  }
+
+  trace_unmap(t);
+  if (trace_close(w) != 0) {
+    printf("ERROR:  Couldn't write trace file %s\n", path);
+    return 1;
+  }
+  printf("Wrote sequence to trace file %s\n", path);
+  return 0;
+}
+
+
+// the byte a trace replay stores at offset i of the block with this handle
+unsigned char trace_byte(uint32_t handle, int i) {
+  return (unsigned char) (handle * 131 + i);
+}
+
+void trace_fill(unsigned char *block, uint32_t handle, int from, int to) {
+  int i;
+  for (i = from; i < to; i++)
+    block[i] = trace_byte(handle, i);
+}
+
+int trace_intact(unsigned char *block, uint32_t handle, int len) {
+  int i;
+  for (i = 0; i < len; i++) {
+    if (block[i] != trace_byte(handle, i))
+      return 0;
+  }
+  return 1;
+}
+
+
+// replay a mapped trace against a fresh pool of mem_size bytes.
+//  blocks[] and sizes[] are indexed by handle, and must have room for
+//  t->num_handles entries.  With check set, every block is filled with a
+//  pattern derived from its handle, which is checked whenever the block is
+//  resized or freed.  Operations on handles that aren't live are skipped, so
+//  a trace that starts mid-run can still be replayed.
+//  Returns 1 on success, 0 if the pool ran out, and -1 if data was lost.
+int try_trace(trace *t, int mem_size, unsigned char **blocks, int *sizes,
+              int check) {
+  const trace_record *r, *end;
+  unsigned char *mblock;
+  myalloc_pool_t *pool;
+  int result = 1;
+  int kept;
+
+  memset(blocks, 0, sizeof(unsigned char *) * t->num_handles);
+  pool = myalloc_pool_create(mem_size);
+
+  end = t->records + t->num_records;
+  for (r = t->records; r < end; r++) {
+    switch (r->op) {
+      case TRACE_ALLOC:
+        mblock = myalloc_pool_alloc(pool, r->size);
+        if (mblock == NULL)
+          goto out_of_memory;
+        blocks[r->handle] = mblock;
+        sizes[r->handle] = r->size;
+        if (check)
+          trace_fill(mblock, r->handle, 0, r->size);
+        break;
+
+      case TRACE_REALLOC:
+        if (blocks[r->handle] == NULL)
+          break;
+        mblock = myalloc_pool_realloc(pool, blocks[r->handle], r->size);
+        if (mblock == NULL)
+          goto out_of_memory;
+        if (check) {
+          kept = (sizes[r->handle] < (int) r->size) ? sizes[r->handle] : r->size;
+          if (!trace_intact(mblock, r->handle, kept))
+            result = -1;
+          trace_fill(mblock, r->handle, kept, r->size);
+        }
+        blocks[r->handle] = mblock;
+        sizes[r->handle] = r->size;
+        break;
+
+      case TRACE_FREE:
+        if (blocks[r->handle] == NULL)
+          break;
+        if (check && !trace_intact(blocks[r->handle], r->handle,
+                                   sizes[r->handle]))
+          result = -1;
+        myalloc_pool_free(pool, blocks[r->handle]);
+        blocks[r->handle] = NULL;
+        break;
+    }
+  }
+
+  myalloc_pool_destroy(pool);
+  return result;
+
+out_of_memory:
+  myalloc_pool_destroy(pool);
+  return 0;
+}
+
+
+// the most memory the trace ever has live at once
+long trace_peak_usage(trace *t, int *sizes) {
+  const trace_record *r, *end;
+  long live = 0, peak = 0;
+
+  memset(sizes, 0, sizeof(int) * t->num_handles);
+
+  end = t->records + t->num_records;
+  for (r = t->records; r < end; r++) {
+    live -= sizes[r->handle];
+    sizes[r->handle] = (r->op == TRACE_FREE) ? 0 : r->size;
+    live += sizes[r->handle];
+    if (live > peak)
+      peak = live;
+  }
+
+  return peak;
+}
+
+
+// the smallest pool that can replay the trace, found by doubling from twice
+//  its peak usage until the replay succeeds and then binary searching below
+//  that.  No pool smaller than the peak or than myalloc_pool_min_size() is
+//  tried, since neither could run the trace.  Returns -1 if even a very
+//  large pool isn't enough.
+int trace_required_memory(trace *t, long peak, unsigned char **blocks,
+                          int *sizes) {
+  long min_size = myalloc_pool_min_size();
+  long low, high, mid;
+
+  low = ((peak > min_size) ? peak : min_size) - 1;
+  high = (2 * peak > min_size) ? 2 * peak : min_size;
+  for (;;) {
+    if (high > (1 << 30))
+      return -1;
+    if (try_trace(t, high, blocks, sizes, 0))
+      break;
+    low = high;
+    high *= 2;
+  }
+  while (low + 1 < high) {
+    mid = low + (high - low) / 2;
+    if (try_trace(t, mid, blocks, sizes, 0))
+      high = mid;
+    else
+      low = mid;
+  }
+
+  return high;
+}
+
+
+// Replay a recorded trace:  find the smallest pool that can run it, check
+// that no block loses data at that size, and time a replay.
+int trace_test(char *path) {
+  trace *t;
+  unsigned char **blocks;
+  int *sizes;
+  long peak;
+  int high, result;
+  struct timespec start, end;
+  double elapsed;
+
+  t = trace_map(path);
+  if (t == NULL)
+    return 1;
+  if (t->num_records == 0) {
+    printf("The trace is empty; there is nothing to replay.\n");
+    trace_unmap(t);
+    return 0;
+  }
+
+  blocks = malloc(sizeof(unsigned char *) * t->num_handles);
+  sizes = malloc(sizeof(int) * t->num_handles);
+  if (blocks == NULL || sizes == NULL) {
+    fprintf(stderr, "real memory exhausted.\n");
+    abort();
+  }
+
+  peak = trace_peak_usage(t, sizes);
+  printf("Replaying %llu operations on %u blocks, peak live memory %ld\n",
+         (unsigned long long) t->num_records, t->num_handles, peak);
+
+  high = trace_required_memory(t, peak, blocks, sizes);
+  if (high == -1) {
+    printf("Requires more than %d bytes.\n", 1 << 30);
+    goto done;
+  }
+
+  result = try_trace(t, high, blocks, sizes, 1);
+  if (result == 0) {
+    printf("Consistency problem: search returned %d, but final replay "
+           "failed\n", high);
+    goto done;
+  }
+  printf("Data integrity %s.\n", (result == 1) ? "PASS" : "FAIL");
+  printf("Memory utilization: (%ld/%d)=%f\n", peak, high,
+         (double) peak / (double) high);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  try_trace(t, high, blocks, sizes, 0);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  printf("Replay throughput: %llu ops in %f sec (%.0f ops/sec)\n",
+         (unsigned long long) t->num_records, elapsed,
+         t->num_records / elapsed);
+
+done:
+  free(blocks);
+  free(sizes);
+  trace_unmap(t);
+  return 0;
+}
+
+
+// A regression test for the pool search on tiny traces:  an empty one, and
+// one that allocates and frees a single byte.  The search used to try pools
+// too small for the allocator's own bookkeeping, and never finished on the
+// empty trace.
+void tiny_trace_test() {
+  trace_record *records;
+  unsigned char *blocks[1];
+  int sizes[1];
+  trace *t;
+  int size;
+  int failure = 0;
+
+  printf("Performing a test of replaying tiny traces.\n");
+
+  t = trace_from_records(NULL, 0, 0);
+  size = trace_required_memory(t, trace_peak_usage(t, sizes), blocks, sizes);
+  if (size != myalloc_pool_min_size()) {
+    printf("An empty trace needed a pool of %d bytes.\n", size);
+    failure = 1;
+  }
+  trace_unmap(t);
+
+  records = calloc(2, sizeof(trace_record));
+  if (records == NULL) {
+    fprintf(stderr, "real memory exhausted.\n");
+    abort();
+  }
+  records[0].op = TRACE_ALLOC;
+  records[0].size = 1;
+  records[1].op = TRACE_FREE;
+  t = trace_from_records(records, 2, 1);
+  size = trace_required_memory(t, trace_peak_usage(t, sizes), blocks, sizes);
+  if (size == -1 || try_trace(t, size, blocks, sizes, 1) != 1) {
+    printf("Couldn't replay a single one-byte block.\n");
+    failure = 1;
+  }
+  trace_unmap(t);
+
+  if (!failure)
+    printf("Passed tiny trace test.\n");
+}
+
+
+// The benchmark replays its trace until it has timed at least this many
+//  operations, so the tail percentiles have enough samples behind them.
+#define BENCH_MIN_OPS 200000
+
+// how many points of the largest-free-block curve the JSON report carries
+#define BENCH_SAMPLES 32
+
+// how many times, at most, the fragmentation replay takes the pool's stats.
+//  Each take walks the whole pool, so taking them after every operation
+//  would make the replay quadratic in the size of the trace.
+#define BENCH_STAT_POINTS 4096
+
+// the latencies of every timed operation of one kind, in nanoseconds
+typedef struct latency_log {
+  long *ns;
+  long count;
+} latency_log;
+
+// everything the benchmark reports for one allocator
+typedef struct bench_report {
+  long ops;
+  long peak;
+  int pool_size;
+
+  // indexed by TRACE_ALLOC, TRACE_FREE and TRACE_REALLOC
+  long count[TRACE_REALLOC + 1];
+  double per_sec[TRACE_REALLOC + 1];
+  long p50[TRACE_REALLOC + 1];
+  long p99[TRACE_REALLOC + 1];
+  long p999[TRACE_REALLOC + 1];
+
+  double peak_fragmentation;
+  long min_largest_free;
+  double mean_largest_free;
+  long largest_free_samples[BENCH_SAMPLES];
+  int num_samples;
+
+  double headers_per_alloc;
+} bench_report;
+
+
+long timespec_ns(struct timespec *start, struct timespec *end) {
+  return (end->tv_sec - start->tv_sec) * 1000000000L +
+         (end->tv_nsec - start->tv_nsec);
+}
+
+
+// replay a trace once against a fresh pool of mem_size bytes, logging how
+//  long each operation took.  Returns 1 on success, or 0 if the pool ran out.
+int bench_replay(trace *t, int mem_size, unsigned char **blocks,
+                 latency_log *logs) {
+  const trace_record *r, *end;
+  unsigned char *mblock = NULL;
+  myalloc_pool_t *pool;
+  struct timespec before, after;
+  int result = 1;
+
+  memset(blocks, 0, sizeof(unsigned char *) * t->num_handles);
+  pool = myalloc_pool_create(mem_size);
+
+  end = t->records + t->num_records;
+  for (r = t->records; r < end; r++) {
+    if (r->op != TRACE_ALLOC && blocks[r->handle] == NULL)
+      continue;
+
+    clock_gettime(CLOCK_MONOTONIC, &before);
+    switch (r->op) {
+      case TRACE_ALLOC:
+        mblock = myalloc_pool_alloc(pool, r->size);
+        break;
+
+      case TRACE_REALLOC:
+        mblock = myalloc_pool_realloc(pool, blocks[r->handle], r->size);
+        break;
+
+      case TRACE_FREE:
+        myalloc_pool_free(pool, blocks[r->handle]);
+        mblock = NULL;
+        break;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &after);
+
+    if (mblock == NULL && r->op != TRACE_FREE) {
+      result = 0;
+      break;
+    }
+    blocks[r->handle] = mblock;
+    logs[r->op].ns[logs[r->op].count++] = timespec_ns(&before, &after);
+  }
+
+  myalloc_pool_destroy(pool);
+  return result;
+}
+
+
+// replay a trace once without timing, taking the pool's stats at up to
+//  BENCH_STAT_POINTS evenly spaced operations (and always at the curve's
+//  sample points and the last operation) to follow fragmentation and the
+//  largest free block over time.  The peak, minimum and mean are over those
+//  points, so on long traces they are estimates.
+void bench_fragmentation(trace *t, int mem_size, unsigned char **blocks,
+                         bench_report *report) {
+  const trace_record *r;
+  myalloc_pool_t *pool;
+  myalloc_stats stats;
+  double fragmentation, largest_sum = 0.0;
+  uint64_t i, stride, num_stats = 0;
+  int curve_point;
+
+  memset(blocks, 0, sizeof(unsigned char *) * t->num_handles);
+  pool = myalloc_pool_create(mem_size);
+
+  report->peak_fragmentation = 0.0;
+  report->min_largest_free = mem_size;
+  report->num_samples = 0;
+  stride = (t->num_records + BENCH_STAT_POINTS - 1) / BENCH_STAT_POINTS;
+
+  for (i = 0; i < t->num_records; i++) {
+    r = &t->records[i];
+    if (r->op == TRACE_ALLOC) {
+      blocks[r->handle] = myalloc_pool_alloc(pool, r->size);
+    }
+    else if (blocks[r->handle] != NULL) {
+      if (r->op == TRACE_REALLOC) {
+        blocks[r->handle] = myalloc_pool_realloc(pool, blocks[r->handle],
+                                                 r->size);
+      }
+      else {
+        myalloc_pool_free(pool, blocks[r->handle]);
+        blocks[r->handle] = NULL;
+      }
+    }
+
+    // the curve is sampled at evenly spaced points through the trace
+    curve_point = (i + 1) * BENCH_SAMPLES / t->num_records !=
+                  i * BENCH_SAMPLES / t->num_records;
+    if (!curve_point && (i + 1) % stride != 0)
+      continue;
+
+    // external fragmentation:  the share of free memory that isn't in the
+    //  largest free block, and so can't serve a request that big
+    myalloc_pool_stats(pool, &stats);
+    num_stats++;
+    fragmentation = (stats.free_bytes > 0) ?
+      1.0 - (double) stats.largest_free / (double) stats.free_bytes : 0.0;
+    if (fragmentation > report->peak_fragmentation)
+      report->peak_fragmentation = fragmentation;
+    if (stats.largest_free < report->min_largest_free)
+      report->min_largest_free = stats.largest_free;
+    largest_sum += stats.largest_free;
+
+    if (curve_point)
+      report->largest_free_samples[report->num_samples++] = stats.largest_free;
+  }
+
+  // the last operation is always a curve point, so "stats" is up to date
+  report->mean_largest_free = largest_sum / num_stats;
+  report->headers_per_alloc = (stats.allocs > 0) ?
+    (double) stats.headers_touched / (double) stats.allocs : 0.0;
+
+  myalloc_pool_destroy(pool);
+}
+
+
+int compare_ns(const void *a, const void *b) {
+  long x = *((const long *) a), y = *((const long *) b);
+  return (x > y) - (x < y);
+}
+
+
+// fill in the rate and percentiles for one kind of operation
+void summarize_latency(latency_log *log, bench_report *report, int op) {
+  long total = 0;
+  long i;
+
+  report->count[op] = log->count;
+  report->per_sec[op] = 0.0;
+  report->p50[op] = report->p99[op] = report->p999[op] = 0;
+  if (log->count == 0)
+    return;
+
+  qsort(log->ns, log->count, sizeof(long), compare_ns);
+  for (i = 0; i < log->count; i++)
+    total += log->ns[i];
+
+  report->per_sec[op] = log->count / (total / 1e9);
+  report->p50[op] = log->ns[(long) (0.5 * (log->count - 1))];
+  report->p99[op] = log->ns[(long) (0.99 * (log->count - 1))];
+  report->p999[op] = log->ns[(long) (0.999 * (log->count - 1))];
+}
+
+
+void print_bench_csv(char *backend, bench_report *r) {
+  printf("backend,ops,peak,pool_size,utilization,"
+         "allocs_per_sec,frees_per_sec,reallocs_per_sec,"
+         "alloc_p50_ns,alloc_p99_ns,alloc_p999_ns,"
+         "free_p50_ns,free_p99_ns,free_p999_ns,"
+         "realloc_p50_ns,realloc_p99_ns,realloc_p999_ns,"
+         "peak_fragmentation,min_largest_free,mean_largest_free,"
+         "headers_per_alloc\n");
+  printf("%s,%ld,%ld,%d,%f,%.0f,%.0f,%.0f,%ld,%ld,%ld,%ld,%ld,%ld,"
+         "%ld,%ld,%ld,%f,%ld,%.1f,%f\n",
+         backend, r->ops, r->peak, r->pool_size,
+         (double) r->peak / r->pool_size,
+         r->per_sec[TRACE_ALLOC], r->per_sec[TRACE_FREE],
+         r->per_sec[TRACE_REALLOC],
+         r->p50[TRACE_ALLOC], r->p99[TRACE_ALLOC], r->p999[TRACE_ALLOC],
+         r->p50[TRACE_FREE], r->p99[TRACE_FREE], r->p999[TRACE_FREE],
+         r->p50[TRACE_REALLOC], r->p99[TRACE_REALLOC], r->p999[TRACE_REALLOC],
+         r->peak_fragmentation, r->min_largest_free, r->mean_largest_free,
+         r->headers_per_alloc);
+}
+
+
+void print_bench_json(char *backend, bench_report *r) {
+  static const char *names[] = { NULL, "alloc", "free", "realloc" };
+  int op, i;
+
+  printf("{\"backend\": \"%s\", \"ops\": %ld, \"peak\": %ld, "
+         "\"pool_size\": %d, \"utilization\": %f",
+         backend, r->ops, r->peak, r->pool_size,
+         (double) r->peak / r->pool_size);
+  for (op = TRACE_ALLOC; op <= TRACE_REALLOC; op++) {
+    printf(", \"%s\": {\"count\": %ld, \"per_sec\": %.0f, \"p50_ns\": %ld, "
+           "\"p99_ns\": %ld, \"p999_ns\": %ld}", names[op], r->count[op],
+           r->per_sec[op], r->p50[op], r->p99[op], r->p999[op]);
+  }
+  printf(", \"peak_fragmentation\": %f, \"min_largest_free\": %ld, "
+         "\"mean_largest_free\": %.1f, \"largest_free_samples\": [",
+         r->peak_fragmentation, r->min_largest_free, r->mean_largest_free);
+  for (i = 0; i < r->num_samples; i++)
+    printf("%s%ld", (i > 0) ? ", " : "", r->largest_free_samples[i]);
+  printf("], \"headers_per_alloc\": %f}\n", r->headers_per_alloc);
+}
+
+
+// Benchmark the allocator on a trace, in the smallest pool that can run it,
+//  and print one machine-readable report.  Nothing else goes to stdout, so
+//  the reports from several allocators can be collected into one file.
+int benchmark_test(trace *t, char *backend, int json) {
+  unsigned char **blocks;
+  int *sizes;
+  latency_log logs[TRACE_REALLOC + 1];
+  bench_report report;
+  long capacity;
+  int op, status = 0;
+
+  if (t->num_records == 0) {
+    fprintf(stderr, "benchmark: the trace is empty\n");
+    return 1;
+  }
+
+  blocks = malloc(sizeof(unsigned char *) * t->num_handles);
+  sizes = malloc(sizeof(int) * t->num_handles);
+  capacity = (BENCH_MIN_OPS / t->num_records + 1) * t->num_records;
+  for (op = TRACE_ALLOC; op <= TRACE_REALLOC; op++) {
+    logs[op].ns = malloc(sizeof(long) * capacity);
+    logs[op].count = 0;
+    if (logs[op].ns == NULL) {
+      fprintf(stderr, "real memory exhausted.\n");
+      abort();
+    }
+  }
+  if (blocks == NULL || sizes == NULL) {
+    fprintf(stderr, "real memory exhausted.\n");
+    abort();
+  }
+
+  report.peak = trace_peak_usage(t, sizes);
+  report.pool_size = trace_required_memory(t, report.peak, blocks, sizes);
+  if (report.pool_size == -1) {
+    fprintf(stderr, "benchmark: requires more than %d bytes\n", 1 << 30);
+    status = 1;
+    goto done;
+  }
+
+  // the search found a pool that runs the whole trace, so a replay that
+  //  runs out anyway would leave the latencies of a partial run
+  report.ops = 0;
+  while (report.ops < BENCH_MIN_OPS) {
+    if (!bench_replay(t, report.pool_size, blocks, logs)) {
+      fprintf(stderr, "benchmark: the replay ran out of memory in a pool "
+              "of %d bytes\n", report.pool_size);
+      status = 1;
+      goto done;
+    }
+    report.ops += t->num_records;
+  }
+  for (op = TRACE_ALLOC; op <= TRACE_REALLOC; op++)
+    summarize_latency(&logs[op], &report, op);
+
+  bench_fragmentation(t, report.pool_size, blocks, &report);
+
+  if (json)
+    print_bench_json(backend, &report);
+  else
+    print_bench_csv(backend, &report);
+
+done:
+  for (op = TRACE_ALLOC; op <= TRACE_REALLOC; op++)
+    free(logs[op].ns);
+  free(blocks);
+  free(sizes);
+  return status;
 }
 
 
 void usage(char *program) {
-  printf("usage: %s [-s seed] [-m max_allocation]\n", program);
+  printf("usage: %s [-s seed] [-m max_allocation] [-r realloc_percent] "
+         "[-j threads]\n\t[-w trace_file] [-T trace_file] [-B csv|json]\n",
+         program);
   printf("\tRuns the myalloc tester.\n\n");
   printf("\t-s seed sets the tester to use a specific random seed\n\n");
   printf("\t-m max_allocation sets the maximum number of bytes that the\n");
   printf("\ttester should try to allocate during utilization tests\n\n");
+  printf("\t-r realloc_percent sets how often (0-100) the utilization test\n");
+  printf("\tresizes a live block instead of allocating a new one\n\n");
+  printf("\t-j threads searches for the smallest workable pool size by\n");
+  printf("\ttrying several candidate sizes at once; the size found is the\n");
+  printf("\tsame for any thread count\n\n");
+  printf("\t-w trace_file records the utilization test's sequence as a\n");
+  printf("\tbinary trace\n\n");
+  printf("\t-T trace_file replays a binary trace instead of running the\n");
+  printf("\tgenerated tests\n\n");
+  printf("\t-B csv|json benchmarks the allocator on the utilization test's\n");
+  printf("\tsequence (or on the -T trace) and prints one report line:\n");
+  printf("\tthroughput and p50/p99/p999 latency per operation, peak\n");
+  printf("\tfragmentation, the largest free block over time, and headers\n");
+  printf("\ttouched per allocation\n\n");
 }
 
 
@@ -494,20 +1646,64 @@ void usage(char *program) {
 int main(int argc, char *argv[]) {
   unsigned int seed = DEFAULT_RANDOM_SEED;
   int max_allocation = DEFAULT_MAX_ALLOCATION;
-  int c;
+  int realloc_percent = DEFAULT_REALLOC_PERCENT;
+  int nthreads = 1;
+  char *trace_out = NULL;
+  char *trace_in = NULL;
+  char *bench_format = NULL;
+  SEQLIST *test_sequence;
+  trace *t;
+  int c, result;
 
-  while ((c = getopt(argc, argv, "s:m:")) != -1) {
+  while ((c = getopt(argc, argv, "s:m:r:j:w:T:B:h")) != -1) {
     switch (c) {
       case 's':    /* Random seed */
         seed = atoi(optarg);
         break;
 
-      case 'p':
+      case 'm':
         max_allocation = atoi(optarg);
-        if (max_allocation < 0)
+        if (max_allocation < 0) {
           printf("ERROR:  Max allocation must be nonnegative.\n");
           usage(argv[0]);
           return 1;
+        }
+        break;
+
+      case 'r':    /* Share of reallocations */
+        realloc_percent = atoi(optarg);
+        if (realloc_percent < 0 || realloc_percent > 100) {
+          printf("ERROR:  Realloc percentage must be between 0 and 100.\n");
+          usage(argv[0]);
+          return 1;
+        }
+        break;
+
+      case 'j':    /* Search threads */
+        nthreads = atoi(optarg);
+        if (nthreads < 1) {
+          printf("ERROR:  Thread count must be positive.\n");
+          usage(argv[0]);
+          return 1;
+        }
+        break;
+
+      case 'w':    /* Record the sequence */
+        trace_out = optarg;
+        break;
+
+      case 'T':    /* Replay a trace */
+        trace_in = optarg;
+        break;
+
+      case 'B':    /* Benchmark */
+        bench_format = optarg;
+        if (strcmp(bench_format, "csv") != 0 &&
+            strcmp(bench_format, "json") != 0) {
+          printf("ERROR:  Benchmark format must be csv or json.\n");
+          usage(argv[0]);
+          return 1;
+        }
         break;
 
       case 'h':
@@ -516,6 +1712,28 @@ int main(int argc, char *argv[]) {
     }
   }
 
+  if (bench_format != NULL) {
+    if (trace_in != NULL) {
+      t = trace_map(trace_in);
+      if (t == NULL)
+        return 1;
+    }
+    else {
+      srand(seed);
+      report_only = 1;
+      test_sequence = generate_sequence(max_allocation, 11, realloc_percent);
+      t = sequence_trace(test_sequence);
+      seq_cleanup(test_sequence);
+    }
+    result = benchmark_test(t, basename(argv[0]),
+                            strcmp(bench_format, "json") == 0);
+    trace_unmap(t);
+    return result;
+  }
+
+  if (trace_in != NULL)
+    return trace_test(trace_in);
+
   if (seed != DEFAULT_RANDOM_SEED)
     printf("Using seed:  %u\n\n", seed);
 
@@ -525,14 +1743,25 @@ int main(int argc, char *argv[]) {
   coalesce_test();
   printf("\n");
 
+  // Do the basic test of reallocation.  The buddy allocator only promises
+  // to resize in place between buddies, so it gets a test of just that.
+  if (strstr(basename(argv[0]), "buddy") != NULL)
+    buddy_realloc_test();
+  else
+    realloc_test();
+  printf("\n");
+
   // Do the basic test with repeated allocation of many uniform chunks
   uniform_chunk_test();
   printf("\n");
 
-  // Do the memory utilization test to see how efficient the allocator is
-  utilization_test(max_allocation);
+  // Do the test of finding the pool size for tiny traces
+  tiny_trace_test();
+  printf("\n");
 
-  return 0;
+  // Do the memory utilization test to see how efficient the allocator is
+  return utilization_test(max_allocation, realloc_percent, nthreads,
+                          trace_out);
 }
 
 
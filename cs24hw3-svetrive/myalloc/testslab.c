@@ -0,0 +1,243 @@
+/*! \file
+ * A tester for the slab allocator in slab.c.  For a few object sizes it
+ * compares the slab caches against calling myalloc() directly:  how many
+ * objects fit in the same pool, and how fast a churn of allocations and
+ * frees runs.  A mixed churn over several caches at once checks that no
+ * object is corrupted, and that every slab goes back to the pool at the end.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "myalloc.h"
+#include "slab.h"
+
+
+#define DEFAULT_POOL_SIZE (256 * 1024)
+#define DEFAULT_OPS 200000
+
+/*! How many live objects the churn keeps per object size. */
+#define SLOTS 1024
+
+static int obj_sizes[] = { 16, 24, 48, 100 };
+#define NUM_SIZES ((int) (sizeof(obj_sizes) / sizeof(obj_sizes[0])))
+
+
+static void fill(unsigned char *obj, int size, int tag) {
+    int i;
+    for (i = 0; i < size; i++)
+        obj[i] = (unsigned char) (tag + i);
+}
+
+
+/* Returns nonzero if the object still holds the pattern fill() put there. */
+static int intact(unsigned char *obj, int size, int tag) {
+    int i;
+    for (i = 0; i < size; i++) {
+        if (obj[i] != (unsigned char) (tag + i))
+            return 0;
+    }
+    return 1;
+}
+
+
+/* Returns nonzero if the whole default pool can be allocated as one block. */
+static int pool_is_whole() {
+    unsigned char *block = myalloc(MEMORY_SIZE - 2 * sizeof(int));
+    if (block == NULL)
+        return 0;
+    myfree(block);
+    return 1;
+}
+
+
+/*!
+ * Counts how many objects of "size" bytes fit in a fresh pool, allocating
+ * them either straight from myalloc() or from a slab cache.
+ */
+int capacity(int size, int use_slabs) {
+    slab_cache *cache = NULL;
+    unsigned char *obj;
+    int count = 0;
+
+    init_myalloc();
+    if (use_slabs)
+        cache = slab_create(size);
+
+    do {
+        obj = use_slabs ? slab_alloc(cache) : myalloc(size);
+        count++;
+    } while (obj != NULL);
+
+    if (use_slabs)
+        slab_destroy(cache);
+    close_myalloc();
+    return count - 1;
+}
+
+
+/*!
+ * Repeatedly frees and replaces random objects of "size" bytes, and returns
+ * the number of operations per second.
+ */
+double churn_rate(int size, int ops, int use_slabs) {
+    unsigned char *objs[SLOTS] = { NULL };
+    slab_cache *cache = NULL;
+    struct timespec start, end;
+    unsigned int seed = 1;
+    int i, slot;
+
+    init_myalloc();
+    if (use_slabs)
+        cache = slab_create(size);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < ops; i++) {
+        slot = rand_r(&seed) % SLOTS;
+        if (objs[slot] != NULL) {
+            if (use_slabs)
+                slab_free(cache, objs[slot]);
+            else
+                myfree(objs[slot]);
+            objs[slot] = NULL;
+        }
+        else {
+            objs[slot] = use_slabs ? slab_alloc(cache) : myalloc(size);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    for (slot = 0; slot < SLOTS; slot++) {
+        if (objs[slot] != NULL) {
+            if (use_slabs)
+                slab_free(cache, objs[slot]);
+            else
+                myfree(objs[slot]);
+        }
+    }
+    if (use_slabs)
+        slab_destroy(cache);
+    close_myalloc();
+
+    return ops / ((end.tv_sec - start.tv_sec) +
+                  (end.tv_nsec - start.tv_nsec) / 1e9);
+}
+
+
+/*!
+ * Churns objects of every size at once, each in its own cache, checking
+ * every object's contents when it is freed.  Once everything is freed and
+ * the caches are destroyed, the pool should be back to a single free block.
+ * Returns the number of problems found.
+ */
+int integrity_test(int ops) {
+    slab_cache *caches[NUM_SIZES];
+    unsigned char *objs[NUM_SIZES][SLOTS] = { { NULL } };
+    int tags[NUM_SIZES][SLOTS];
+    unsigned int seed = 2;
+    int errors = 0;
+    int i, k, slot;
+
+    init_myalloc();
+    for (k = 0; k < NUM_SIZES; k++)
+        caches[k] = slab_create(obj_sizes[k]);
+
+    for (i = 0; i < ops; i++) {
+        k = rand_r(&seed) % NUM_SIZES;
+        slot = rand_r(&seed) % SLOTS;
+        if (objs[k][slot] != NULL) {
+            if (!intact(objs[k][slot], obj_sizes[k], tags[k][slot]))
+                errors++;
+            slab_free(caches[k], objs[k][slot]);
+            objs[k][slot] = NULL;
+        }
+        else {
+            objs[k][slot] = slab_alloc(caches[k]);
+            if (objs[k][slot] == NULL) {
+                printf("Pool exhausted after %d operations.\n", i);
+                errors++;
+                break;
+            }
+            tags[k][slot] = i;
+            fill(objs[k][slot], obj_sizes[k], i);
+        }
+    }
+
+    for (k = 0; k < NUM_SIZES; k++) {
+        for (slot = 0; slot < SLOTS; slot++) {
+            if (objs[k][slot] == NULL)
+                continue;
+            if (!intact(objs[k][slot], obj_sizes[k], tags[k][slot]))
+                errors++;
+            slab_free(caches[k], objs[k][slot]);
+        }
+    }
+
+    for (k = 0; k < NUM_SIZES; k++)
+        slab_destroy(caches[k]);
+
+    if (!pool_is_whole()) {
+        printf("Slabs were not all returned to the pool.\n");
+        errors++;
+    }
+    close_myalloc();
+
+    return errors;
+}
+
+
+void usage(char *program) {
+    printf("usage: %s [-n ops] [-m pool_size]\n", program);
+    printf("\tRuns the slab allocator tests.\n\n");
+    printf("\t-n ops sets how many operations each churn does\n");
+    printf("\t-m pool_size sets the size of the myalloc pool in bytes\n\n");
+}
+
+
+int main(int argc, char *argv[]) {
+    int ops = DEFAULT_OPS;
+    int errors;
+    int k, c;
+
+    MEMORY_SIZE = DEFAULT_POOL_SIZE;
+
+    while ((c = getopt(argc, argv, "n:m:h")) != -1) {
+        switch (c) {
+        case 'n':
+            ops = atoi(optarg);
+            break;
+
+        case 'm':
+            MEMORY_SIZE = atoi(optarg);
+            break;
+
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (ops < 1 || MEMORY_SIZE < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("size  myalloc objects  slab objects  myalloc ops/sec  "
+           "slab ops/sec\n");
+    for (k = 0; k < NUM_SIZES; k++) {
+        printf("%4d  %15d  %12d  %15.0f  %12.0f\n", obj_sizes[k],
+               capacity(obj_sizes[k], 0), capacity(obj_sizes[k], 1),
+               churn_rate(obj_sizes[k], ops, 0),
+               churn_rate(obj_sizes[k], ops, 1));
+    }
+
+    errors = integrity_test(ops);
+    if (errors != 0) {
+        printf("Data integrity FAIL (%d problems).\n", errors);
+        return 1;
+    }
+    printf("Data integrity PASS.\n");
+    return 0;
+}
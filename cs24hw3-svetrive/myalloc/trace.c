@@ -0,0 +1,204 @@
+/*! \file
+ * Recording and mapping of binary allocation traces.  Recording goes through
+ * a buffered stdio stream, so the cost per operation is a copy into the
+ * buffer.  Replay maps the file read-only and hands back a pointer to the
+ * record array, so reading a record is an array index with no parsing and
+ * no pointer chasing.  Every record is checked once when the file is mapped,
+ * so replay code can index its handle arrays without checking again.
+ */
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+
+struct trace_writer {
+    FILE *file;
+    trace_header header;
+    int failed;             /*!< Set once any write has failed. */
+};
+
+
+trace_writer * trace_open(const char *path) {
+    trace_writer *w = (trace_writer *) malloc(sizeof(trace_writer));
+
+    if (w == NULL) {
+        fprintf(stderr, "trace_open: out of memory\n");
+        abort();
+    }
+
+    w->file = fopen(path, "wb");
+    if (w->file == NULL) {
+        perror(path);
+        free(w);
+        return NULL;
+    }
+
+    // the header is written again with the real counts on close
+    memset(&w->header, 0, sizeof(trace_header));
+    memcpy(w->header.magic, TRACE_MAGIC, 4);
+    w->header.version = TRACE_VERSION;
+    w->failed = (fwrite(&w->header, sizeof(trace_header), 1, w->file) != 1);
+
+    return w;
+}
+
+
+static void write_record(trace_writer *w, uint8_t op, uint32_t handle,
+                         uint32_t size) {
+    trace_record r;
+
+    memset(&r, 0, sizeof(trace_record));
+    r.op = op;
+    r.handle = handle;
+    r.size = size;
+    if (fwrite(&r, sizeof(trace_record), 1, w->file) != 1)
+        w->failed = 1;
+
+    w->header.num_records++;
+    if (handle >= w->header.num_handles)
+        w->header.num_handles = handle + 1;
+}
+
+void trace_record_alloc(trace_writer *w, uint32_t handle, uint32_t size) {
+    write_record(w, TRACE_ALLOC, handle, size);
+}
+
+void trace_record_free(trace_writer *w, uint32_t handle) {
+    write_record(w, TRACE_FREE, handle, 0);
+}
+
+void trace_record_realloc(trace_writer *w, uint32_t handle, uint32_t size) {
+    write_record(w, TRACE_REALLOC, handle, size);
+}
+
+
+int trace_close(trace_writer *w) {
+    int failed = w->failed;
+
+    // seeking flushes the records, so it fails if they can't be written
+    if (fseek(w->file, 0, SEEK_SET) != 0 ||
+        fwrite(&w->header, sizeof(trace_header), 1, w->file) != 1)
+        failed = 1;
+    if (fclose(w->file) != 0)
+        failed = 1;
+    free(w);
+
+    return failed ? -1 : 0;
+}
+
+
+/* Returns the index of the first record that replay can't safely act on,
+ * or num_records if they are all valid:  the handle must be below
+ * num_handles, the op must be known, and the size must fit in an int.
+ */
+static uint64_t first_bad_record(const trace_record *records,
+                                 uint64_t num_records, uint32_t num_handles) {
+    uint64_t i;
+
+    for (i = 0; i < num_records; i++) {
+        if (records[i].handle >= num_handles ||
+            records[i].op < TRACE_ALLOC || records[i].op > TRACE_REALLOC ||
+            records[i].size > INT_MAX)
+            break;
+    }
+    return i;
+}
+
+
+trace * trace_map(const char *path) {
+    trace *t;
+    const trace_header *h;
+    const trace_record *records;
+    struct stat st;
+    uint64_t bad;
+    void *map;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        perror(path);
+        return NULL;
+    }
+    if (fstat(fd, &st) == -1 || st.st_size < (off_t) sizeof(trace_header)) {
+        fprintf(stderr, "%s: not a trace file\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror(path);
+        return NULL;
+    }
+
+    h = (const trace_header *) map;
+    if (memcmp(h->magic, TRACE_MAGIC, 4) != 0 || h->version != TRACE_VERSION ||
+        h->num_records > (st.st_size - sizeof(trace_header)) /
+                         sizeof(trace_record)) {
+        fprintf(stderr, "%s: not a version %d trace file\n", path,
+                TRACE_VERSION);
+        munmap(map, st.st_size);
+        return NULL;
+    }
+
+    // the records are read front to back, here and in each replay
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    records = (const trace_record *) ((const char *) map + sizeof(trace_header));
+    bad = first_bad_record(records, h->num_records, h->num_handles);
+    if (bad != h->num_records) {
+        fprintf(stderr, "%s: record %llu is invalid\n", path,
+                (unsigned long long) bad);
+        munmap(map, st.st_size);
+        return NULL;
+    }
+
+    t = (trace *) malloc(sizeof(trace));
+    if (t == NULL) {
+        fprintf(stderr, "trace_map: out of memory\n");
+        abort();
+    }
+    t->records = records;
+    t->num_records = h->num_records;
+    t->num_handles = h->num_handles;
+    t->map = map;
+    t->map_size = st.st_size;
+
+    return t;
+}
+
+
+trace * trace_from_records(trace_record *records, uint64_t num_records,
+                           uint32_t num_handles) {
+    trace *t = (trace *) malloc(sizeof(trace));
+
+    if (t == NULL) {
+        fprintf(stderr, "trace_from_records: out of memory\n");
+        abort();
+    }
+    t->records = records;
+    t->num_records = num_records;
+    t->num_handles = num_handles;
+    t->map = NULL;
+    t->map_size = 0;
+
+    return t;
+}
+
+
+void trace_unmap(trace *t) {
+    if (t->map != NULL)
+        munmap(t->map, t->map_size);
+    else
+        free((void *) t->records);
+    free(t);
+}
@@ -0,0 +1,86 @@
+/*! \file
+ * Declarations for recording allocation traces to a compact binary file, and
+ * for mapping such a file back into memory for fast replay.
+ *
+ * A trace file is a trace_header followed by an array of fixed-size
+ * trace_records.  Each record names the block it acts on by a small integer
+ * handle chosen by the recorder, instead of by address, so a trace can be
+ * replayed against any allocator.  A realloc keeps its block's handle.
+ * Files are written in the host's byte order, which in practice means
+ * little-endian.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/*! The first four bytes of every trace file. */
+#define TRACE_MAGIC "MATR"
+#define TRACE_VERSION 1
+
+/* Operation codes. */
+#define TRACE_ALLOC 1
+#define TRACE_FREE 2
+#define TRACE_REALLOC 3
+
+
+typedef struct trace_header {
+    char magic[4];
+    uint32_t version;
+    uint64_t num_records;
+    uint32_t num_handles;   /*!< One more than the largest handle used. */
+    uint32_t pad;
+} trace_header;
+
+
+typedef struct trace_record {
+    uint32_t handle;
+    uint32_t size;          /*!< New size for alloc and realloc, else 0. */
+    uint8_t op;
+    uint8_t pad[3];
+} trace_record;
+
+
+/*! A trace being recorded. */
+typedef struct trace_writer trace_writer;
+
+/* Start recording a trace into the file at "path". */
+trace_writer * trace_open(const char *path);
+
+/* Record operations on the block identified by "handle". */
+void trace_record_alloc(trace_writer *w, uint32_t handle, uint32_t size);
+void trace_record_free(trace_writer *w, uint32_t handle);
+void trace_record_realloc(trace_writer *w, uint32_t handle, uint32_t size);
+
+/* Finish the file, filling in the header's counts.  Returns 0 on success, or
+ * -1 if any part of the file couldn't be written, in which case the file is
+ * incomplete.
+ */
+int trace_close(trace_writer *w);
+
+
+/*!
+ * A trace file mapped into memory for replay.  A trace built in memory by
+ * trace_from_records() has no mapping, and map is NULL.
+ */
+typedef struct trace {
+    const trace_record *records;
+    uint64_t num_records;
+    uint32_t num_handles;
+
+    void *map;
+    size_t map_size;
+} trace;
+
+/* Map the trace file at "path", or return NULL if it isn't a valid trace.
+ * Every record is checked:  its handle must be below num_handles, its op
+ * must be one of the TRACE_xxx codes, and its size must be at most INT_MAX.
+ */
+trace * trace_map(const char *path);
+
+/* Wrap a malloc'd array of records as a trace, which takes ownership of it. */
+trace * trace_from_records(trace_record *records, uint64_t num_records,
+                           uint32_t num_handles);
+
+/* Unmap or free a trace returned by trace_map() or trace_from_records(). */
+void trace_unmap(trace *t);
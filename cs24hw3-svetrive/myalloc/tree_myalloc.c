@@ -0,0 +1,279 @@
+/*! \file
+ * Implementation of a best-fit memory allocator that indexes its free blocks
+ * in a red-black tree.  The allocator manages a small pool of memory, provides
+ * memory chunks on request, and reintegrates freed memory back into the pool.
+ *
+ * Blocks use the same header/footer boundary tags as the linear best-fit
+ * allocator: an int holding the payload size at each end, negated while the
+ * block is allocated.  Each free block also stores a tree node at the start
+ * of its payload.  The tree is ordered by (size, address), so the leftmost
+ * node that is large enough is exactly the block the linear scan would pick:
+ * the smallest one that fits, lowest address first among equal sizes.
+ *
+ * Adapted from Andre DeHon's CS24 2004, 2006 material.
+ * Copyright (C) California Institute of Technology, 2004-2010.
+ * All rights reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "myalloc.h"
+#include "btag.h"
+#include "rbtree.h"
+
+
+/*! Smallest payload a block may have, so it can hold a node once freed. */
+#define MIN_PAYLOAD ((int) sizeof(rb_node))
+
+
+/*!
+ * The state of one allocator instance:  the size and address of its memory
+ * pool, and its tree of free blocks.
+ */
+struct myalloc_pool {
+    int size;
+    unsigned char *mem;
+    rb_tree free_tree;
+
+    long allocs;
+    long headers_touched;
+};
+
+
+/*!
+ * MEMORY_SIZE specifies the size of the default pool, which init_myalloc()
+ * creates and myalloc() and myfree() work against.
+ */
+int MEMORY_SIZE;
+static myalloc_pool_t *default_pool;
+
+
+/* Node helpers.  The boundary tags are handled by btag.h. */
+
+static rb_node * node_of(unsigned char *header) {
+    return (rb_node *) (header + TAG_SIZE);
+}
+
+static unsigned char * header_of(rb_node *n) {
+    return (unsigned char *) n - TAG_SIZE;
+}
+
+
+/* The tree of free blocks (see rbtree.h) works with the nodes in their
+ * payloads, and the rest of the allocator with their headers.
+ */
+
+static void tree_insert(myalloc_pool_t *pool, unsigned char *header) {
+    rb_insert(&pool->free_tree, node_of(header));
+}
+
+static void tree_remove(myalloc_pool_t *pool, unsigned char *header) {
+    rb_remove(&pool->free_tree, node_of(header));
+}
+
+/*!
+ * Returns the header of the smallest free block with at least "size" payload
+ * bytes, lowest address first among ties, or NULL if no block is big enough.
+ */
+static unsigned char * tree_best_fit(myalloc_pool_t *pool, int size) {
+    rb_node *best = rb_best_fit(&pool->free_tree, size,
+                                &pool->headers_touched);
+
+    return (best == NULL) ? NULL : header_of(best);
+}
+
+
+/*! Returns nonzero if "tag" lies inside the pool. */
+static int in_pool(myalloc_pool_t *pool, unsigned char *tag) {
+    return tag >= pool->mem && tag < pool->mem + pool->size;
+}
+
+/*! How the shared boundary-tag code finds and unlinks free blocks. */
+static const btag_ops tag_ops = { MIN_PAYLOAD, in_pool, tree_remove };
+
+
+/*!
+ * This function initializes both the allocator state, and the memory pool of a
+ * new allocator instance.
+ *
+ * The whole pool starts out as one free block, which becomes the tree's root.
+ */
+myalloc_pool_t * myalloc_pool_create(int size) {
+    myalloc_pool_t *pool = (myalloc_pool_t *) malloc(sizeof(myalloc_pool_t));
+    unsigned char *mem = (unsigned char *) malloc(size);
+
+    if (pool == 0 || mem == 0) {
+        fprintf(stderr,
+                "myalloc_pool_create: could not get %d bytes from the system\n",
+                size);
+        abort();
+    }
+    pool->size = size;
+    pool->mem = mem;
+
+    rb_init(&pool->free_tree);
+    pool->allocs = 0;
+    pool->headers_touched = 0;
+
+    if (size - 2 * TAG_SIZE >= MIN_PAYLOAD) {
+        set_tags(mem, size - 2 * TAG_SIZE);
+        tree_insert(pool, mem);
+    }
+    return pool;
+}
+
+
+/*!
+ * The smallest pool that can hold a block:  two tags around the smallest
+ * payload.
+ */
+int myalloc_pool_min_size() {
+    return 2 * TAG_SIZE + MIN_PAYLOAD;
+}
+
+
+/*!
+ * Attempt to allocate a chunk of memory of "size" bytes.  Return 0 if
+ * allocation fails.
+ *
+ * This is the same best-fit placement as the linear allocator, but the best
+ * block is found by a single root-to-leaf descent of the tree instead of a
+ * walk over every block in the pool, so allocation is O(log n) in the number
+ * of free blocks.
+ */
+unsigned char *myalloc_pool_alloc(myalloc_pool_t *pool, int size) {
+    unsigned char *best;
+    int best_size;
+
+    if (size < MIN_PAYLOAD)
+        size = MIN_PAYLOAD;
+
+    pool->allocs++;
+    best = tree_best_fit(pool, size);
+    if (best == NULL) {
+        fprintf(stderr, "myalloc: cannot service request of size %d\n", size);
+        return (unsigned char *) 0;
+    }
+
+    tree_remove(pool, best);
+    best_size = block_size(best);
+
+    // split off the tail if it can hold a block of its own
+    if (best_size - size >= 2 * TAG_SIZE + MIN_PAYLOAD) {
+        unsigned char *rest = best + 2 * TAG_SIZE + size;
+        set_tags(rest, best_size - size - 2 * TAG_SIZE);
+        tree_insert(pool, rest);
+        best_size = size;
+    }
+
+    set_tags(best, -best_size);
+    return best + TAG_SIZE;
+}
+
+
+/*!
+ * Free a previously allocated pointer.  oldptr should be an address returned by
+ * myalloc().
+ *
+ * Neighbours are found through the boundary tags as before; any free
+ * neighbour is taken out of the tree before merging, and the merged block is
+ * inserted once, so freeing is O(log n).
+ */
+void myalloc_pool_free(myalloc_pool_t *pool, unsigned char *oldptr) {
+    unsigned char *header = oldptr - TAG_SIZE;
+    int size = abs(block_size(header));
+
+    // merge with the right neighbour
+    unsigned char *right = header + 2 * TAG_SIZE + size;
+    if (right < pool->mem + pool->size && block_size(right) > 0) {
+        tree_remove(pool, right);
+        size += 2 * TAG_SIZE + block_size(right);
+    }
+
+    // merge with the left neighbour
+    if (header > pool->mem) {
+        int left_size = *((int *) (header - TAG_SIZE));
+        if (left_size > 0) {
+            unsigned char *left = header - 2 * TAG_SIZE - left_size;
+            tree_remove(pool, left);
+            size += 2 * TAG_SIZE + left_size;
+            header = left;
+        }
+    }
+
+    set_tags(header, size);
+    tree_insert(pool, header);
+}
+
+
+/*!
+ * Resize a previously allocated pointer to "size" bytes, preserving its
+ * contents up to the smaller of the two sizes.  Return the (possibly moved)
+ * block, or 0 if the request can't be serviced, in which case the old block
+ * is left alone.
+ *
+ * The shared btag_realloc() shrinks in place, grows into a free right or
+ * left neighbour, or moves the block; neighbours are taken out of the tree
+ * before their space is reused.
+ */
+unsigned char *myalloc_pool_realloc(myalloc_pool_t *pool, unsigned char *oldptr,
+                                    int size) {
+    return btag_realloc(pool, &tag_ops, oldptr, size);
+}
+
+
+/*!
+ * Report on the pool's free space by walking every block through its
+ * boundary tags.
+ */
+void myalloc_pool_stats(myalloc_pool_t *pool, myalloc_stats *stats) {
+    stats->free_bytes = 0;
+    stats->largest_free = 0;
+    stats->free_blocks = 0;
+    stats->allocs = pool->allocs;
+    stats->headers_touched = pool->headers_touched;
+
+    // a pool too small for even one block has no tags at all
+    if (pool->size - 2 * TAG_SIZE >= MIN_PAYLOAD)
+        btag_count_free(pool->mem, pool->mem + pool->size, stats);
+}
+
+
+/*!
+ * Clean up the allocator state.
+ * All this really has to do is free the user memory pool. This function mostly
+ * ensures that the test program doesn't leak memory, so it's easy to check
+ * if the allocator does.
+ */
+void myalloc_pool_destroy(myalloc_pool_t *pool) {
+    free(pool->mem);
+    free(pool);
+}
+
+
+/*!
+ * The single-pool interface.  These work against the default pool of
+ * MEMORY_SIZE bytes, which init_myalloc() must create before myalloc() or
+ * myfree() will work at all.
+ */
+void init_myalloc() {
+    default_pool = myalloc_pool_create(MEMORY_SIZE);
+}
+
+unsigned char *myalloc(int size) {
+    return myalloc_pool_alloc(default_pool, size);
+}
+
+void myfree(unsigned char *oldptr) {
+    myalloc_pool_free(default_pool, oldptr);
+}
+
+unsigned char *myrealloc(unsigned char *oldptr, int size) {
+    return myalloc_pool_realloc(default_pool, oldptr, size);
+}
+
+void close_myalloc() {
+    myalloc_pool_destroy(default_pool);
+    default_pool = NULL;
+}
@@ -10,33 +10,40 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "myalloc.h"
 
 
 /*!
- * These variables are used to specify the size and address of the memory pool
- * that the simple allocator works against.  The memory pool is allocated within
- * init_myalloc(), and then myalloc() and free() work against this pool of
- * memory that mem points to.
+ * The state of one allocator instance:  the size and address of the memory
+ * pool it works against.  The memory pool is allocated within
+ * myalloc_pool_create(), and then myalloc_pool_alloc() and myalloc_pool_free()
+ * work against the pool of memory that mem points to.
+ *
+ * The unacceptable allocator uses an external "free-pointer" to track where
+ * free memory starts.
  */
-int MEMORY_SIZE;
-unsigned char *mem;
+struct myalloc_pool {
+    int size;
+    unsigned char *mem;
+    unsigned char *freeptr;
 
+    long allocs;
+};
 
-/* TODO:  The unacceptable allocator uses an external "free-pointer" to track
- *        where free memory starts.  If your allocator doesn't use this
- *        variable, get rid of it.
- *
- *        You can declare data types, constants, and statically declared
- *        variables for managing your memory pool in this section too.
+
+/*!
+ * MEMORY_SIZE specifies the size of the default pool, which init_myalloc()
+ * creates and myalloc() and myfree() work against.
  */
-static unsigned char *freeptr;
+int MEMORY_SIZE;
+static myalloc_pool_t *default_pool;
 
 
 /*!
- * This function initializes both the allocator state, and the memory pool.  It
- * must be called before myalloc() or myfree() will work at all.
+ * This function initializes both the allocator state, and the memory pool of a
+ * new allocator instance.
  *
  * Note that we allocate the entire memory pool using malloc().  This is so we
  * can create different memory-pool sizes for testing.  Obviously, in a real
@@ -44,22 +51,37 @@ static unsigned char *freeptr;
  * allocator would request a memory region from the operating system (see the
  * C standard function sbrk(), for example).
  */
-void init_myalloc() {
+myalloc_pool_t * myalloc_pool_create(int size) {
+    myalloc_pool_t *pool = (myalloc_pool_t *) malloc(sizeof(myalloc_pool_t));
+    unsigned char *mem;
 
     /*
      * Allocate the entire memory pool, from which our simple allocator will
      * serve allocation requests.
      */
-    mem = (unsigned char *) malloc(MEMORY_SIZE);
-    if (mem == 0) {
+    mem = (unsigned char *) malloc(size);
+    if (pool == 0 || mem == 0) {
         fprintf(stderr,
-                "init_myalloc: could not get %d bytes from the system\n",
-		MEMORY_SIZE);
+                "myalloc_pool_create: could not get %d bytes from the system\n",
+                size);
         abort();
     }
+    pool->size = size;
+    pool->mem = mem;
 
     /* TODO:  You can initialize the initial state of your memory pool here. */
-    freeptr = mem;
+    pool->freeptr = mem;
+    pool->allocs = 0;
+    return pool;
+}
+
+
+/*!
+ * The smallest pool that can hold a block.  The free pointer has to stay
+ * inside the pool, so a one-byte block needs two bytes.
+ */
+int myalloc_pool_min_size() {
+    return 2;
 }
 
 
@@ -67,7 +89,7 @@ void init_myalloc() {
  * Attempt to allocate a chunk of memory of "size" bytes.  Return 0 if
  * allocation fails.
  */
-unsigned char *myalloc(int size) {
+unsigned char *myalloc_pool_alloc(myalloc_pool_t *pool, int size) {
 
     /* TODO:  The unacceptable allocator simply checks to see if there are at
      *        least "size" bytes left in the pool, and if so, the caller gets
@@ -76,14 +98,15 @@ unsigned char *myalloc(int size) {
      *
      *        Your allocator will be more sophisticated!
      */
-    if (freeptr + size < mem + MEMORY_SIZE) {
-        unsigned char *resultptr = freeptr;
-        freeptr += size;
+    pool->allocs++;
+    if (pool->freeptr + size < pool->mem + pool->size) {
+        unsigned char *resultptr = pool->freeptr;
+        pool->freeptr += size;
         return resultptr;
     }
     else {
         fprintf(stderr, "myalloc: cannot service request of size %d with"
-                " %lx bytes allocated\n", size, (freeptr - mem));
+                " %lx bytes allocated\n", size, (pool->freeptr - pool->mem));
         return (unsigned char *) 0;
     }
 }
@@ -93,7 +116,7 @@ unsigned char *myalloc(int size) {
  * Free a previously allocated pointer.  oldptr should be an address returned by
  * myalloc().
  */
-void myfree(unsigned char *oldptr) {
+void myalloc_pool_free(myalloc_pool_t *pool, unsigned char *oldptr) {
     /* TODO:
      *
      * The unacceptable allocator does nothing -- that's part of why this is
@@ -103,12 +126,72 @@ void myfree(unsigned char *oldptr) {
      */
 }
 
+/*!
+ * Resize a previously allocated pointer to "size" bytes.
+ *
+ * The unacceptable allocator doesn't record block sizes, so it always moves
+ * the block.  The old block can't extend past the free-pointer, so copying up
+ * to there is enough to carry its contents over.
+ */
+unsigned char *myalloc_pool_realloc(myalloc_pool_t *pool, unsigned char *oldptr,
+                                    int size) {
+    unsigned char *newptr = myalloc_pool_alloc(pool, size);
+
+    if (newptr != NULL && oldptr != NULL) {
+        long avail = newptr - oldptr;
+        memcpy(newptr, oldptr, (size < avail) ? size : avail);
+    }
+    return newptr;
+}
+
+
+/*!
+ * Report on the pool's free space.  The only free space is what lies past
+ * the free-pointer, and finding it never examines a block.
+ */
+void myalloc_pool_stats(myalloc_pool_t *pool, myalloc_stats *stats) {
+    stats->free_bytes = pool->mem + pool->size - pool->freeptr;
+    stats->largest_free = stats->free_bytes;
+    stats->free_blocks = (stats->free_bytes > 0) ? 1 : 0;
+    stats->allocs = pool->allocs;
+    stats->headers_touched = 0;
+}
+
+
 /*!
  * Clean up the allocator state.
  * All this really has to do is free the user memory pool. This function mostly
  * ensures that the test program doesn't leak memory, so it's easy to check
  * if the allocator does.
  */
+void myalloc_pool_destroy(myalloc_pool_t *pool) {
+    free(pool->mem);
+    free(pool);
+}
+
+
+/*!
+ * The single-pool interface.  These work against the default pool of
+ * MEMORY_SIZE bytes, which init_myalloc() must create before myalloc() or
+ * myfree() will work at all.
+ */
+void init_myalloc() {
+    default_pool = myalloc_pool_create(MEMORY_SIZE);
+}
+
+unsigned char *myalloc(int size) {
+    return myalloc_pool_alloc(default_pool, size);
+}
+
+void myfree(unsigned char *oldptr) {
+    myalloc_pool_free(default_pool, oldptr);
+}
+
+unsigned char *myrealloc(unsigned char *oldptr, int size) {
+    return myalloc_pool_realloc(default_pool, oldptr, size);
+}
+
 void close_myalloc() {
-    free(mem);
+    myalloc_pool_destroy(default_pool);
+    default_pool = NULL;
 }
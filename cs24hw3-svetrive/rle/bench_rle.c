@@ -0,0 +1,406 @@
+/*
+ * Benchmarks every encoder and decoder variant over a corpus of inputs:
+ * the bundled images, and synthetic inputs that stress different cases.
+ * For each input and variant it reports throughput in MB/s of decoded
+ * data, cycles per decoded byte, and the compression ratio of the format
+ * the variant writes or reads.
+ *
+ * Each measurement repeats the operation until at least the minimum time
+ * has passed, and reports the fastest repetition, which is the one least
+ * disturbed by the rest of the system.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <x86intrin.h>
+
+#include "rl_buffer.h"
+#include "rl_decode.h"
+#include "rl_encode.h"
+#include "rl_literal.h"
+#include "rl_stream.h"
+
+
+/* Bytes in each synthetic input. */
+#define SYNTHETIC_SIZE (4 * 1024 * 1024)
+
+/* The side of the synthetic bitmap, which is 8 bits per pixel. */
+#define BITMAP_SIDE 2048
+
+
+typedef struct input {
+    const char *name;
+    unsigned char *data;
+    int length;
+} input;
+
+
+/* What one variant needs:  the input, and its encodings in both formats. */
+typedef struct workload {
+    input *in;
+    unsigned char *original;    /* Encoded in the original format. */
+    uint64_t original_length;
+    unsigned char *literal;     /* Encoded in the literal-run format. */
+    uint64_t literal_length;
+    unsigned char *scratch;     /* Room for any encoding or decoding. */
+} workload;
+
+
+typedef struct variant {
+    const char *name;
+    int literal_format;
+    void (*run)(workload *w);
+    int supported;
+} variant;
+
+
+/* The output of everything being measured goes here, so none of it can be
+ * optimized away.
+ */
+volatile long sink_total;
+
+
+/* The variants.  Each runs one whole encode or decode of the input. */
+
+static void enc_scalar(workload *w) {
+    sink_total += rl_encode_scalar(w->in->data, w->in->length, w->scratch);
+}
+
+static void enc_sse2(workload *w) {
+    sink_total += rl_encode_sse2(w->in->data, w->in->length, w->scratch);
+}
+
+static void enc_avx2(workload *w) {
+    sink_total += rl_encode_avx2(w->in->data, w->in->length, w->scratch);
+}
+
+static void enc_literal_sse2(workload *w) {
+    sink_total += rl_encode_literal_sse2(w->in->data, w->in->length,
+                                         w->scratch);
+}
+
+static void enc_literal_avx2(workload *w) {
+    sink_total += rl_encode_literal_avx2(w->in->data, w->in->length,
+                                         w->scratch);
+}
+
+static void dec_with(workload *w, unsigned char * (*decode)(unsigned char *,
+                                                           int, int *)) {
+    int length;
+    unsigned char *output = decode(w->original, w->original_length, &length);
+    sink_total += length;
+    free(output);
+}
+
+static void dec_scalar(workload *w) {
+    dec_with(w, rl_decode_scalar);
+}
+
+static void dec_sse2(workload *w) {
+    dec_with(w, rl_decode_sse2);
+}
+
+static void dec_avx2(workload *w) {
+    dec_with(w, rl_decode_avx2);
+}
+
+static void dec_literal(workload *w) {
+    int length;
+    unsigned char *output = rl_decode_literal(w->literal, w->literal_length,
+                                              &length);
+    sink_total += length;
+    free(output);
+}
+
+static void dec_into(workload *w) {
+    sink_total += rl_decode_into(w->original, w->original_length, w->scratch,
+                                 w->in->length);
+}
+
+static void dec_literal_into(workload *w) {
+    sink_total += rl_decode_into(w->literal, w->literal_length, w->scratch,
+                                 w->in->length);
+}
+
+static int discard(void *ctx, const unsigned char *data, int length) {
+    sink_total += data[length - 1];
+    return 0;
+}
+
+static void dec_stream(workload *w) {
+    static rl_stream stream;
+    rl_stream_init(&stream, discard, NULL);
+    rl_stream_feed(&stream, w->original, w->original_length);
+    rl_stream_finish(&stream);
+}
+
+
+static variant variants[] = {
+    { "encode scalar", 0, enc_scalar, 1 },
+    { "encode sse2", 0, enc_sse2, 1 },
+    { "encode avx2", 0, enc_avx2, 0 },
+    { "encode literal sse2", 1, enc_literal_sse2, 1 },
+    { "encode literal avx2", 1, enc_literal_avx2, 0 },
+    { "decode scalar", 0, dec_scalar, 1 },
+    { "decode sse2", 0, dec_sse2, 1 },
+    { "decode avx2", 0, dec_avx2, 0 },
+    { "decode into", 0, dec_into, 1 },
+    { "decode stream", 0, dec_stream, 1 },
+    { "decode literal", 1, dec_literal, 1 },
+    { "decode literal into", 1, dec_literal_into, 1 },
+    { NULL, 0, NULL, 0 }
+};
+
+
+/* Corpus construction. */
+
+/* Reads a whole file, or returns NULL if it can't. */
+static unsigned char * read_file(const char *path, int *length) {
+    FILE *f = fopen(path, "rb");
+    unsigned char *data;
+
+    if (f == NULL)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    *length = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = malloc(*length + 1);
+    if (fread(data, 1, *length, f) != (size_t) *length) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    return data;
+}
+
+/* Runs of 64 to 4096 bytes:  what the encoder skims over. */
+static void make_runs(unsigned char *p, int n) {
+    int i = 0, run;
+
+    while (i < n) {
+        run = 64 + rand() % 4033;
+        if (run > n - i)
+            run = n - i;
+        memset(p + i, rand() % 256, run);
+        i += run;
+    }
+}
+
+/* No two neighbouring bytes alike:  one run per byte. */
+static void make_literals(unsigned char *p, int n) {
+    int i;
+
+    p[0] = rand() % 256;
+    for (i = 1; i < n; i++)
+        p[i] = p[i - 1] + 1 + rand() % 255;
+}
+
+/* Uniformly random bytes, with the occasional accidental short run. */
+static void make_random(unsigned char *p, int n) {
+    int i;
+
+    for (i = 0; i < n; i++)
+        p[i] = rand() % 256;
+}
+
+/* An 8-bit image of filled circles in a few grey levels, with a sprinkle
+ * of noise pixels, like a scanned black-and-white drawing.
+ */
+static void make_bitmap(unsigned char *p, int n) {
+    int x, y, c, cx, cy, r;
+    unsigned char shade;
+
+    memset(p, 255, n);
+    for (c = 0; c < 200; c++) {
+        cx = rand() % BITMAP_SIDE;
+        cy = rand() % BITMAP_SIDE;
+        r = 10 + rand() % 150;
+        shade = (rand() % 4) * 64;
+        for (y = cy - r; y <= cy + r; y++) {
+            for (x = cx - r; x <= cx + r; x++) {
+                if (x >= 0 && y >= 0 && x < BITMAP_SIDE && y < BITMAP_SIDE &&
+                    (x - cx) * (x - cx) + (y - cy) * (y - cy) <= r * r) {
+                    p[y * BITMAP_SIDE + x] = shade;
+                }
+            }
+        }
+    }
+    for (c = 0; c < n / 200; c++)
+        p[rand() % n] = rand() % 256;
+}
+
+
+/* Builds the corpus into "inputs", and returns how many there are. */
+static int make_corpus(input *inputs) {
+    static const struct {
+        const char *name;
+        void (*make)(unsigned char *, int);
+    } synthetic[] = {
+        { "all-runs", make_runs },
+        { "all-literals", make_literals },
+        { "random", make_random },
+        { "bitmap", make_bitmap },
+    };
+    unsigned char *rle;
+    int i, n = 0, rle_length;
+
+    inputs[n].data = read_file("bw_tux.bmp", &inputs[n].length);
+    if (inputs[n].data != NULL) {
+        inputs[n].name = "bw_tux.bmp";
+        n++;
+    }
+    else {
+        fprintf(stderr, "bw_tux.bmp not found; skipping it\n");
+    }
+
+    rle = read_file("bw_bird.rle", &rle_length);
+    if (rle != NULL) {
+        inputs[n].name = "bw_bird.bmp";
+        inputs[n].data = rl_decode(rle, rle_length, &inputs[n].length);
+        free(rle);
+        n++;
+    }
+    else {
+        fprintf(stderr, "bw_bird.rle not found; skipping it\n");
+    }
+
+    srand(24);
+    for (i = 0; i < 4; i++) {
+        inputs[n].name = synthetic[i].name;
+        inputs[n].length = (synthetic[i].make == make_bitmap) ?
+                           BITMAP_SIDE * BITMAP_SIDE : SYNTHETIC_SIZE;
+        inputs[n].data = malloc(inputs[n].length);
+        synthetic[i].make(inputs[n].data, inputs[n].length);
+        n++;
+    }
+
+    return n;
+}
+
+
+/* Measurement. */
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Runs one variant over one workload for at least "min_time" seconds, and
+ * stores the fastest repetition's time and TSC cycles.
+ */
+static void measure(variant *v, workload *w, double min_time,
+                    double *seconds, double *cycles) {
+    double start, end, begin = now();
+    unsigned long long c0, c1;
+
+    v->run(w);      /* Warm the caches and fault in the buffers. */
+
+    *seconds = 1e30;
+    *cycles = 1e30;
+    do {
+        start = now();
+        c0 = __rdtsc();
+        v->run(w);
+        c1 = __rdtsc();
+        end = now();
+
+        if (end - start < *seconds)
+            *seconds = end - start;
+        if (c1 - c0 < *cycles)
+            *cycles = c1 - c0;
+    } while (end - begin < min_time);
+}
+
+
+void usage(const char *program) {
+    printf("usage: %s [-f table|csv] [-t seconds]\n", program);
+    printf("\tBenchmarks the RLE encoders and decoders.  The bundled\n");
+    printf("\timages are read from the current directory.\n\n");
+    printf("\t-f sets the output format (default table)\n");
+    printf("\t-t sets the minimum time per measurement (default 0.2)\n\n");
+}
+
+
+int main(int argc, char *argv[]) {
+    input inputs[8];
+    workload w;
+    double min_time = 0.2, seconds, cycles, ratio;
+    int csv = 0, num_inputs, i, k, c;
+
+    while ((c = getopt(argc, argv, "f:t:h")) != -1) {
+        switch (c) {
+        case 'f':
+            if (strcmp(optarg, "csv") == 0) {
+                csv = 1;
+            }
+            else if (strcmp(optarg, "table") != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+
+        case 't':
+            min_time = atof(optarg);
+            break;
+
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    variants[2].supported = rl_has_avx2();
+    variants[4].supported = rl_has_avx2();
+    variants[7].supported = rl_has_avx2();
+
+    num_inputs = make_corpus(inputs);
+
+    if (csv)
+        printf("input,bytes,variant,format,mb_per_sec,cycles_per_byte,ratio\n");
+    else
+        printf("%-13s %-20s %10s %12s %7s\n",
+               "input", "variant", "MB/s", "cycles/byte", "ratio");
+
+    for (i = 0; i < num_inputs; i++) {
+        w.in = &inputs[i];
+        w.original = rl_encode(w.in->data, w.in->length, &w.original_length);
+        w.literal = rl_encode_literal(w.in->data, w.in->length,
+                                      &w.literal_length);
+        w.scratch = malloc(RL_ENCODE_BOUND(w.in->length) + 64);
+
+        for (k = 0; variants[k].name != NULL; k++) {
+            if (!variants[k].supported)
+                continue;
+
+            measure(&variants[k], &w, min_time, &seconds, &cycles);
+            ratio = (double) (variants[k].literal_format ?
+                              w.literal_length : w.original_length) /
+                    w.in->length;
+
+            if (csv) {
+                printf("%s,%d,%s,%s,%.1f,%.3f,%.4f\n", w.in->name,
+                       w.in->length, variants[k].name,
+                       variants[k].literal_format ? "literal" : "original",
+                       w.in->length / seconds / 1e6, cycles / w.in->length,
+                       ratio);
+            }
+            else {
+                printf("%-13s %-20s %10.1f %12.3f %7.4f\n", w.in->name,
+                       variants[k].name, w.in->length / seconds / 1e6,
+                       cycles / w.in->length, ratio);
+            }
+        }
+
+        free(w.original);
+        free(w.literal);
+        free(w.scratch);
+        free(w.in->data);
+    }
+
+    return 0;
+}
@@ -0,0 +1,285 @@
+/*
+ * Block-indexed RLE container.  See rl_block.h for the file layout.
+ *
+ * Every block but the last decodes to exactly block_size bytes, so the
+ * block holding a decoded offset is found by a division rather than a
+ * search of the index.  Decoding a block writes straight into the caller's
+ * output, so a whole file is decoded in parallel by giving each thread its
+ * own contiguous range of blocks, with no locking and no copying.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rl_block.h"
+#include "rl_buffer.h"
+#include "rl_encode.h"
+
+
+/* Decoded length of block i. */
+static uint64_t block_decoded_length(const rl_block_file *f, uint32_t i) {
+    uint64_t left = f->header->decoded_length - f->index[i].decoded_offset;
+    return (left < f->header->block_size) ? left : f->header->block_size;
+}
+
+
+/* Encoded length of block i. */
+static uint64_t block_encoded_length(const rl_block_file *f, uint32_t i) {
+    uint64_t end = (i + 1 < f->header->num_blocks) ?
+                   f->index[i + 1].encoded_offset : f->header->index_offset;
+    return end - f->index[i].encoded_offset;
+}
+
+
+/*
+ * Decodes all of block i into place in "output".  Returns 0, or -1 if the
+ * block doesn't decode to exactly its length.  Anything after the runs that
+ * fill the block must be zero-length runs, which is also what the padding
+ * before the index looks like.
+ */
+static int decode_block(const rl_block_file *f, uint32_t i,
+                        unsigned char *output) {
+    const unsigned char *in = f->data + f->index[i].encoded_offset;
+    uint64_t in_length = block_encoded_length(f, i);
+    uint64_t want = block_decoded_length(f, i);
+    uint64_t used;
+
+    if (in_length % 2 != 0 ||
+        rl_expand_pairs(in, in_length, 0, output + f->index[i].decoded_offset,
+                        want, &used) != want) {
+        return -1;
+    }
+
+    for (; used < in_length; used += 2) {
+        if (in[used] != 0)
+            return -1;
+    }
+    return 0;
+}
+
+
+uint64_t rl_block_encode_buffer(const unsigned char *input_data,
+                                uint64_t input_length, int block_size,
+                                unsigned char *output) {
+    rl_block_header *header = (rl_block_header *) output;
+    rl_block_entry *index;
+    uint64_t pos, in_pos;
+    uint32_t num_blocks, i;
+    int n;
+
+    num_blocks = (input_length + block_size - 1) / block_size;
+    index = malloc(num_blocks * sizeof(rl_block_entry) + 1);
+    if (index == NULL)
+        return 0;
+
+    pos = sizeof(rl_block_header);
+    for (i = 0, in_pos = 0; i < num_blocks; i++, in_pos += block_size) {
+        n = (input_length - in_pos < (uint64_t) block_size) ?
+            (int) (input_length - in_pos) : block_size;
+        index[i].encoded_offset = pos;
+        index[i].decoded_offset = in_pos;
+        pos += rl_encode_buffer(input_data + in_pos, n, output + pos);
+    }
+
+    /* Pad so that the index is aligned.  The padding reads as zero-length
+     * runs at the end of the last block.
+     */
+    while (pos % 8 != 0)
+        output[pos++] = 0;
+
+    memcpy(header->magic, RL_BLOCK_MAGIC, 4);
+    header->version = RL_BLOCK_VERSION;
+    header->block_size = block_size;
+    header->num_blocks = num_blocks;
+    header->decoded_length = input_length;
+    header->index_offset = pos;
+
+    memcpy(output + pos, index, num_blocks * sizeof(rl_block_entry));
+    pos += num_blocks * sizeof(rl_block_entry);
+    free(index);
+
+    return pos;
+}
+
+
+unsigned char * rl_block_encode(const unsigned char *input_data,
+                                uint64_t input_length, int block_size,
+                                uint64_t *output_length) {
+    unsigned char *output;
+
+    if (block_size <= 0)
+        return NULL;
+
+    output = malloc(RL_BLOCK_BOUND(input_length, block_size));
+    if (output == NULL)
+        return NULL;
+
+    *output_length = rl_block_encode_buffer(input_data, input_length,
+                                            block_size, output);
+    if (*output_length == 0) {
+        free(output);
+        return NULL;
+    }
+    return output;
+}
+
+
+int rl_block_is_container(const unsigned char *data, uint64_t length) {
+    return length >= sizeof(rl_block_header) &&
+           memcmp(data, RL_BLOCK_MAGIC, 4) == 0;
+}
+
+
+int rl_block_open(rl_block_file *f, const unsigned char *data,
+                  uint64_t length) {
+    const rl_block_header *header = (const rl_block_header *) data;
+    const rl_block_entry *index;
+    uint64_t expected_blocks, prev;
+    uint32_t i;
+
+    if (!rl_block_is_container(data, length) ||
+        header->version != RL_BLOCK_VERSION || header->block_size == 0) {
+        return -1;
+    }
+
+    expected_blocks = (header->decoded_length + header->block_size - 1) /
+                      header->block_size;
+    if (header->num_blocks != expected_blocks ||
+        header->index_offset % 8 != 0 ||
+        header->index_offset < sizeof(rl_block_header) ||
+        header->index_offset > length ||
+        (length - header->index_offset) / sizeof(rl_block_entry) <
+            header->num_blocks) {
+        return -1;
+    }
+
+    /* Blocks must follow each other in order, between the header and the
+     * index, and each must start where the block size says it does.
+     */
+    index = (const rl_block_entry *) (data + header->index_offset);
+    prev = sizeof(rl_block_header);
+    for (i = 0; i < header->num_blocks; i++) {
+        if ((i == 0 && index[i].encoded_offset != prev) ||
+            index[i].encoded_offset < prev ||
+            index[i].encoded_offset > header->index_offset ||
+            index[i].decoded_offset != (uint64_t) i * header->block_size) {
+            return -1;
+        }
+        prev = index[i].encoded_offset;
+    }
+
+    f->data = data;
+    f->length = length;
+    f->header = header;
+    f->index = index;
+    return 0;
+}
+
+
+/* The blocks one thread decodes. */
+typedef struct block_range {
+    const rl_block_file *f;
+    unsigned char *output;
+    uint32_t first, last;       /* Blocks first to last - 1. */
+    int status;
+} block_range;
+
+
+static void * decode_range(void *arg) {
+    block_range *r = (block_range *) arg;
+    uint32_t i;
+
+    r->status = 0;
+    for (i = r->first; i < r->last && r->status == 0; i++)
+        r->status = decode_block(r->f, i, r->output);
+    return NULL;
+}
+
+
+int rl_block_decode(const rl_block_file *f, unsigned char *output,
+                    int num_threads) {
+    uint32_t num_blocks = f->header->num_blocks;
+    pthread_t *threads;
+    block_range *ranges;
+    int *started;
+    int t, status = 0;
+
+    if (num_threads > (int) num_blocks)
+        num_threads = num_blocks;
+    if (num_threads <= 1) {
+        block_range all = { f, output, 0, num_blocks, 0 };
+        decode_range(&all);
+        return all.status;
+    }
+
+    threads = malloc(num_threads * sizeof(pthread_t));
+    ranges = malloc(num_threads * sizeof(block_range));
+    started = malloc(num_threads * sizeof(int));
+    if (threads == NULL || ranges == NULL || started == NULL) {
+        free(threads);
+        free(ranges);
+        free(started);
+        return rl_block_decode(f, output, 1);
+    }
+
+    /* Thread 0 is this one; a thread that can't be started has its blocks
+     * decoded here as well, once the others are under way.
+     */
+    for (t = 0; t < num_threads; t++) {
+        ranges[t].f = f;
+        ranges[t].output = output;
+        ranges[t].first = (uint64_t) num_blocks * t / num_threads;
+        ranges[t].last = (uint64_t) num_blocks * (t + 1) / num_threads;
+        started[t] = t > 0 &&
+            pthread_create(&threads[t], NULL, decode_range, &ranges[t]) == 0;
+    }
+
+    for (t = 0; t < num_threads; t++) {
+        if (!started[t])
+            decode_range(&ranges[t]);
+    }
+    for (t = 0; t < num_threads; t++) {
+        if (started[t])
+            pthread_join(threads[t], NULL);
+        if (ranges[t].status != 0)
+            status = -1;
+    }
+
+    free(threads);
+    free(ranges);
+    free(started);
+    return status;
+}
+
+
+int64_t rl_block_read(const rl_block_file *f, uint64_t offset,
+                      unsigned char *output, uint64_t length) {
+    uint64_t done = 0, skip, want, got, used;
+    uint32_t i;
+
+    if (offset >= f->header->decoded_length)
+        return 0;
+    if (length > f->header->decoded_length - offset)
+        length = f->header->decoded_length - offset;
+
+    i = offset / f->header->block_size;
+    skip = offset - f->index[i].decoded_offset;
+    while (done < length) {
+        want = block_decoded_length(f, i) - skip;
+        if (want > length - done)
+            want = length - done;
+
+        got = rl_expand_pairs(f->data + f->index[i].encoded_offset,
+                              block_encoded_length(f, i), skip, output + done,
+                              want, &used);
+        if (got != want)
+            return -1;
+
+        done += got;
+        skip = 0;
+        i++;
+    }
+
+    return done;
+}
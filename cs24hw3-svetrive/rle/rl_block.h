@@ -0,0 +1,108 @@
+/* A block-indexed container for run-length encoded data.
+ *
+ * The input is cut into blocks of a fixed decoded size (the last block may
+ * be shorter), and each block is run-length encoded on its own, so no run
+ * crosses a block boundary.  An index at the end of the file records where
+ * every block starts in the file and in the decoded data.  Blocks can then
+ * be decoded in any order:  by several threads at once, or just the blocks
+ * covering the range a reader wants.
+ *
+ * The layout, with every field stored little-endian:
+ *
+ *     rl_block_header
+ *     encoded block 0, encoded block 1, ...
+ *     rl_block_entry for block 0, for block 1, ...    (at index_offset)
+ *
+ * The index starts on an 8-byte boundary, so it can be read in place.
+ */
+
+#include <stdint.h>
+
+
+#define RL_BLOCK_MAGIC "RLEB"
+#define RL_BLOCK_VERSION 1
+
+/* The block size rlenc uses unless it is told otherwise. */
+#define RL_BLOCK_DEFAULT_SIZE (1024 * 1024)
+
+
+typedef struct rl_block_header {
+    char magic[4];              /* RL_BLOCK_MAGIC, not zero-terminated. */
+    uint32_t version;
+    uint32_t block_size;        /* Decoded bytes in every block but the last. */
+    uint32_t num_blocks;
+    uint64_t decoded_length;    /* Decoded bytes in the whole file. */
+    uint64_t index_offset;      /* Where the index starts in the file. */
+} rl_block_header;
+
+
+typedef struct rl_block_entry {
+    uint64_t encoded_offset;    /* Where the block starts in the file. */
+    uint64_t decoded_offset;    /* Where its data starts once decoded. */
+} rl_block_entry;
+
+
+/* An opened container.  The data stays owned by the caller. */
+typedef struct rl_block_file {
+    const unsigned char *data;
+    uint64_t length;
+    const rl_block_header *header;
+    const rl_block_entry *index;
+} rl_block_file;
+
+
+/* The most bytes encoding "length" bytes in blocks of "block_size" can
+ * produce:  the header, a pair per input byte, padding to align the index,
+ * and an index entry per block.
+ */
+#define RL_BLOCK_BOUND(length, block_size)                                  \
+    (sizeof(rl_block_header) + 2 * (uint64_t) (length) + 8 +                \
+     ((uint64_t) (length) / (block_size) + 1) * sizeof(rl_block_entry))
+
+
+/* Encode "input_length" bytes into a malloc'd container with blocks of
+ * "block_size" decoded bytes, storing its length in *output_length.
+ * Returns NULL if the block size isn't positive or memory runs out.
+ */
+unsigned char * rl_block_encode(const unsigned char *input_data,
+                                uint64_t input_length, int block_size,
+                                uint64_t *output_length);
+
+
+/* Encode into "output", which must have room for
+ * RL_BLOCK_BOUND(input_length, block_size) bytes, and return the number of
+ * bytes written, or 0 if memory for the index runs out.  "block_size" must
+ * be positive.
+ */
+uint64_t rl_block_encode_buffer(const unsigned char *input_data,
+                                uint64_t input_length, int block_size,
+                                unsigned char *output);
+
+
+/* Returns nonzero if "data" starts with a container header. */
+int rl_block_is_container(const unsigned char *data, uint64_t length);
+
+
+/* Check that "data" holds a well-formed container, and fill in *f so the
+ * other functions can read it.  Returns 0 on success, or -1 if the header
+ * or the index is damaged.
+ */
+int rl_block_open(rl_block_file *f, const unsigned char *data,
+                  uint64_t length);
+
+
+/* Decode the whole container into "output", which must have room for
+ * f->header->decoded_length bytes, using up to "num_threads" threads.
+ * Returns 0 on success, or -1 if a block is damaged.
+ */
+int rl_block_decode(const rl_block_file *f, unsigned char *output,
+                    int num_threads);
+
+
+/* Decode "length" bytes starting at decoded offset "offset" into "output",
+ * decoding only the blocks that cover them.  Returns the number of bytes
+ * decoded, which is less than "length" only if the range runs past the
+ * end of the data, or -1 if a block is damaged.
+ */
+int64_t rl_block_read(const rl_block_file *f, uint64_t offset,
+                      unsigned char *output, uint64_t length);
@@ -0,0 +1,99 @@
+/*
+ * Decoding into caller-provided memory.  See rl_buffer.h.
+ *
+ * Short runs are written as two 8-byte stores when there is room for them
+ * before the end of the output, which is much cheaper than a memset() call;
+ * nothing is ever written past the end of the output, so several threads
+ * can expand neighbouring pieces of the same buffer.
+ */
+
+#include <string.h>
+#include <emmintrin.h>
+
+#include "rl_buffer.h"
+#include "rl_literal.h"
+
+
+uint64_t rl_expand_pairs(const unsigned char *in, uint64_t in_length,
+                         uint64_t skip, unsigned char *out, uint64_t want,
+                         uint64_t *used) {
+    unsigned char *o = out, *end = out + want;
+    uint64_t pos = 0, n;
+
+    while (pos + 1 < in_length && o < end) {
+        n = in[pos];
+        pos += 2;
+
+        if (skip > 0) {
+            if (n <= skip) {
+                skip -= n;
+                continue;
+            }
+            n -= skip;
+            skip = 0;
+        }
+        if (n > (uint64_t) (end - o))
+            n = end - o;
+
+        if (n <= 16 && end - o >= 16) {
+            uint64_t word = in[pos - 1] * 0x0101010101010101ULL;
+            memcpy(o, &word, 8);
+            memcpy(o + 8, &word, 8);
+        }
+        else {
+            memset(o, in[pos - 1], n);
+        }
+        o += n;
+    }
+
+    *used = pos;
+    return o - out;
+}
+
+
+/*
+ * Adds up the counts of original-format pairs, 16 bytes at a time:  the
+ * values are masked off, and psadbw against zero sums the eight counts in
+ * each half of the register.
+ */
+static uint64_t sum_counts(const unsigned char *in, uint64_t in_length) {
+    __m128i mask = _mm_set1_epi16(0x00ff), zero = _mm_setzero_si128();
+    __m128i sums = _mm_setzero_si128();
+    uint64_t i, total;
+
+    for (i = 0; i + 16 <= in_length; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (in + i));
+        sums = _mm_add_epi64(sums, _mm_sad_epu8(_mm_and_si128(v, mask), zero));
+    }
+    total = (uint64_t) _mm_cvtsi128_si64(sums) +
+            (uint64_t) _mm_cvtsi128_si64(_mm_unpackhi_epi64(sums, sums));
+
+    for (; i + 1 < in_length; i += 2)
+        total += in[i];
+    return total;
+}
+
+
+int64_t rl_decoded_length(const unsigned char *input_data,
+                          uint64_t input_length) {
+    if (rl_is_literal_format(input_data, input_length))
+        return rl_literal_length(input_data, input_length);
+
+    if (input_length % 2 != 0)
+        return -1;
+    return sum_counts(input_data, input_length);
+}
+
+
+uint64_t rl_decode_into(const unsigned char *input_data,
+                        uint64_t input_length, unsigned char *output,
+                        uint64_t output_length) {
+    uint64_t used;
+
+    if (rl_is_literal_format(input_data, input_length)) {
+        return rl_decode_literal_into(input_data, input_length, output,
+                                      output_length);
+    }
+    return rl_expand_pairs(input_data, input_length, 0, output,
+                           output_length, &used);
+}
@@ -0,0 +1,32 @@
+/* Decoding into memory the caller provides, such as a mapped output file,
+ * instead of a buffer rl_decode() allocates.  Both the original format and
+ * the literal-run format are understood, told apart by the literal
+ * format's tag.
+ */
+
+#include <stdint.h>
+
+
+/* Returns how many bytes "input_data" decodes to, or -1 if it can't be
+ * decoded.  For the original format this is one fast pass over the counts;
+ * the literal format stores it in its header.
+ */
+int64_t rl_decoded_length(const unsigned char *input_data,
+                          uint64_t input_length);
+
+
+/* Decode into "output", writing at most "output_length" bytes.  Returns
+ * the number of bytes written.
+ */
+uint64_t rl_decode_into(const unsigned char *input_data,
+                        uint64_t input_length, unsigned char *output,
+                        uint64_t output_length);
+
+
+/* Expand original-format pairs, leaving out the first "skip" decoded bytes
+ * and stopping once "want" bytes have been written.  Returns the number of
+ * bytes written, and stores how much input was used in *used.
+ */
+uint64_t rl_expand_pairs(const unsigned char *in, uint64_t in_length,
+                         uint64_t skip, unsigned char *out, uint64_t want,
+                         uint64_t *used);
@@ -1,3 +1,14 @@
 unsigned char * rl_decode(unsigned char *input_data, int input_length,
                           int *output_length);
 
+/* The individual variants rl_decode() chooses between at startup.  The
+ * AVX2 variant may only be called if rl_has_avx2() returns nonzero.
+ */
+unsigned char * rl_decode_scalar(unsigned char *input_data, int input_length,
+                                 int *output_length);
+unsigned char * rl_decode_sse2(unsigned char *input_data, int input_length,
+                               int *output_length);
+unsigned char * rl_decode_avx2(unsigned char *input_data, int input_length,
+                               int *output_length);
+
+int rl_has_avx2(void);
@@ -1,8 +1,103 @@
 .globl rl_decode
+.globl rl_decode_scalar
+.globl rl_has_avx2
+
 
 #============================================================================
 # rl_decode:  decode RLE-encoded input into a malloc'd buffer
 #
+# This is just a jump through rl_decode_impl, which points at the fastest
+# variant this CPU supports.  It starts out at the SSE2 variant, since every
+# x86-64 processor has SSE2, and rl_decode_init switches it to the AVX2
+# variant at program startup if the CPU and OS both support AVX2.  All of
+# the variants take the same arguments, and return a buffer that the caller
+# must free().
+#
+# Input in the literal-run format (see rl_literal.h) starts with a tag that
+# the original format never does; it is passed to rl_decode_literal.
+#
+        .data
+        .align  8
+rl_decode_impl:
+        .quad   rl_decode_sse2
+
+        # Have the C runtime call rl_decode_init before main().
+        .section .init_array, "aw"
+        .align  8
+        .quad   rl_decode_init
+
+        .text
+rl_decode:
+        cmp     $4, %esi                 # Long enough to have the tag?
+        jl      decode_original
+        cmpl    $0x324c5200, (%rdi)      # "\0RL2", little-endian
+        jne     decode_original
+        jmp     rl_decode_literal
+
+decode_original:
+        jmp     *rl_decode_impl(%rip)
+
+
+rl_decode_init:
+        call    rl_has_avx2
+        test    %eax, %eax
+        jz      init_done
+
+        lea     rl_decode_avx2(%rip), %rax
+        mov     %rax, rl_decode_impl(%rip)
+
+init_done:
+        ret
+
+
+#============================================================================
+# rl_has_avx2:  returns nonzero if AVX2 instructions can be used
+#
+# The CPU has to report AVX2 in CPUID leaf 7, and the OS also has to save
+# and restore the YMM registers on context switches.  It does that when the
+# CPU reports OSXSAVE and AVX in leaf 1, and XCR0 has the XMM and YMM state
+# bits set.
+#
+rl_has_avx2:
+        push    %rbx                     # cpuid clobbers rbx
+        xor     %r8d, %r8d               # %r8d = result, until proven otherwise
+
+        xor     %eax, %eax               # Leaf 7 has to exist
+        cpuid
+        cmp     $7, %eax
+        jb      avx2_done
+
+        mov     $1, %eax                 # OSXSAVE (bit 27), AVX (bit 28)
+        cpuid
+        and     $0x18000000, %ecx
+        cmp     $0x18000000, %ecx
+        jne     avx2_done
+
+        xor     %ecx, %ecx               # XCR0 bits 1 and 2:  XMM and YMM
+        xgetbv
+        and     $6, %eax
+        cmp     $6, %eax
+        jne     avx2_done
+
+        mov     $7, %eax                 # AVX2 is leaf 7, %ebx bit 5
+        xor     %ecx, %ecx
+        cpuid
+        bt      $5, %ebx
+        jnc     avx2_done
+
+        mov     $1, %r8d
+
+avx2_done:
+        mov     %r8d, %eax
+        pop     %rbx
+        ret
+
+
+#============================================================================
+# rl_decode_scalar:  decode RLE-encoded input into a malloc'd buffer
+#
+# The original decoder, one byte at a time.
+#
 # Author:  Ben Bitdiddle (those guys are lucky I said I'd do this before
 #          going on my vacation.  they never appreciate my work ethic!)
 #
@@ -19,7 +114,7 @@
 # Return-value in %rax is the pointer to the malloc'd buffer containing
 # the decoded data.
 #
-rl_decode:
+rl_decode_scalar:
         # No need for a frame pointer - we don't need a stack frame.
 
         # Save rbx since it is callee-save, and we definitely use it a lot.
@@ -93,3 +188,7 @@ decode_done:
 
         # No stack frame to clean up.
         ret
+
+
+# The stack doesn't need to be executable.
+.section .note.GNU-stack, "", @progbits
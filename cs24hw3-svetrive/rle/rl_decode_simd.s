@@ -0,0 +1,229 @@
+.globl rl_decode_sse2
+.globl rl_decode_avx2
+
+#============================================================================
+# rl_decode_sse2, rl_decode_avx2:  decode RLE-encoded input into a malloc'd
+# buffer, using 16-byte and 32-byte vector registers respectively
+#
+# These take the same arguments and return the same thing as rl_decode (see
+# rl_decode.s), and they work the same way:  sum up the counts to find out
+# how much to allocate, then expand each run into the buffer.  Both passes
+# are vectorized.
+#
+# Summing:  the counts are the even bytes of the input.  Each block of input
+# is ANDed with a mask that zeroes the odd (value) bytes, and then psadbw
+# against zero adds up each group of 8 bytes into a 64-bit lane, which is a
+# horizontal add of 8 counts in one instruction.  The lanes are added up at
+# the end, and any input left over after the last full block is summed one
+# count at a time as before.
+#
+# Expanding:  the value of each run is broadcast into every byte of a vector
+# register, and the register is stored over and over until the run is
+# covered.  The last store of a run can go up to 31 bytes past its end, but
+# the next run overwrites that, and the buffer is allocated 32 bytes longer
+# than the decoded data so the last run has room too.
+#
+# Register usage (both variants):
+#      %r12 = input pointer          %r13 = input length (sign-extended)
+#      %r14 = output-length pointer  %rbx = decoded size
+#      %rcx = index into the input   %r10 = output write pointer
+#
+# A zero count adds no bytes to the output here:  its one store lands where
+# the next run, or the slack, will be.  rl_decode_scalar instead wraps the
+# count around and writes 256 bytes, past what it allocated.  In all of the
+# variants, an odd input length means the final count's value byte is read
+# from just past the input.
+#
+
+# Extra bytes allocated after the decoded data, for the overhanging stores.
+SLACK = 32
+
+
+rl_decode_sse2:
+        push    %rbx
+        push    %r12
+        push    %r13
+        push    %r14
+
+        mov     %rdi, %r12
+        movslq  %esi, %r13
+        mov     %rdx, %r14
+
+        # Sum the counts, 16 input bytes (8 counts) at a time.
+        pxor    %xmm1, %xmm1             # %xmm1 = two 64-bit partial sums
+        pxor    %xmm3, %xmm3             # %xmm3 = zero, for psadbw
+        mov     $0x00ff00ff, %eax        # %xmm2 = mask of the count bytes
+        movd    %eax, %xmm2
+        pshufd  $0, %xmm2, %xmm2
+
+        xor     %ecx, %ecx
+        lea     -16(%r13), %r9           # last index a full block starts at
+        jmp     sse2_sum_test
+
+sse2_sum_loop:
+        movdqu  (%r12, %rcx), %xmm0
+        pand    %xmm2, %xmm0
+        psadbw  %xmm3, %xmm0
+        paddq   %xmm0, %xmm1
+        add     $16, %rcx
+
+sse2_sum_test:
+        cmp     %r9, %rcx
+        jle     sse2_sum_loop
+
+        pshufd  $0x4e, %xmm1, %xmm0      # add the high lane to the low one
+        paddq   %xmm0, %xmm1
+        movq    %xmm1, %rbx
+
+        jmp     sse2_tail_test           # sum the leftover counts
+
+sse2_tail_loop:
+        movzbl  (%r12, %rcx), %eax
+        add     %rax, %rbx
+        add     $2, %rcx
+
+sse2_tail_test:
+        cmp     %r13, %rcx
+        jl      sse2_tail_loop
+
+        # Allocate the output, plus room for the last run's overhang.  Four
+        # pushes leave the stack 8 bytes off a 16-byte boundary.
+        lea     SLACK(%rbx), %rdi
+        sub     $8, %rsp
+        call    malloc
+        add     $8, %rsp
+
+        mov     %ebx, (%r14)
+        test    %rax, %rax
+        jz      sse2_done
+
+        # Expand each run with 16-byte stores.
+        xor     %ecx, %ecx
+        mov     %rax, %r10
+        movabs  $0x0101010101010101, %r11
+        jmp     sse2_decode_test
+
+sse2_decode_loop:
+        movzbl  (%r12, %rcx), %edx       # %rdx = count
+        movzbl  1(%r12, %rcx), %esi      # %rsi = value, copied into all
+        imul    %r11, %rsi               #        8 bytes, then into all 16
+        movq    %rsi, %xmm0
+        punpcklqdq %xmm0, %xmm0
+        lea     (%r10, %rdx), %r9        # %r9 = end of this run
+
+sse2_store_loop:
+        movdqu  %xmm0, (%r10)
+        add     $16, %r10
+        cmp     %r9, %r10
+        jb      sse2_store_loop
+
+        mov     %r9, %r10
+        add     $2, %rcx
+
+sse2_decode_test:
+        cmp     %r13, %rcx
+        jl      sse2_decode_loop
+
+sse2_done:
+        pop     %r14
+        pop     %r13
+        pop     %r12
+        pop     %rbx
+        ret
+
+
+rl_decode_avx2:
+        push    %rbx
+        push    %r12
+        push    %r13
+        push    %r14
+
+        mov     %rdi, %r12
+        movslq  %esi, %r13
+        mov     %rdx, %r14
+
+        # Sum the counts, 32 input bytes (16 counts) at a time.
+        vpxor   %ymm1, %ymm1, %ymm1      # %ymm1 = four 64-bit partial sums
+        vpxor   %ymm3, %ymm3, %ymm3      # %ymm3 = zero, for vpsadbw
+        mov     $0x00ff, %eax            # %ymm2 = mask of the count bytes
+        vmovd   %eax, %xmm2
+        vpbroadcastw %xmm2, %ymm2
+
+        xor     %ecx, %ecx
+        lea     -32(%r13), %r9           # last index a full block starts at
+        jmp     avx2_sum_test
+
+avx2_sum_loop:
+        vpand   (%r12, %rcx), %ymm2, %ymm0
+        vpsadbw %ymm3, %ymm0, %ymm0
+        vpaddq  %ymm0, %ymm1, %ymm1
+        add     $32, %rcx
+
+avx2_sum_test:
+        cmp     %r9, %rcx
+        jle     avx2_sum_loop
+
+        vextracti128 $1, %ymm1, %xmm0    # add the four lanes together
+        vpaddq  %xmm0, %xmm1, %xmm1
+        vpshufd $0x4e, %xmm1, %xmm0
+        vpaddq  %xmm0, %xmm1, %xmm1
+        vmovq   %xmm1, %rbx
+
+        jmp     avx2_tail_test           # sum the leftover counts
+
+avx2_tail_loop:
+        movzbl  (%r12, %rcx), %eax
+        add     %rax, %rbx
+        add     $2, %rcx
+
+avx2_tail_test:
+        cmp     %r13, %rcx
+        jl      avx2_tail_loop
+
+        # Avoid the AVX-to-SSE transition penalty in malloc().
+        vzeroupper
+
+        lea     SLACK(%rbx), %rdi
+        sub     $8, %rsp
+        call    malloc
+        add     $8, %rsp
+
+        mov     %ebx, (%r14)
+        test    %rax, %rax
+        jz      avx2_done
+
+        # Expand each run with 32-byte stores.
+        xor     %ecx, %ecx
+        mov     %rax, %r10
+        jmp     avx2_decode_test
+
+avx2_decode_loop:
+        movzbl  (%r12, %rcx), %edx       # %rdx = count
+        vpbroadcastb 1(%r12, %rcx), %ymm0  # value, in all 32 bytes
+        lea     (%r10, %rdx), %r9        # %r9 = end of this run
+
+avx2_store_loop:
+        vmovdqu %ymm0, (%r10)
+        add     $32, %r10
+        cmp     %r9, %r10
+        jb      avx2_store_loop
+
+        mov     %r9, %r10
+        add     $2, %rcx
+
+avx2_decode_test:
+        cmp     %r13, %rcx
+        jl      avx2_decode_loop
+
+        vzeroupper
+
+avx2_done:
+        pop     %r14
+        pop     %r13
+        pop     %r12
+        pop     %rbx
+        ret
+
+
+# The stack doesn't need to be executable.
+.section .note.GNU-stack, "", @progbits
@@ -0,0 +1,400 @@
+/*
+ * Run-length encoder core.  The output is a sequence of [count][value] byte
+ * pairs, exactly what rlenc has always written:  every run of equal bytes
+ * becomes one pair, except that a run longer than 255 bytes is split into
+ * pairs of 255 followed by the remainder.
+ *
+ * The vector variants find run boundaries 64 bytes at a time.  Each block is
+ * compared against the same block shifted by one byte, and the movemask of
+ * the inequality gives a 64-bit mask with bit k set when byte k ends a run.
+ * Walking the set bits with ctz then produces the runs in order, so a block
+ * full of short runs costs one step per run, and a block in the middle of a
+ * long run costs a single test of a zero mask.
+ *
+ * The same loop also writes the literal-run format described in
+ * rl_literal.h, where short runs are gathered up into literals instead.
+ *
+ * Walking the bits costs several instructions a run, which on data with
+ * hardly any runs (random bytes, or anything already compressed) made the
+ * vector variants about half as fast as the plain byte loop.  So the two
+ * densest kinds of block skip the walk.  In the original format, a block
+ * where every byte is a run of its own is written as 64 pairs of count 1
+ * by interleaving it with ones.  In the literal format, a block with no
+ * run of three or more inside it only has to end the run it started in and
+ * note where its last run starts, since everything between them goes into
+ * the literal anyway.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <immintrin.h>
+
+#include "rl_decode.h"
+#include "rl_encode.h"
+#include "rl_literal.h"
+
+
+/* Appends the pairs for a run of "length" copies of "value". */
+static inline unsigned char * emit_run(unsigned char *out, uint64_t length,
+                                       unsigned char value) {
+    while (length > 255) {
+        out[0] = 255;
+        out[1] = value;
+        out += 2;
+        length -= 255;
+    }
+    out[0] = (unsigned char) length;
+    out[1] = value;
+    return out + 2;
+}
+
+
+/* Run boundaries in the 64 bytes at p:  bit k is set if p[k] != p[k + 1]. */
+
+static inline uint64_t boundaries_sse2(const unsigned char *p) {
+    uint64_t mask = 0;
+    int k;
+
+    for (k = 0; k < 4; k++) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (p + 16 * k));
+        __m128i b = _mm_loadu_si128((const __m128i *) (p + 16 * k + 1));
+        uint64_t eq = (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(a, b));
+        mask |= (eq ^ 0xffff) << (16 * k);
+    }
+    return mask;
+}
+
+__attribute__((target("avx2")))
+static inline uint64_t boundaries_avx2(const unsigned char *p) {
+    __m256i a0 = _mm256_loadu_si256((const __m256i *) p);
+    __m256i b0 = _mm256_loadu_si256((const __m256i *) (p + 1));
+    __m256i a1 = _mm256_loadu_si256((const __m256i *) (p + 32));
+    __m256i b1 = _mm256_loadu_si256((const __m256i *) (p + 33));
+    uint64_t eq0, eq1;
+
+    eq0 = (unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(a0, b0));
+    eq1 = (unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(a1, b1));
+    return ~(eq0 | (eq1 << 32));
+}
+
+
+/* Appends a pair of count 1 for each of the 64 bytes at p. */
+static inline unsigned char * emit_singles(unsigned char *out,
+                                           const unsigned char *p) {
+    __m128i ones = _mm_set1_epi8(1);
+    int k;
+
+    for (k = 0; k < 4; k++) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (p + 16 * k));
+        _mm_storeu_si128((__m128i *) (out + 32 * k),
+                         _mm_unpacklo_epi8(ones, a));
+        _mm_storeu_si128((__m128i *) (out + 32 * k + 16),
+                         _mm_unpackhi_epi8(ones, a));
+    }
+    return out + 128;
+}
+
+
+/* Appends "value" as a varint. */
+static inline unsigned char * emit_varint(unsigned char *out, uint64_t value) {
+    while (value >= 0x80) {
+        *out++ = (unsigned char) (value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (unsigned char) value;
+    return out;
+}
+
+
+/* Where a vector encoder loop is up to. */
+typedef struct encoder {
+    const unsigned char *in;
+    unsigned char *out;
+    uint64_t literal_start; /* Literal format:  the first byte not written. */
+} encoder;
+
+
+/* Writes the bytes from e->literal_start up to "end" as a literal token. */
+static inline void flush_literal(encoder *e, uint64_t end) {
+    uint64_t length = end - e->literal_start;
+
+    if (length > 0) {
+        e->out = emit_varint(e->out, ((length - 1) << 1) | 1);
+        memcpy(e->out, e->in + e->literal_start, length);
+        e->out += length;
+    }
+}
+
+
+/*
+ * Handles one run found by the loop.  In the original format every run is
+ * written as it is found.  In the literal format, short runs are left to
+ * collect into a literal, which is only written once a long enough run
+ * comes along, or the input ends.
+ */
+static inline __attribute__((always_inline))
+void put_run(encoder *e, uint64_t start, uint64_t length,
+             int literal_format) {
+    if (!literal_format) {
+        e->out = emit_run(e->out, length, e->in[start]);
+        return;
+    }
+
+    if (length < RL_LITERAL_MIN_RUN)
+        return;
+
+    flush_literal(e, start);
+    e->out = emit_varint(e->out, (length - 1) << 1);
+    *e->out++ = e->in[start];
+    e->literal_start = start + length;
+}
+
+
+/*
+ * The encoder loop shared by the vector variants.  It is always inlined, so
+ * each variant gets its own copy with its boundary function inlined too,
+ * and with the format fixed.  Blocks are only used while the byte after
+ * the block is still in the input; the last few bytes are handled one at a
+ * time.
+ */
+static inline __attribute__((always_inline))
+uint64_t encode_blocks(const unsigned char *in, uint64_t n,
+                       unsigned char *output,
+                       uint64_t (*boundaries)(const unsigned char *),
+                       int literal_format) {
+    encoder e = { in, output, 0 };
+    uint64_t run_start = 0;
+    uint64_t i = 0;
+    uint64_t mask;
+
+    if (n == 0)
+        return 0;
+
+    for (; i + 64 < n; i += 64) {
+        mask = boundaries(in + i);
+
+        if (!literal_format && mask == ~0ULL && run_start == i) {
+            e.out = emit_singles(e.out, in + i);
+            run_start = i + 64;
+            continue;
+        }
+
+        // bit k of ~mask & (~mask >> 1) means p[k] == p[k + 1] == p[k + 2]
+        if (literal_format && (~mask & (~mask >> 1)) == 0) {
+            uint64_t end = i + __builtin_ctzll(mask) + 1;
+            put_run(&e, run_start, end - run_start, literal_format);
+            run_start = i + 64 - __builtin_clzll(mask);
+            continue;
+        }
+
+        while (mask != 0) {
+            uint64_t end = i + __builtin_ctzll(mask) + 1;
+            put_run(&e, run_start, end - run_start, literal_format);
+            run_start = end;
+            mask &= mask - 1;
+        }
+    }
+
+    for (; i + 1 < n; i++) {
+        if (in[i] != in[i + 1]) {
+            put_run(&e, run_start, i + 1 - run_start, literal_format);
+            run_start = i + 1;
+        }
+    }
+
+    put_run(&e, run_start, n - run_start, literal_format);
+    if (literal_format)
+        flush_literal(&e, n);
+    return e.out - output;
+}
+
+
+uint64_t rl_encode_sse2(const unsigned char *input_data,
+                        uint64_t input_length, unsigned char *output) {
+    return encode_blocks(input_data, input_length, output, boundaries_sse2, 0);
+}
+
+__attribute__((target("avx2")))
+uint64_t rl_encode_avx2(const unsigned char *input_data,
+                        uint64_t input_length, unsigned char *output) {
+    return encode_blocks(input_data, input_length, output, boundaries_avx2, 0);
+}
+
+
+/* Writes the literal format's tag and decoded length. */
+static unsigned char * literal_header(unsigned char *out,
+                                      uint64_t input_length) {
+    memcpy(out, RL_LITERAL_TAG, RL_LITERAL_TAG_LENGTH);
+    return emit_varint(out + RL_LITERAL_TAG_LENGTH, input_length);
+}
+
+uint64_t rl_encode_literal_sse2(const unsigned char *input_data,
+                                uint64_t input_length, unsigned char *output) {
+    unsigned char *out = literal_header(output, input_length);
+    return (out - output) +
+        encode_blocks(input_data, input_length, out, boundaries_sse2, 1);
+}
+
+__attribute__((target("avx2")))
+uint64_t rl_encode_literal_avx2(const unsigned char *input_data,
+                                uint64_t input_length, unsigned char *output) {
+    unsigned char *out = literal_header(output, input_length);
+    return (out - output) +
+        encode_blocks(input_data, input_length, out, boundaries_avx2, 1);
+}
+
+
+/* The byte-at-a-time loop rlenc used to run over stdio, kept for reference. */
+uint64_t rl_encode_scalar(const unsigned char *input_data,
+                          uint64_t input_length, unsigned char *output) {
+    unsigned char *out = output;
+    uint64_t i;
+    int lastch, count;
+
+    if (input_length == 0)
+        return 0;
+
+    lastch = input_data[0];
+    count = 1;
+    for (i = 1; i < input_length; i++) {
+        if (input_data[i] != lastch || count == 255) {
+            *out++ = count;
+            *out++ = lastch;
+            lastch = input_data[i];
+            count = 1;
+        }
+        else {
+            count++;
+        }
+    }
+    *out++ = count;
+    *out++ = lastch;
+
+    return out - output;
+}
+
+
+/* The variants rl_encode_buffer() and rl_encode_literal_buffer() use,
+ * chosen before main() runs.
+ */
+static uint64_t (*encode_impl)(const unsigned char *, uint64_t,
+                               unsigned char *) = rl_encode_sse2;
+static uint64_t (*encode_literal_impl)(const unsigned char *, uint64_t,
+                                       unsigned char *) =
+    rl_encode_literal_sse2;
+
+__attribute__((constructor))
+static void rl_encode_init(void) {
+    if (rl_has_avx2()) {
+        encode_impl = rl_encode_avx2;
+        encode_literal_impl = rl_encode_literal_avx2;
+    }
+}
+
+
+uint64_t rl_encode_buffer(const unsigned char *input_data,
+                          uint64_t input_length, unsigned char *output) {
+    return encode_impl(input_data, input_length, output);
+}
+
+
+unsigned char * rl_encode(unsigned char *input_data, uint64_t input_length,
+                          uint64_t *output_length) {
+    unsigned char *output = malloc(RL_ENCODE_BOUND(input_length));
+
+    if (output == NULL && input_length > 0)
+        return NULL;
+
+    *output_length = rl_encode_buffer(input_data, input_length, output);
+    return output;
+}
+
+
+uint64_t rl_encode_literal_buffer(const unsigned char *input_data,
+                                  uint64_t input_length,
+                                  unsigned char *output) {
+    return encode_literal_impl(input_data, input_length, output);
+}
+
+
+unsigned char * rl_encode_literal(unsigned char *input_data,
+                                  uint64_t input_length,
+                                  uint64_t *output_length) {
+    unsigned char *output = malloc(RL_LITERAL_BOUND(input_length));
+
+    if (output == NULL)
+        return NULL;
+
+    *output_length = rl_encode_literal_buffer(input_data, input_length,
+                                              output);
+    return output;
+}
+
+
+/*
+ * The streaming encoder.  Only the run still open at the end of a chunk is
+ * carried over:  the next chunk first extends it, and everything between
+ * the byte that ends it and the chunk's own last run is encoded in one go
+ * by rl_encode_buffer().  Pairs of 255 are written as soon as the open run
+ * fills them, which is where the whole-input encoder splits a long run too,
+ * so the count carried over always fits in one pair.
+ */
+
+void rl_encoder_init(rl_encoder *e) {
+    e->value = 0;
+    e->count = 0;
+}
+
+
+/* Makes the last "length" bytes seen the open run, after writing whole
+ * pairs for all but the last 255 or fewer of them.
+ */
+static unsigned char * hold_run(rl_encoder *e, unsigned char *out,
+                                uint64_t length) {
+    while (length > 255) {
+        out[0] = 255;
+        out[1] = e->value;
+        out += 2;
+        length -= 255;
+    }
+    e->count = (int) length;
+    return out;
+}
+
+
+uint64_t rl_encoder_feed(rl_encoder *e, const unsigned char *input_data,
+                         uint64_t length, unsigned char *output) {
+    unsigned char *out = output;
+    uint64_t start = 0, tail;
+
+    if (length == 0)
+        return 0;
+
+    if (e->count > 0) {
+        while (start < length && input_data[start] == e->value)
+            start++;
+        if (start == length)
+            return hold_run(e, out, e->count + length) - output;
+        out = emit_run(out, e->count + start, e->value);
+    }
+
+    tail = length - 1;
+    while (tail > start && input_data[tail - 1] == input_data[length - 1])
+        tail--;
+
+    out += rl_encode_buffer(input_data + start, tail - start, out);
+    e->value = input_data[length - 1];
+    return hold_run(e, out, length - tail) - output;
+}
+
+
+uint64_t rl_encoder_finish(rl_encoder *e, unsigned char *output) {
+    if (e->count == 0)
+        return 0;
+
+    output[0] = (unsigned char) e->count;
+    output[1] = e->value;
+    e->count = 0;
+    return 2;
+}
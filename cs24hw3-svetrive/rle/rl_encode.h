@@ -0,0 +1,72 @@
+#include <stdint.h>
+
+
+/* The most bytes encoding "input_length" bytes can produce:  a pair per byte. */
+#define RL_ENCODE_BOUND(input_length) (2 * (uint64_t) (input_length))
+
+
+/* Encode "input_length" bytes into a malloc'd buffer, storing its length in
+ * *output_length.  The output can be decoded by rl_decode().
+ */
+unsigned char * rl_encode(unsigned char *input_data, uint64_t input_length,
+                          uint64_t *output_length);
+
+
+/* Encode "input_length" bytes into "output", which must have room for
+ * RL_ENCODE_BOUND(input_length) bytes, and return the number of bytes
+ * written.
+ */
+uint64_t rl_encode_buffer(const unsigned char *input_data,
+                          uint64_t input_length, unsigned char *output);
+
+
+/* The individual variants rl_encode_buffer() chooses between at startup.
+ * The AVX2 variant may only be called if rl_has_avx2() returns nonzero.
+ */
+uint64_t rl_encode_scalar(const unsigned char *input_data,
+                          uint64_t input_length, unsigned char *output);
+uint64_t rl_encode_sse2(const unsigned char *input_data,
+                        uint64_t input_length, unsigned char *output);
+uint64_t rl_encode_avx2(const unsigned char *input_data,
+                        uint64_t input_length, unsigned char *output);
+
+
+/* A streaming encoder for the original format, for inputs too big to hold
+ * in memory.  The input is fed in chunks of any size, and the run still
+ * open at the end of one chunk is carried into the next, so the output is
+ * exactly what rl_encode_buffer() writes for the whole input at once.
+ *
+ *     rl_encoder e;
+ *     rl_encoder_init(&e);
+ *     while (...more input...)
+ *         write rl_encoder_feed(&e, chunk, chunk_length, output) bytes
+ *     write rl_encoder_finish(&e, output) bytes
+ */
+typedef struct rl_encoder {
+    unsigned char value;        /* The byte the open run repeats. */
+    int count;                  /* Its length so far, 0 to 255. */
+} rl_encoder;
+
+
+/* The most bytes one call to rl_encoder_feed() can write for a chunk of
+ * "chunk_length" bytes, or rl_encoder_finish() can write for length 0.
+ */
+#define RL_ENCODER_BOUND(chunk_length) (RL_ENCODE_BOUND(chunk_length) + 2)
+
+
+/* Start encoding a new stream. */
+void rl_encoder_init(rl_encoder *e);
+
+
+/* Encode the next "length" bytes of input into "output", which must have
+ * room for RL_ENCODER_BOUND(length) bytes, and return the number of bytes
+ * written.
+ */
+uint64_t rl_encoder_feed(rl_encoder *e, const unsigned char *input_data,
+                         uint64_t length, unsigned char *output);
+
+
+/* Write the pair for the run still open into "output", and return the
+ * number of bytes written.
+ */
+uint64_t rl_encoder_finish(rl_encoder *e, unsigned char *output);
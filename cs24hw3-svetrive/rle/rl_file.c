@@ -0,0 +1,129 @@
+/*
+ * Memory-mapped files for rlenc and rldec.  See rl_file.h.
+ *
+ * An empty file can't be mapped, so it gets a NULL mapping of length zero;
+ * nothing reads or writes through it.
+ *
+ * A stream is read into a buffer that doubles whenever it fills up, since
+ * a pipe's length isn't known until it ends.
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "rl_file.h"
+
+
+int rl_map_input(rl_map *m, const char *path) {
+    struct stat st;
+
+    m->data = NULL;
+    m->length = 0;
+    m->fd = open(path, O_RDONLY);
+    if (m->fd < 0)
+        return RL_MAP_NO_FILE;
+
+    if (fstat(m->fd, &st) != 0 || !S_ISREG(st.st_mode))
+        return RL_MAP_NO_MAP;
+
+    m->length = st.st_size;
+    if (m->length > 0) {
+        m->data = mmap(NULL, m->length, PROT_READ, MAP_SHARED, m->fd, 0);
+        if (m->data == MAP_FAILED) {
+            m->data = NULL;
+            m->length = 0;
+            return RL_MAP_NO_MAP;
+        }
+        madvise(m->data, m->length, MADV_SEQUENTIAL);
+    }
+
+    return RL_MAP_OK;
+}
+
+
+int rl_map_output(rl_map *m, const char *path, uint64_t length) {
+    struct stat st;
+
+    m->data = NULL;
+    m->length = length;
+    m->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (m->fd < 0)
+        return RL_MAP_NO_FILE;
+
+    if (fstat(m->fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+        ftruncate(m->fd, length) != 0) {
+        close(m->fd);
+        return RL_MAP_NO_MAP;
+    }
+
+    if (length > 0) {
+        m->data = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED,
+                       m->fd, 0);
+        if (m->data == MAP_FAILED) {
+            close(m->fd);
+            return RL_MAP_NO_MAP;
+        }
+        madvise(m->data, length, MADV_SEQUENTIAL);
+    }
+
+    return RL_MAP_OK;
+}
+
+
+int rl_unmap(rl_map *m, int64_t final_length) {
+    int status = 0;
+
+    if (m->data != NULL)
+        munmap(m->data, m->length);
+    if (final_length >= 0 && ftruncate(m->fd, final_length) != 0)
+        status = -1;
+    if (close(m->fd) != 0)
+        status = -1;
+
+    m->data = NULL;
+    return status;
+}
+
+
+/* The buffer rl_read_stream() starts with. */
+#define READ_INITIAL_SIZE (64 * 1024)
+
+
+int rl_read_stream(FILE *input, unsigned char **data, uint64_t *length) {
+    uint64_t size = 0, capacity = READ_INITIAL_SIZE;
+    unsigned char *buffer, *grown;
+    size_t got;
+
+    buffer = malloc(capacity + 1);
+    if (buffer == NULL)
+        return -1;
+
+    while ((got = fread(buffer + size, sizeof(unsigned char),
+                        capacity - size, input)) > 0) {
+        size += got;
+
+        /* Grow when the buffer is full, keeping the spare byte. */
+        if (size == capacity) {
+            capacity *= 2;
+            grown = (capacity + 1 == (size_t) (capacity + 1)) ?
+                    realloc(buffer, capacity + 1) : NULL;
+            if (grown == NULL) {
+                free(buffer);
+                return -1;
+            }
+            buffer = grown;
+        }
+    }
+
+    if (ferror(input)) {
+        free(buffer);
+        return -1;
+    }
+
+    *data = buffer;
+    *length = size;
+    return 0;
+}
@@ -0,0 +1,52 @@
+/* Memory-mapped input and output files for rlenc and rldec.
+ *
+ * The input is mapped read-only, and the output is created at its final
+ * size (or an upper bound on it) with ftruncate() and mapped shared, so
+ * data goes from one file's pages to the other's with no copies through
+ * stdio buffers.  Both mappings are advised as sequential.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+
+typedef struct rl_map {
+    unsigned char *data;
+    uint64_t length;
+    int fd;
+} rl_map;
+
+
+/* Values rl_map_input() and rl_map_output() return. */
+#define RL_MAP_OK 0
+#define RL_MAP_NO_FILE -1       /* The file couldn't be opened. */
+#define RL_MAP_NO_MAP -2        /* It isn't a file that can be mapped. */
+
+
+/* Map the file at "path" for reading.  If the file is opened but can't be
+ * mapped, RL_MAP_NO_MAP is returned with m->fd still open, so that it can
+ * be read another way; reopening a pipe or FIFO by name would lose
+ * whatever the writer had already sent.  The caller must close it.
+ */
+int rl_map_input(rl_map *m, const char *path);
+
+
+/* Create or truncate the file at "path", make it "length" bytes long, and
+ * map it for writing.
+ */
+int rl_map_output(rl_map *m, const char *path, uint64_t length);
+
+
+/* Unmap a file and close it.  If "final_length" isn't negative, the file
+ * is first cut down to that many bytes.  Returns 0 on success, or -1 if
+ * the file couldn't be truncated or closed.
+ */
+int rl_unmap(rl_map *m, int64_t final_length);
+
+
+/* Read everything left in "input" into a malloc'd buffer, for files that
+ * can't be mapped, such as pipes.  The buffer has one spare byte after the
+ * data.  Returns 0 on success, or -1 if reading fails or memory runs out,
+ * in which case nothing is left allocated.
+ */
+int rl_read_stream(FILE *input, unsigned char **data, uint64_t *length);
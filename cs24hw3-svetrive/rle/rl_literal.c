@@ -0,0 +1,132 @@
+/*
+ * Decoder for the literal-run format described in rl_literal.h.
+ *
+ * The decoded length is in the header, so the output is allocated once and
+ * filled in a single pass, or a mapped file is sized before decoding.  Most
+ * tokens in real data are short, and for those a call to memcpy() or
+ * memset() costs more than the copy itself, so tokens of up to 16 bytes are
+ * done with two 8-byte loads and stores when there is room for them in the
+ * input and the output.  Longer tokens go to memcpy() and memset(), which
+ * move large blocks at full speed.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rl_literal.h"
+
+
+int rl_is_literal_format(const unsigned char *input_data,
+                         uint64_t input_length) {
+    return input_length >= RL_LITERAL_TAG_LENGTH &&
+           memcmp(input_data, RL_LITERAL_TAG, RL_LITERAL_TAG_LENGTH) == 0;
+}
+
+
+/*
+ * Reads a varint from in[*pos], stopping at "end".  Returns 0 on success,
+ * or -1 if the input ends first or the value doesn't fit in 64 bits.
+ */
+static int read_varint(const unsigned char *in, uint64_t end, uint64_t *pos,
+                       uint64_t *value) {
+    int shift = 0;
+
+    *value = 0;
+    while (*pos < end && shift < 64) {
+        unsigned char b = in[(*pos)++];
+        *value |= (uint64_t) (b & 0x7f) << shift;
+        if ((b & 0x80) == 0)
+            return 0;
+        shift += 7;
+    }
+    return -1;
+}
+
+
+int64_t rl_literal_length(const unsigned char *input_data,
+                          uint64_t input_length) {
+    uint64_t pos = RL_LITERAL_TAG_LENGTH, total;
+
+    if (!rl_is_literal_format(input_data, input_length) ||
+        read_varint(input_data, input_length, &pos, &total) != 0 ||
+        total > INT64_MAX) {
+        return -1;
+    }
+    return total;
+}
+
+
+uint64_t rl_decode_literal_into(const unsigned char *input_data,
+                                uint64_t input_length, unsigned char *output,
+                                uint64_t output_length) {
+    const unsigned char *in = input_data;
+    unsigned char *o = output, *end = output + output_length;
+    uint64_t pos = RL_LITERAL_TAG_LENGTH, total, h, n;
+
+    if (read_varint(in, input_length, &pos, &total) != 0)
+        return 0;
+    if (total < output_length)
+        end = output + total;
+
+    while (pos < input_length && o < end) {
+        if (read_varint(in, input_length, &pos, &h) != 0)
+            break;
+        n = (h >> 1) + 1;
+        if (n > (uint64_t) (end - o))
+            break;
+
+        if (h & 1) {
+            /* A literal. */
+            if (n > input_length - pos)
+                break;
+            if (n <= 16 && input_length - pos >= 16 && end - o >= 16) {
+                uint64_t w0, w1;
+                memcpy(&w0, in + pos, 8);
+                memcpy(&w1, in + pos + 8, 8);
+                memcpy(o, &w0, 8);
+                memcpy(o + 8, &w1, 8);
+            }
+            else {
+                memcpy(o, in + pos, n);
+            }
+            pos += n;
+        }
+        else {
+            /* A run. */
+            if (pos >= input_length)
+                break;
+            if (n <= 16 && end - o >= 16) {
+                uint64_t word = in[pos] * 0x0101010101010101ULL;
+                memcpy(o, &word, 8);
+                memcpy(o + 8, &word, 8);
+            }
+            else {
+                memset(o, in[pos], n);
+            }
+            pos++;
+        }
+        o += n;
+    }
+
+    return o - output;
+}
+
+
+unsigned char * rl_decode_literal(unsigned char *input_data, int input_length,
+                                  int *output_length) {
+    int64_t total = rl_literal_length(input_data, input_length);
+    unsigned char *output;
+
+    *output_length = 0;
+    if (total < 0 || total > INT32_MAX)
+        return malloc(1);
+
+    output = malloc(total + 1);
+    if (output == NULL)
+        return NULL;
+
+    *output_length = rl_decode_literal_into(input_data, input_length, output,
+                                            total);
+    return output;
+}
@@ -0,0 +1,82 @@
+/* The literal-run format, which keeps incompressible data from doubling in
+ * size.
+ *
+ * A file starts with the four-byte tag RL_LITERAL_TAG and the decoded
+ * length as a varint, followed by tokens.  Each token starts with a varint
+ * h, where h >> 1 is the token's length minus one:
+ *
+ *     h & 1 == 0:  a run; one byte follows, repeated (h >> 1) + 1 times
+ *     h & 1 == 1:  a literal; (h >> 1) + 1 bytes follow, copied verbatim
+ *
+ * Varints are little-endian base 128:  seven bits per byte, low bits first,
+ * with the top bit set on every byte but the last.  The original format
+ * never writes a count of zero, so no file in that format starts with the
+ * tag, and rl_decode() can tell the two apart.
+ */
+
+#include <stdint.h>
+
+
+#define RL_LITERAL_TAG "\0RL2"
+#define RL_LITERAL_TAG_LENGTH 4
+
+/* Runs shorter than this are cheaper to leave inside a literal. */
+#define RL_LITERAL_MIN_RUN 3
+
+/* The most bytes encoding "input_length" bytes can produce.  Each literal
+ * header costs at most one byte more than one per 64 literal bytes, and
+ * every literal but the first follows a run that saved at least a byte.
+ */
+#define RL_LITERAL_BOUND(input_length)                                      \
+    (RL_LITERAL_TAG_LENGTH + 10 + (uint64_t) (input_length) +               \
+     (uint64_t) (input_length) / 64 + 2)
+
+
+/* Returns nonzero if "input_data" starts with the literal format's tag. */
+int rl_is_literal_format(const unsigned char *input_data,
+                         uint64_t input_length);
+
+
+/* Returns the decoded length stored in the header, or -1 if the header is
+ * damaged.
+ */
+int64_t rl_literal_length(const unsigned char *input_data,
+                          uint64_t input_length);
+
+
+/* Encode into a malloc'd buffer, like rl_encode(). */
+unsigned char * rl_encode_literal(unsigned char *input_data,
+                                  uint64_t input_length,
+                                  uint64_t *output_length);
+
+
+/* Encode into "output", which must have room for
+ * RL_LITERAL_BOUND(input_length) bytes, and return the number of bytes
+ * written.
+ */
+uint64_t rl_encode_literal_buffer(const unsigned char *input_data,
+                                  uint64_t input_length,
+                                  unsigned char *output);
+
+
+/* The variants rl_encode_literal_buffer() chooses between at startup. */
+uint64_t rl_encode_literal_sse2(const unsigned char *input_data,
+                                uint64_t input_length, unsigned char *output);
+uint64_t rl_encode_literal_avx2(const unsigned char *input_data,
+                                uint64_t input_length, unsigned char *output);
+
+
+/* Decode a file in the literal format into a malloc'd buffer.  rl_decode()
+ * calls this itself when it sees the tag.  Damaged input is decoded as far
+ * as it makes sense, and *output_length says how far that was.
+ */
+unsigned char * rl_decode_literal(unsigned char *input_data, int input_length,
+                                  int *output_length);
+
+
+/* Decode into "output", writing at most "output_length" bytes, and return
+ * the number of bytes written.
+ */
+uint64_t rl_decode_literal_into(const unsigned char *input_data,
+                                uint64_t input_length, unsigned char *output,
+                                uint64_t output_length);
@@ -0,0 +1,274 @@
+/*
+ * Streaming run-length decoder.  See rl_stream.h for how it is used.
+ *
+ * Runs are expanded into a fixed buffer that is flushed to the sink once it
+ * can't be guaranteed to hold another run of 255 bytes, so the inner loop
+ * never has to split a run.  Most runs in real images are short, and for
+ * those a call to memset() costs more than the run itself, so runs of up to
+ * 16 bytes are written as two 8-byte stores of the repeated value; the
+ * extra bytes land in space the next run overwrites, or in the slack past
+ * the end of the buffer.
+ *
+ * Until the first four bytes have been seen, the stream doesn't know which
+ * format it has, so it holds on to them.  As soon as one doesn't match the
+ * literal format's tag, they are decoded as the start of an original
+ * stream.  The literal format is decoded a byte at a time while reading
+ * varints, and in bulk, split only where the buffer fills, for the bytes
+ * of a token.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "rl_literal.h"
+#include "rl_stream.h"
+
+
+/* Values of rl_stream.format. */
+#define FORMAT_UNKNOWN 0
+#define FORMAT_ORIGINAL 1
+#define FORMAT_LITERAL 2
+
+/* Values of rl_stream.token_state:  what the literal format expects next. */
+#define EXPECT_LENGTH 0     /* The decoded length, after the tag. */
+#define EXPECT_HEADER 1     /* A token header. */
+#define EXPECT_VALUE 2      /* The byte a run repeats. */
+#define EXPECT_LITERAL 3    /* More bytes of a literal. */
+
+
+/* The decoded buffer is flushed before it has less room than this. */
+#define MAX_RUN 255
+
+
+static int flush(rl_stream *s) {
+    if (s->buffered > 0 && !s->failed) {
+        if (s->sink(s->ctx, s->buffer, s->buffered) != 0)
+            s->failed = 1;
+    }
+    s->buffered = 0;
+    return s->failed ? -1 : 0;
+}
+
+
+/* Appends a run to the buffer, which must have room for MAX_RUN bytes. */
+static inline void put_run(rl_stream *s, int count, unsigned char value) {
+    unsigned char *out = s->buffer + s->buffered;
+
+    if (count <= 16) {
+        uint64_t word = value * 0x0101010101010101ULL;
+        memcpy(out, &word, 8);
+        memcpy(out + 8, &word, 8);
+    }
+    else {
+        memset(out, value, count);
+    }
+
+    s->buffered += count;
+    s->output_length += count;
+}
+
+
+/* Appends "n" copies of "value", flushing whenever the buffer fills. */
+static int put_fill(rl_stream *s, unsigned char value, uint64_t n) {
+    int k;
+
+    while (n > 0) {
+        if (s->buffered == RL_STREAM_BUFFER && flush(s) != 0)
+            return -1;
+        k = (n < (uint64_t) (RL_STREAM_BUFFER - s->buffered)) ?
+            (int) n : RL_STREAM_BUFFER - s->buffered;
+        memset(s->buffer + s->buffered, value, k);
+        s->buffered += k;
+        s->output_length += k;
+        n -= k;
+    }
+    return 0;
+}
+
+
+/* Appends "n" bytes copied from "data", flushing whenever the buffer fills. */
+static int put_copy(rl_stream *s, const unsigned char *data, int n) {
+    int k;
+
+    while (n > 0) {
+        if (s->buffered == RL_STREAM_BUFFER && flush(s) != 0)
+            return -1;
+        k = (n < RL_STREAM_BUFFER - s->buffered) ?
+            n : RL_STREAM_BUFFER - s->buffered;
+        memcpy(s->buffer + s->buffered, data, k);
+        s->buffered += k;
+        s->output_length += k;
+        data += k;
+        n -= k;
+    }
+    return 0;
+}
+
+
+void rl_stream_init(rl_stream *s, rl_sink sink, void *ctx) {
+    s->sink = sink;
+    s->ctx = ctx;
+    s->buffered = 0;
+    s->format = FORMAT_UNKNOWN;
+    s->prefix_length = 0;
+    s->pending_count = -1;
+    s->varint = 0;
+    s->varint_shift = 0;
+    s->token_state = EXPECT_LENGTH;
+    s->remaining = 0;
+    s->expected_length = 0;
+    s->output_length = 0;
+    s->failed = 0;
+    s->damaged = 0;
+}
+
+
+static int feed_original(rl_stream *s, const unsigned char *data,
+                         int length) {
+    const unsigned char *end = data + length;
+
+    if (length <= 0)
+        return 0;
+
+    /* Finish the pair the last chunk ended in the middle of. */
+    if (s->pending_count >= 0) {
+        if (s->buffered > RL_STREAM_BUFFER - MAX_RUN && flush(s) != 0)
+            return -1;
+        put_run(s, s->pending_count, data[0]);
+        s->pending_count = -1;
+        data++;
+    }
+
+    while (end - data >= 2) {
+        if (s->buffered > RL_STREAM_BUFFER - MAX_RUN && flush(s) != 0)
+            return -1;
+
+        /* Expand as many whole pairs as are sure to fit before a flush. */
+        while (end - data >= 2 && s->buffered <= RL_STREAM_BUFFER - MAX_RUN) {
+            put_run(s, data[0], data[1]);
+            data += 2;
+        }
+    }
+
+    if (data < end)
+        s->pending_count = data[0];
+
+    return 0;
+}
+
+
+static int feed_literal(rl_stream *s, const unsigned char *data, int length) {
+    const unsigned char *end = data + length;
+    unsigned char b;
+    int n;
+
+    while (data < end) {
+        switch (s->token_state) {
+        case EXPECT_LENGTH:
+        case EXPECT_HEADER:
+            b = *data++;
+            if (s->varint_shift >= 64) {
+                s->damaged = 1;
+                return -1;
+            }
+            s->varint |= (uint64_t) (b & 0x7f) << s->varint_shift;
+            s->varint_shift += 7;
+            if (b & 0x80)
+                break;
+
+            if (s->token_state == EXPECT_LENGTH) {
+                s->expected_length = s->varint;
+                s->token_state = EXPECT_HEADER;
+            }
+            else {
+                s->remaining = (s->varint >> 1) + 1;
+                s->token_state = (s->varint & 1) ?
+                                 EXPECT_LITERAL : EXPECT_VALUE;
+                if (s->remaining >
+                    (uint64_t) (s->expected_length - s->output_length)) {
+                    s->damaged = 1;
+                    return -1;
+                }
+            }
+            s->varint = 0;
+            s->varint_shift = 0;
+            break;
+
+        case EXPECT_VALUE:
+            if (put_fill(s, *data++, s->remaining) != 0)
+                return -1;
+            s->token_state = EXPECT_HEADER;
+            break;
+
+        case EXPECT_LITERAL:
+            n = (s->remaining < (uint64_t) (end - data)) ?
+                (int) s->remaining : end - data;
+            if (put_copy(s, data, n) != 0)
+                return -1;
+            data += n;
+            s->remaining -= n;
+            if (s->remaining == 0)
+                s->token_state = EXPECT_HEADER;
+            break;
+        }
+    }
+
+    return 0;
+}
+
+
+/*
+ * Settles the format once the bytes held in s->prefix either are the whole
+ * tag or can't be, and decodes any that belong to an original stream.
+ */
+static int settle_format(rl_stream *s) {
+    if (s->prefix_length == RL_LITERAL_TAG_LENGTH &&
+        memcmp(s->prefix, RL_LITERAL_TAG, RL_LITERAL_TAG_LENGTH) == 0) {
+        s->format = FORMAT_LITERAL;
+        return 0;
+    }
+
+    s->format = FORMAT_ORIGINAL;
+    return feed_original(s, s->prefix, s->prefix_length);
+}
+
+
+int rl_stream_feed(rl_stream *s, const unsigned char *data, int length) {
+    if (s->failed || s->damaged)
+        return -1;
+    if (length <= 0)
+        return 0;
+
+    while (s->format == FORMAT_UNKNOWN && length > 0) {
+        s->prefix[s->prefix_length] = *data++;
+        length--;
+        if (s->prefix[s->prefix_length] !=
+            (unsigned char) RL_LITERAL_TAG[s->prefix_length] ||
+            ++s->prefix_length == RL_LITERAL_TAG_LENGTH) {
+            if (s->prefix_length < RL_LITERAL_TAG_LENGTH)
+                s->prefix_length++;
+            if (settle_format(s) != 0)
+                return -1;
+        }
+    }
+
+    if (s->format == FORMAT_LITERAL)
+        return feed_literal(s, data, length);
+    return feed_original(s, data, length);
+}
+
+
+int rl_stream_finish(rl_stream *s) {
+    /* Input shorter than the tag is in the original format. */
+    if (s->format == FORMAT_UNKNOWN && !s->failed && settle_format(s) != 0)
+        return -1;
+
+    if (flush(s) != 0 || s->damaged)
+        return -1;
+
+    if (s->format == FORMAT_LITERAL) {
+        return (s->token_state == EXPECT_HEADER && s->varint_shift == 0 &&
+                s->output_length == s->expected_length) ? 0 : -1;
+    }
+    return (s->pending_count >= 0) ? -1 : 0;
+}
@@ -0,0 +1,89 @@
+/* A streaming run-length decoder, for inputs too big to hold in memory.
+ *
+ * The encoded data is fed in chunks of any size, and the decoded bytes are
+ * handed to a sink function a buffer at a time, so memory use doesn't grow
+ * with the size of the input or the output.  A (count, value) pair may be
+ * split across two chunks.  Input in the literal-run format (see
+ * rl_literal.h) is recognized by its tag and decoded too; its tokens may be
+ * split across chunks anywhere.
+ *
+ *     rl_stream s;
+ *     rl_stream_init(&s, sink, ctx);
+ *     while (...more input...)
+ *         rl_stream_feed(&s, chunk, chunk_length);
+ *     rl_stream_finish(&s);
+ */
+
+#include <stdint.h>
+
+
+/* How many decoded bytes are gathered before they go to the sink. */
+#define RL_STREAM_BUFFER (64 * 1024)
+
+/* Extra room past the end of the buffer, so short runs can be written with
+ * a couple of whole-word stores without checking how many bytes they need.
+ */
+#define RL_STREAM_SLACK 16
+
+
+/* Receives "length" decoded bytes.  Returns 0 on success, or nonzero to
+ * stop decoding.
+ */
+typedef int (*rl_sink)(void *ctx, const unsigned char *data, int length);
+
+
+typedef struct rl_stream {
+    rl_sink sink;
+    void *ctx;
+
+    /* Decoded bytes not yet given to the sink. */
+    unsigned char buffer[RL_STREAM_BUFFER + RL_STREAM_SLACK];
+    int buffered;
+
+    /* Which format the input is in, once enough of it has been seen. */
+    int format;
+
+    /* The first few bytes, while deciding whether they are the tag. */
+    unsigned char prefix[4];
+    int prefix_length;
+
+    /* Original format:  the count of a pair whose value is in the next
+     * chunk, or -1.
+     */
+    int pending_count;
+
+    /* Literal format:  the varint being read, what it is for, and how many
+     * bytes of the current token are still to come.
+     */
+    uint64_t varint;
+    int varint_shift;
+    int token_state;
+    uint64_t remaining;
+    long long expected_length;
+
+    /* Total decoded bytes so far, including those still buffered. */
+    long long output_length;
+
+    /* Nonzero once the sink has failed; every later call fails too. */
+    int failed;
+
+    /* Nonzero once the input turned out not to be valid. */
+    int damaged;
+} rl_stream;
+
+
+/* Start decoding a new stream, sending the output to "sink". */
+void rl_stream_init(rl_stream *s, rl_sink sink, void *ctx);
+
+
+/* Decode the next "length" bytes of input.  Returns 0 on success, or -1 if
+ * the sink reported an error or the input is damaged.
+ */
+int rl_stream_feed(rl_stream *s, const unsigned char *data, int length);
+
+
+/* Flush the remaining output to the sink.  Returns 0 on success, or -1 if
+ * the sink reported an error, the input is damaged, or the input ended in
+ * the middle of a pair or token.
+ */
+int rl_stream_finish(rl_stream *s);
@@ -1,71 +1,349 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <stdint.h>
+#include <unistd.h>
 
-#include "rl_decode.h"
+#include "rl_block.h"
+#include "rl_buffer.h"
+#include "rl_file.h"
+#include "rl_stream.h"
+
+
+/* How much of the input file is read at a time. */
+#define CHUNK_SIZE (64 * 1024)
+
+/* Returned by decode_mapped() when the output can't be mapped, and the
+ * stdio path has to be used instead.
+ */
+#define USE_STDIO -1
 
 
 /* Prints usage about how to use the rldec utility program. */
 void usage(const char *progname) {
     assert(progname != NULL);
 
-    printf("usage:  %s infile outfile\n", progname);
+    printf("usage:  %s [-s] [-c [-t threads] [-o offset] [-n length]] "
+           "infile outfile\n", progname);
     printf("\tThe program takes a run-length-encoded input file and\n");
     printf("\tproduces a decoded version of the file, saving\n");
-    printf("\tthe result to outfile.\n");
+    printf("\tthe result to outfile.\n\n");
+    printf("\t-s reads and writes through stdio instead of mapping the\n");
+    printf("\t   files into memory\n");
+    printf("\t-c reads a block-indexed container written by rlenc -c\n");
+    printf("\t-t threads sets how many threads decode the container\n");
+    printf("\t   (default:  one per CPU)\n");
+    printf("\t-o offset -n length decode only \"length\" bytes starting\n");
+    printf("\t   at \"offset\" in the decoded data\n");
+}
+
+
+/* Writes a buffer of decoded data to the output file. */
+int write_output(void *ctx, const unsigned char *data, int length) {
+    FILE *output = (FILE *) ctx;
+    return fwrite(data, sizeof(unsigned char), length, output) !=
+           (size_t) length;
 }
 
 
-/* The main function for the rlenc utility program, which takes an input
- * file, RLE-encodes the contents, and then writes the results to a binary
- * output file.
+/* Decodes a plain RLE stream, in either format, a chunk at a time, so that
+ * memory use stays the same however large the files are.  Returns the exit
+ * status.
  */
-int main(int argc, char **argv) {
-    FILE *input, *output;
-    int input_size, output_size;
+int decode_stream(FILE *input, FILE *output, const char *infile,
+                  const char *outfile) {
+    static unsigned char chunk[CHUNK_SIZE];
+    static rl_stream stream;
+    size_t chunk_size;
+
+    rl_stream_init(&stream, write_output, output);
+    while ((chunk_size = fread(chunk, sizeof(unsigned char), CHUNK_SIZE,
+                               input)) > 0) {
+        if (rl_stream_feed(&stream, chunk, (int) chunk_size) != 0)
+            break;
+    }
+
+    if (ferror(input)) {
+        printf("Couldn't read input file \"%s\"!\n", infile);
+        return 4;
+    }
+    if (rl_stream_finish(&stream) != 0) {
+        if (stream.failed) {
+            printf("Couldn't write output file \"%s\"!\n", outfile);
+            return 5;
+        }
+        printf("Input file \"%s\" is damaged or truncated!\n", infile);
+        return 6;
+    }
+    return 0;
+}
+
+
+/* Decodes a block-indexed container, either all of it using several
+ * threads, or just the range starting at "offset", if "length" isn't
+ * negative.  Returns the exit status.
+ */
+int decode_container(FILE *input, FILE *output, const char *infile,
+                     const char *outfile, int num_threads,
+                     uint64_t offset, int64_t length) {
+    rl_block_file f;
+    uint64_t input_size;
     unsigned char *input_buffer, *output_buffer;
+    int64_t output_size;
+    int status = 0;
 
-    /* If we didn't get enough arguments, complain. */
-    if (argc != 3) {
-        usage(argv[0]);
-        return 1;
+    /* Load the input file into a buffer in memory. */
+    if (rl_read_stream(input, &input_buffer, &input_size) != 0) {
+        printf("Couldn't read input file \"%s\"!\n", infile);
+        return 4;
     }
 
-    input = fopen(argv[1], "rb");
+    if (rl_block_open(&f, input_buffer, input_size) != 0) {
+        printf("Input file \"%s\" isn't a valid container!\n", infile);
+        free(input_buffer);
+        return 6;
+    }
+
+    if (length < 0) {
+        output_size = f.header->decoded_length;
+        output_buffer = malloc(output_size + 1);
+        if (output_buffer != NULL &&
+            rl_block_decode(&f, output_buffer, num_threads) != 0) {
+            output_size = -1;
+        }
+    }
+    else {
+        if (offset >= f.header->decoded_length)
+            length = 0;
+        else if ((uint64_t) length > f.header->decoded_length - offset)
+            length = f.header->decoded_length - offset;
+
+        output_buffer = malloc(length + 1);
+        if (output_buffer != NULL)
+            output_size = rl_block_read(&f, offset, output_buffer, length);
+    }
+
+    if (output_buffer == NULL) {
+        printf("Not enough memory to decode \"%s\"!\n", infile);
+        status = 7;
+    }
+    else if (output_size < 0) {
+        printf("Input file \"%s\" has a damaged block!\n", infile);
+        status = 6;
+    }
+    else if (fwrite(output_buffer, sizeof(unsigned char), output_size,
+                    output) != (size_t) output_size) {
+        printf("Couldn't write output file \"%s\"!\n", outfile);
+        status = 5;
+    }
+
+    free(input_buffer);
+    free(output_buffer);
+    return status;
+}
+
+
+/* Decodes from a mapped input file straight into a mapped output file,
+ * which is made exactly as long as the decoded data before decoding starts.
+ * Returns the exit status, or USE_STDIO if the output can't be mapped.
+ */
+int decode_mapped(rl_map *input, const char *infile, const char *outfile,
+                  int container, int num_threads, uint64_t offset,
+                  int64_t length) {
+    rl_block_file f;
+    rl_map output;
+    int64_t output_size, decoded;
+    int status;
+
+    if (container) {
+        if (rl_block_open(&f, input->data, input->length) != 0) {
+            printf("Input file \"%s\" isn't a valid container!\n", infile);
+            return 6;
+        }
+
+        output_size = f.header->decoded_length;
+        if (length >= 0) {
+            if (offset >= f.header->decoded_length)
+                output_size = 0;
+            else if ((uint64_t) length < f.header->decoded_length - offset)
+                output_size = length;
+            else
+                output_size = f.header->decoded_length - offset;
+        }
+    }
+    else {
+        output_size = rl_decoded_length(input->data, input->length);
+        if (output_size < 0) {
+            printf("Input file \"%s\" is damaged or truncated!\n", infile);
+            return 6;
+        }
+    }
+
+    status = rl_map_output(&output, outfile, output_size);
+    if (status == RL_MAP_NO_FILE) {
+        printf("Couldn't open output file \"%s\"!\n", outfile);
+        return 3;
+    }
+    if (status == RL_MAP_NO_MAP)
+        return USE_STDIO;
+
+    printf("Decoding file \"%s\" into file \"%s\".\n", infile, outfile);
+
+    if (!container) {
+        decoded = rl_decode_into(input->data, input->length, output.data,
+                                 output_size);
+    }
+    else if (length < 0) {
+        decoded = (rl_block_decode(&f, output.data, num_threads) == 0) ?
+                  output_size : -1;
+    }
+    else {
+        decoded = rl_block_read(&f, offset, output.data, output_size);
+    }
+
+    status = 0;
+    if (decoded != output_size) {
+        printf("Input file \"%s\" is damaged or truncated!\n", infile);
+        status = 6;
+    }
+    if (rl_unmap(&output, -1) != 0 && status == 0) {
+        printf("Couldn't write output file \"%s\"!\n", outfile);
+        status = 5;
+    }
+    return status;
+}
+
+
+/* Decodes through stdio.  This is the path for -s, and for any file that
+ * can't be mapped, such as a pipe, a FIFO or /dev/stdin.  A plain stream is
+ * decoded a chunk at a time, and a container is read in chunks by
+ * rl_read_stream(), so neither needs to know the input's length up front.
+ * If "input_fd" isn't negative, the input is read from that descriptor,
+ * which is closed afterwards, instead of opened by name.  Returns the exit
+ * status.
+ */
+int decode_stdio(int input_fd, const char *infile, const char *outfile,
+                 int container, int num_threads, uint64_t offset,
+                 int64_t length) {
+    FILE *input, *output;
+    int status;
+
+    input = (input_fd >= 0) ? fdopen(input_fd, "rb") : fopen(infile, "rb");
     if (input == NULL) {
-        printf("Couldn't open input file \"%s\"!\n", argv[1]);
+        printf("Couldn't open input file \"%s\"!\n", infile);
         return 2;
     }
 
-    output = fopen(argv[2], "wb");
+    output = fopen(outfile, "wb");
     if (output == NULL) {
-        printf("Couldn't open output file \"%s\"!\n", argv[2]);
+        printf("Couldn't open output file \"%s\"!\n", outfile);
+        fclose(input);
         return 3;
     }
 
-    printf("Decoding file \"%s\" into file \"%s\".\n", argv[1], argv[2]);
+    printf("Decoding file \"%s\" into file \"%s\".\n", infile, outfile);
 
-    /* Load the input file into a buffer in memory. */
-    fseek(input, 0, SEEK_END);
-    input_size = ftell(input);
-    fseek(input, 0, SEEK_SET);
-    input_buffer = malloc(input_size + 1);
+    if (container) {
+        status = decode_container(input, output, infile, outfile,
+                                  num_threads, offset, length);
+    }
+    else {
+        status = decode_stream(input, output, infile, outfile);
+    }
 
-    fread(input_buffer, sizeof(unsigned char), input_size, input);
+    if (fclose(output) != 0 && status == 0) {
+        printf("Couldn't write output file \"%s\"!\n", outfile);
+        status = 5;
+    }
+    fclose(input);
 
-    /* Decode the input file, and write the resutls to the output file. */
-    output_buffer = rl_decode(input_buffer, input_size, &output_size);
+    return status;
+}
 
-    fwrite(output_buffer, sizeof(unsigned char), output_size, output);
 
-    printf("All done!\n");
+/* The main function for the rldec utility program, which takes an
+ * RLE-encoded input file, RLE-decodes the contents, and then writes
+ * the results to an output file.
+ */
+int main(int argc, char **argv) {
+    int container = 0, num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int use_stdio = 0;
+    uint64_t offset = 0;
+    int64_t length = -1;
+    char *infile, *outfile;
+    rl_map input;
+    int input_fd = -1;
+    int status, c;
 
-    fclose(output);
-    fclose(input);
+    while ((c = getopt(argc, argv, "sct:o:n:h")) != -1) {
+        switch (c) {
+        case 's':
+            use_stdio = 1;
+            break;
 
-    free(input_buffer);
-    free(output_buffer);
+        case 'c':
+            container = 1;
+            break;
 
-    return 0;
-}
+        case 't':
+            num_threads = atoi(optarg);
+            break;
+
+        case 'o':
+            offset = strtoull(optarg, NULL, 0);
+            break;
+
+        case 'n':
+            length = strtoll(optarg, NULL, 0);
+            break;
+
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    /* If we didn't get enough arguments, complain. */
+    if (argc - optind != 2 || (!container && (offset != 0 || length >= 0))) {
+        usage(argv[0]);
+        return 1;
+    }
+    infile = argv[optind];
+    outfile = argv[optind + 1];
+
+    /* Decoding a range needs a length; without one, go to the end. */
+    if (offset != 0 && length < 0)
+        length = INT64_MAX;
 
+    /* Map the files if we can.  An input that isn't a regular file, or an
+     * output that can't be mapped, goes through stdio instead.
+     */
+    status = USE_STDIO;
+    if (!use_stdio) {
+        switch (rl_map_input(&input, infile)) {
+        case RL_MAP_NO_FILE:
+            printf("Couldn't open input file \"%s\"!\n", infile);
+            return 2;
+
+        case RL_MAP_NO_MAP:
+            input_fd = input.fd;
+            break;
+
+        case RL_MAP_OK:
+            status = decode_mapped(&input, infile, outfile, container,
+                                   num_threads, offset, length);
+            rl_unmap(&input, -1);
+            break;
+        }
+    }
+
+    if (status == USE_STDIO) {
+        status = decode_stdio(input_fd, infile, outfile, container,
+                              num_threads, offset, length);
+    }
+
+    if (status == 0)
+        printf("All done!\n");
+
+    return status;
+}
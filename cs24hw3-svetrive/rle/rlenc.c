@@ -1,89 +1,291 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "rl_block.h"
+#include "rl_encode.h"
+#include "rl_file.h"
+#include "rl_literal.h"
+
+
+/* How much of the input file is read at a time. */
+#define CHUNK_SIZE (64 * 1024)
+
+/* Returned by encode_mapped() when the output can't be mapped, and the
+ * stdio path has to be used instead.
+ */
+#define USE_STDIO -1
 
 
 /* Prints usage about how to use the rldec utility program. */
 void usage(const char *progname) {
     assert(progname != NULL);
 
-    printf("usage:  %s infile outfile\n", progname);
+    printf("usage:  %s [-s] [-l | -c [-b block_size]] infile outfile\n",
+           progname);
     printf("\tThe program takes the input file and produces a\n");
     printf("\trun-length-encoded version of the file, saving\n");
-    printf("\tthe result to outfile.\n");
+    printf("\tthe result to outfile.\n\n");
+    printf("\t-s reads and writes through stdio instead of mapping the\n");
+    printf("\t   files into memory\n");
+    printf("\t-l writes the literal-run format, which copies bytes that\n");
+    printf("\t   don't repeat instead of doubling them\n");
+    printf("\t-c writes a block-indexed container, which rldec -c can\n");
+    printf("\t   decode in parallel or in pieces\n");
+    printf("\t-b block_size sets the container's block size in bytes\n");
+    printf("\t   (default %d); implies -c\n", RL_BLOCK_DEFAULT_SIZE);
 }
 
 
-/* The main function for the rldec utility program, which takes an
- * RLE-encoded input file, RLE-decodes the contents, and then writes
- * the results to an output file.  No validation is done as to whether
- * the input file is actually RLE-encoded or not.
+/* Encodes from a mapped input file straight into a mapped output file.
+ * The output is made as long as the encoding could possibly be, and cut
+ * down to the real length afterwards.  Returns the exit status, or
+ * USE_STDIO if the output can't be mapped.
  */
-int main(int argc, char **argv) {
-    FILE *input, *output;
-    int lastch, nextch, count;
+int encode_mapped(rl_map *input, const char *infile, const char *outfile,
+                  int literal, int container, int block_size) {
+    rl_map output;
+    uint64_t bound, output_size;
+    int status;
 
-    /* If we didn't get enough arguments, complain. */
-    if (argc != 3) {
-        usage(argv[0]);
-        return 1;
+    if (container)
+        bound = RL_BLOCK_BOUND(input->length, block_size);
+    else if (literal)
+        bound = RL_LITERAL_BOUND(input->length);
+    else
+        bound = RL_ENCODE_BOUND(input->length);
+
+    status = rl_map_output(&output, outfile, bound);
+    if (status == RL_MAP_NO_FILE) {
+        printf("Couldn't open output file \"%s\"!\n", outfile);
+        return 3;
     }
+    if (status == RL_MAP_NO_MAP)
+        return USE_STDIO;
+
+    printf("Encoding file \"%s\" into file \"%s\".\n", infile, outfile);
 
-    input = fopen(argv[1], "rb");
+    if (container) {
+        output_size = rl_block_encode_buffer(input->data, input->length,
+                                             block_size, output.data);
+    }
+    else if (literal) {
+        output_size = rl_encode_literal_buffer(input->data, input->length,
+                                               output.data);
+    }
+    else {
+        output_size = rl_encode_buffer(input->data, input->length,
+                                       output.data);
+    }
+
+    if (rl_unmap(&output, output_size) != 0) {
+        printf("Couldn't write output file \"%s\"!\n", outfile);
+        return 5;
+    }
+    return 0;
+}
+
+
+/* Encodes the original format a chunk at a time, carrying the run still
+ * open at the end of each chunk into the next, so that memory use stays the
+ * same however large the files are.  Returns the exit status.
+ */
+int encode_stream(FILE *input, FILE *output, const char *infile,
+                  const char *outfile) {
+    static unsigned char chunk[CHUNK_SIZE];
+    static unsigned char encoded[RL_ENCODER_BOUND(CHUNK_SIZE)];
+    rl_encoder encoder;
+    size_t chunk_size;
+    uint64_t encoded_size;
+
+    rl_encoder_init(&encoder);
+    while ((chunk_size = fread(chunk, sizeof(unsigned char), CHUNK_SIZE,
+                               input)) > 0) {
+        encoded_size = rl_encoder_feed(&encoder, chunk, chunk_size, encoded);
+        if (fwrite(encoded, sizeof(unsigned char), encoded_size,
+                   output) != encoded_size) {
+            printf("Couldn't write output file \"%s\"!\n", outfile);
+            return 5;
+        }
+    }
+
+    if (ferror(input)) {
+        printf("Couldn't read input file \"%s\"!\n", infile);
+        return 6;
+    }
+
+    encoded_size = rl_encoder_finish(&encoder, encoded);
+    if (fwrite(encoded, sizeof(unsigned char), encoded_size,
+               output) != encoded_size) {
+        printf("Couldn't write output file \"%s\"!\n", outfile);
+        return 5;
+    }
+    return 0;
+}
+
+
+/* Encodes the literal format or a container, both of which need the whole
+ * input before anything is written:  the literal format starts with the
+ * decoded length, and the container ends with an index of every block.
+ * Since the length of the input isn't known until it ends, it is read in
+ * chunks by rl_read_stream().  Returns the exit status.
+ */
+int encode_whole(FILE *input, FILE *output, const char *infile,
+                 const char *outfile, int literal, int block_size) {
+    uint64_t input_size, output_size = 0;
+    unsigned char *input_buffer, *output_buffer;
+    int status = 0;
+
+    if (rl_read_stream(input, &input_buffer, &input_size) != 0) {
+        printf("Couldn't read input file \"%s\"!\n", infile);
+        return 6;
+    }
+
+    if (literal) {
+        output_buffer = rl_encode_literal(input_buffer, input_size,
+                                          &output_size);
+    }
+    else {
+        output_buffer = rl_block_encode(input_buffer, input_size, block_size,
+                                        &output_size);
+    }
+
+    if (output_buffer == NULL) {
+        printf("Not enough memory to encode \"%s\"!\n", infile);
+        status = 7;
+    }
+    else if (fwrite(output_buffer, sizeof(unsigned char), output_size,
+                    output) != output_size) {
+        printf("Couldn't write output file \"%s\"!\n", outfile);
+        status = 5;
+    }
+
+    free(input_buffer);
+    free(output_buffer);
+
+    return status;
+}
+
+
+/* Encodes with stdio.  This is the path for -s, and for any file that can't
+ * be mapped, such as a pipe, a FIFO or /dev/stdin.  If "input_fd" isn't
+ * negative, the input is read from that descriptor, which is closed
+ * afterwards, instead of opened by name.  Returns the exit status.
+ */
+int encode_stdio(int input_fd, const char *infile, const char *outfile,
+                 int literal, int container, int block_size) {
+    FILE *input, *output;
+    int status;
+
+    input = (input_fd >= 0) ? fdopen(input_fd, "rb") : fopen(infile, "rb");
     if (input == NULL) {
-        printf("Couldn't open input file \"%s\"!\n", argv[1]);
+        printf("Couldn't open input file \"%s\"!\n", infile);
         return 2;
     }
 
-    output = fopen(argv[2], "wb");
+    output = fopen(outfile, "wb");
     if (output == NULL) {
-        printf("Couldn't open output file \"%s\"!\n", argv[2]);
+        printf("Couldn't open output file \"%s\"!\n", outfile);
+        fclose(input);
         return 3;
     }
 
-    printf("Encoding file \"%s\" into file \"%s\".\n", argv[1], argv[2]);
+    printf("Encoding file \"%s\" into file \"%s\".\n", infile, outfile);
+
+    if (literal || container) {
+        status = encode_whole(input, output, infile, outfile, literal,
+                              block_size);
+    }
+    else {
+        status = encode_stream(input, output, infile, outfile);
+    }
+
+    if (fclose(output) != 0 && status == 0) {
+        printf("Couldn't write output file \"%s\"!\n", outfile);
+        status = 5;
+    }
+    fclose(input);
 
-    /* Encode the input file, and write the resutls to the output file. */
+    return status;
+}
 
-    lastch = fgetc(input);
-    if (lastch != EOF) {
-        count = 1;
 
-        while (1) {
-            nextch = fgetc(input);
-            if (nextch == EOF)
-                break;
+/* The main function for the rlenc utility program, which takes an input
+ * file, RLE-encodes the contents, and then writes the results to a binary
+ * output file.
+ */
+int main(int argc, char **argv) {
+    int literal = 0, container = 0, block_size = RL_BLOCK_DEFAULT_SIZE;
+    int use_stdio = 0;
+    char *infile, *outfile;
+    rl_map input;
+    int input_fd = -1;
+    int status, c;
 
-            assert(count > 0 && count < 256);
+    while ((c = getopt(argc, argv, "slcb:h")) != -1) {
+        switch (c) {
+        case 's':
+            use_stdio = 1;
+            break;
 
-	    if ((nextch != lastch && lastch != -1) || count == 255) {
-                /* Write out the count and then the character. */
-                fputc(count, output);
-                fputc(lastch, output);
+        case 'l':
+            literal = 1;
+            break;
 
-                lastch = nextch;
-                count = 1;
-            }
-            else {
-                /* Saw the same character again. */
-                count++;
-            }
+        case 'c':
+            container = 1;
+            break;
 
-            assert(count > 0 && count < 256);
+        case 'b':
+            container = 1;
+            block_size = atoi(optarg);
+            break;
+
+        default:
+            usage(argv[0]);
+            return 1;
         }
+    }
+
+    /* If we didn't get enough arguments, complain. */
+    if (argc - optind != 2 || block_size <= 0 || (literal && container)) {
+        usage(argv[0]);
+        return 1;
+    }
+    infile = argv[optind];
+    outfile = argv[optind + 1];
+
+    /* Map the files if we can.  An input that isn't a regular file, or an
+     * output that can't be mapped, goes through stdio instead.
+     */
+    status = USE_STDIO;
+    if (!use_stdio) {
+        switch (rl_map_input(&input, infile)) {
+        case RL_MAP_NO_FILE:
+            printf("Couldn't open input file \"%s\"!\n", infile);
+            return 2;
+
+        case RL_MAP_NO_MAP:
+            input_fd = input.fd;
+            break;
 
-        if (count > 0) {
-            /* Write the last values out. */
-            fputc(count, output);
-            fputc(lastch, output);
+        case RL_MAP_OK:
+            status = encode_mapped(&input, infile, outfile, literal,
+                                   container, block_size);
+            rl_unmap(&input, -1);
+            break;
         }
     }
 
-    fclose(output);
-    fclose(input);
+    if (status == USE_STDIO) {
+        status = encode_stdio(input_fd, infile, outfile, literal, container,
+                              block_size);
+    }
 
-    printf("All done!\n");
+    if (status == 0)
+        printf("All done!\n");
 
-    return 0;
+    return status;
 }
-
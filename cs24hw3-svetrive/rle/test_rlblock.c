@@ -0,0 +1,179 @@
+/*
+ * Tests for the block-indexed container.  Random inputs are encoded with a
+ * range of block sizes, then decoded whole with different thread counts
+ * and in random ranges, and every result is compared with the input.
+ * Damaged headers and indexes must be rejected by rl_block_open().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rl_block.h"
+
+
+/*! The size of every random input. */
+#define INPUT_SIZE 100000
+
+/*! How many random ranges are read from each container. */
+#define NUM_READS 200
+
+
+static int block_sizes[] = { 1, 7, 64, 1000, 4096, INPUT_SIZE, 2 * INPUT_SIZE };
+#define NUM_BLOCK_SIZES ((int) (sizeof(block_sizes) / sizeof(block_sizes[0])))
+
+
+/*! Fills "input" with runs of random bytes, mostly short, some long. */
+void random_input(unsigned char *input, int length) {
+    int i = 0, run;
+
+    while (i < length) {
+        run = (rand() % 8 == 0) ? 1 + rand() % 600 : 1 + rand() % 8;
+        if (run > length - i)
+            run = length - i;
+        memset(input + i, rand() % 256, run);
+        i += run;
+    }
+}
+
+
+/*!
+ * Encodes "input" with one block size and checks every way of decoding
+ * it.  Returns the number of failures.
+ */
+int check_block_size(unsigned char *input, int length, int block_size) {
+    unsigned char *container, *output;
+    uint64_t container_length, offset, want;
+    rl_block_file f;
+    int threads, i, failures = 0;
+    int64_t got;
+
+    container = rl_block_encode(input, length, block_size, &container_length);
+    if (container == NULL || rl_block_open(&f, container,
+                                           container_length) != 0) {
+        printf("Block size %d:  couldn't encode and open\n", block_size);
+        free(container);
+        return 1;
+    }
+
+    output = malloc(length + 1);
+
+    for (threads = 1; threads <= 4; threads++) {
+        memset(output, 0, length);
+        if (rl_block_decode(&f, output, threads) != 0 ||
+            memcmp(output, input, length) != 0) {
+            printf("Block size %d, %d threads:  decode FAIL\n",
+                   block_size, threads);
+            failures++;
+        }
+    }
+
+    for (i = 0; i < NUM_READS; i++) {
+        offset = rand() % (length + 10);
+        want = (i % 4 == 0) ? rand() % (3 * block_size + 1) : rand() % 100;
+        if (want > (uint64_t) length)
+            want = length;
+
+        got = rl_block_read(&f, offset, output, want);
+        if (offset >= (uint64_t) length) {
+            if (got != 0)
+                failures++;
+            continue;
+        }
+        if (want > length - offset)
+            want = length - offset;
+        if (got != (int64_t) want || memcmp(output, input + offset, want) != 0) {
+            printf("Block size %d:  read of %lu bytes at %lu FAIL\n",
+                   block_size, (unsigned long) want, (unsigned long) offset);
+            failures++;
+        }
+    }
+
+    free(output);
+    free(container);
+    return failures;
+}
+
+
+/*!
+ * Damages one field of a good container at a time, and checks that each
+ * one is rejected.  Returns the number of failures.
+ */
+int run_damage_tests(unsigned char *input) {
+    unsigned char *good, *bad, *output;
+    uint64_t length;
+    rl_block_header *header;
+    rl_block_entry *index;
+    rl_block_file f;
+    int test, failures = 0;
+
+    good = rl_block_encode(input, 10000, 1000, &length);
+    bad = malloc(length);
+
+    for (test = 0; test < 7; test++) {
+        memcpy(bad, good, length);
+        header = (rl_block_header *) bad;
+        index = (rl_block_entry *) (bad + header->index_offset);
+
+        switch (test) {
+        case 0: bad[0] = 'X'; break;
+        case 1: header->version = 99; break;
+        case 2: header->block_size = 0; break;
+        case 3: header->num_blocks++; break;
+        case 4: header->index_offset = length + 8; break;
+        case 5: index[3].encoded_offset = index[5].encoded_offset; break;
+        case 6: index[2].decoded_offset++; break;
+        }
+
+        if (rl_block_open(&f, bad, length) == 0) {
+            printf("Damaged container %d:\tFAIL\n", test);
+            failures++;
+        }
+    }
+
+    if (rl_block_open(&f, good, length) != 0 ||
+        rl_block_open(&f, good, length - 1) == 0) {
+        printf("Undamaged or truncated container:\tFAIL\n");
+        failures++;
+    }
+
+    /* A damaged run count leaves the index alone, but the block no longer
+     * decodes to the right length.
+     */
+    memcpy(bad, good, length);
+    bad[sizeof(rl_block_header)]--;
+    output = malloc(10000);
+    if (rl_block_open(&f, bad, length) != 0 ||
+        rl_block_decode(&f, output, 1) == 0) {
+        printf("Damaged block:\tFAIL\n");
+        failures++;
+    }
+    free(output);
+
+    free(good);
+    free(bad);
+    return failures;
+}
+
+
+int main() {
+    unsigned char *input = malloc(INPUT_SIZE);
+    int k, failures = 0;
+
+    srand(24);
+    random_input(input, INPUT_SIZE);
+
+    for (k = 0; k < NUM_BLOCK_SIZES; k++)
+        failures += check_block_size(input, INPUT_SIZE, block_sizes[k]);
+    failures += check_block_size(input, 0, 64);
+    if (failures == 0)
+        printf("Container tests:\tPASS\n");
+
+    k = run_damage_tests(input);
+    if (k == 0)
+        printf("Damage tests:\tPASS\n");
+    failures += k;
+
+    free(input);
+    return failures != 0;
+}
@@ -11,6 +11,7 @@
 #include <ctype.h>
 
 #include "rl_decode.h"
+#include "rl_literal.h"
 
 
 /*!
@@ -98,14 +99,28 @@ void print_buf(unsigned char *buf, int length) {
 }
 
 
+/*! The signature shared by every variant of the decoder. */
+typedef unsigned char * (*decoder_fn)(unsigned char *input_data,
+                                      int input_length, int *output_length);
+
+
+/*! One variant of the decoder, and whether this CPU can run it. */
+typedef struct decoder {
+    const char *name;
+    decoder_fn decode;
+    int supported;
+} decoder;
+
+
 /*!
- * Main entry-point for testing that the RLE decoder works.
+ * Runs every test case in the tests[] table against one decoder, printing
+ * the results.  Returns the number of failures.
  */
-int main() {
+int run_table_tests(decoder_fn decode) {
     /* The input and expected/actual outputs of the function. */
     unsigned char *actual;
     int input_length, expected_length, actual_length;
-    int i;
+    int i, failures = 0;
 
     i = 0;
     while (tests[i].decoded_str != NULL) {
@@ -115,7 +130,7 @@ int main() {
         expected_length = strlen(tests[i].decoded_str);
 
         actual_length = -100;
-        actual = rl_decode(tests[i].encoded_str, input_length, &actual_length);
+        actual = decode(tests[i].encoded_str, input_length, &actual_length);
 
         if (expected_length != actual_length) {
             printf("\tFAIL:  actual size %d doesn't match expected size %d\n",
@@ -126,6 +141,7 @@ int main() {
             printf("\nActual output:    ");
             print_buf(actual, actual_length);
             printf("\n\n");
+            failures++;
         }
         else if (memcmp(tests[i].decoded_str, actual, expected_length) != 0) {
             /* Must use memcmp(), not strcmp(), since the generated output is
@@ -139,6 +155,7 @@ int main() {
             printf("\nActual output:    ");
             print_buf(actual, actual_length);
             printf("\n\n");
+            failures++;
         }
         else {
             printf("\tPASS\n\n");
@@ -150,6 +167,147 @@ int main() {
         i++;
     }
 
-    return 0;
+    return failures;
+}
+
+
+/*!
+ * Decodes randomly generated inputs of every length from 0 to 200 pairs,
+ * so the vector variants' block loops end at every possible offset, and
+ * checks the output against the expected expansion.  Returns the number of
+ * failures.
+ */
+int run_random_tests(decoder_fn decode) {
+    unsigned char input[400], expected[200 * 255];
+    unsigned char *actual;
+    int pairs, i, j, expected_length, actual_length;
+    int failures = 0;
+
+    srand(24);
+    for (pairs = 0; pairs <= 200; pairs++) {
+        expected_length = 0;
+        for (i = 0; i < pairs; i++) {
+            /* Mostly short runs, with some that need several stores. */
+            input[2 * i] = (rand() % 4 == 0) ? 1 + rand() % 255 : 1 + rand() % 8;
+            input[2 * i + 1] = rand() % 256;
+            for (j = 0; j < input[2 * i]; j++)
+                expected[expected_length++] = input[2 * i + 1];
+        }
+
+        actual = decode(input, 2 * pairs, &actual_length);
+        if (actual_length != expected_length ||
+            memcmp(actual, expected, expected_length) != 0) {
+            printf("Random test with %d pairs:\tFAIL\n", pairs);
+            failures++;
+        }
+        free(actual);
+    }
+
+    if (failures == 0)
+        printf("Random tests:\tPASS\n\n");
+    return failures;
+}
+
+
+/*!
+ * A test case in the literal-run format.  The encoded data starts with a
+ * zero byte, so its length has to be given.
+ */
+typedef struct literal_case {
+    unsigned char encoded[40];
+    int encoded_length;
+    unsigned char *decoded_str;
+} literal_case;
+
+
+literal_case literal_tests[] = {
+    /* A literal, a run of 5, then a two-byte varint run of 200. */
+    { {0, 'R', 'L', '2', 0xd0, 0x01,
+       (2 << 1) | 1, 'x', 'y', 'z',
+       4 << 1, 'A',
+       0x8e, 0x03, 'B'},
+      15,
+      "xyzAAAAA"
+      "BBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBB"
+      "BBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBB"
+      "BBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBB"
+    },
+
+    /* Nothing at all. */
+    { {0, 'R', 'L', '2', 0}, 5, "" },
+
+    /* Truncated in the middle of a literal:  decode what is there. */
+    { {0, 'R', 'L', '2', 10, (9 << 1) | 1, 'a', 'b', 'c'}, 9, "" },
+
+    /* A token longer than the decoded length stops decoding. */
+    { {0, 'R', 'L', '2', 3, 1 << 1, 'q', 5 << 1, 'r'}, 9, "qq" },
+
+    { {0}, 0, NULL }
+};
+
+
+/*!
+ * Decodes the literal-format cases through rl_decode(), which has to spot
+ * the tag.  Returns the number of failures.
+ */
+int run_literal_tests(void) {
+    unsigned char *actual;
+    int i, expected_length, actual_length, failures = 0;
+
+    for (i = 0; literal_tests[i].decoded_str != NULL; i++) {
+        expected_length = strlen((char *) literal_tests[i].decoded_str);
+        actual = rl_decode(literal_tests[i].encoded,
+                           literal_tests[i].encoded_length, &actual_length);
+
+        if (actual_length != expected_length ||
+            memcmp(actual, literal_tests[i].decoded_str,
+                   expected_length) != 0) {
+            printf("Literal-format test case %d:\tFAIL\n", i);
+            printf("\nExpected output:  ");
+            print_buf(literal_tests[i].decoded_str, expected_length);
+            printf("\nActual output:    ");
+            print_buf(actual, actual_length);
+            printf("\n\n");
+            failures++;
+        }
+        free(actual);
+    }
+
+    if (failures == 0)
+        printf("Literal-format tests:\tPASS\n\n");
+    return failures;
 }
 
+
+/*!
+ * Main entry-point for testing that the RLE decoder works.  Every variant
+ * this CPU supports is tested, followed by rl_decode() itself.
+ */
+int main() {
+    decoder decoders[] = {
+        { "scalar", rl_decode_scalar, 1 },
+        { "sse2", rl_decode_sse2, 1 },
+        { "avx2", rl_decode_avx2, 0 },
+        { "rl_decode", rl_decode, 1 },
+        { NULL, NULL, 0 }
+    };
+    int d, failures = 0;
+
+    decoders[2].supported = rl_has_avx2();
+
+    for (d = 0; decoders[d].name != NULL; d++) {
+        printf("=== Decoder:  %s\n\n", decoders[d].name);
+        if (!decoders[d].supported) {
+            printf("Not supported on this CPU; skipping.\n\n");
+            continue;
+        }
+
+        failures += run_table_tests(decoders[d].decode);
+        failures += run_random_tests(decoders[d].decode);
+    }
+
+    printf("=== Literal-run format\n\n");
+    failures += run_literal_tests();
+
+    return failures != 0;
+}
@@ -0,0 +1,301 @@
+/*
+ * Tests for the RLE encoder.  Every variant must produce exactly the bytes
+ * the original scalar loop produces, and that output must decode back to
+ * the input.  The literal-run variants must stay within their bound and
+ * decode back to the input through rl_decode().  The inputs are sized and
+ * shaped so that runs start and end at every offset around the vector
+ * variants' 64-byte blocks, and so that runs longer than 255 bytes are split
+ * the same way everywhere.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rl_decode.h"
+#include "rl_encode.h"
+#include "rl_literal.h"
+
+
+/*! The largest input any test encodes. */
+#define MAX_INPUT 2048
+
+
+/*! The signature shared by every variant of the encoder. */
+typedef uint64_t (*encoder_fn)(const unsigned char *input_data,
+                               uint64_t input_length, unsigned char *output);
+
+
+/*! One variant of the encoder, and whether this CPU can run it. */
+typedef struct encoder {
+    const char *name;
+    encoder_fn encode;
+    int supported;
+    int literal;        /*!< Writes the literal-run format. */
+} encoder;
+
+
+/*! The variant being tested writes the literal-run format. */
+int literal_format;
+
+
+/*!
+ * Encodes "input" with one variant and decodes it again.  Output in the
+ * original format is also compared against the scalar encoder, and output
+ * in the literal format must stay within its bound.  Returns nonzero if
+ * anything differs.
+ */
+int check_input(encoder_fn encode, unsigned char *input, int length) {
+    unsigned char expected[RL_ENCODE_BOUND(MAX_INPUT)];
+    unsigned char actual[RL_ENCODE_BOUND(MAX_INPUT)];
+    unsigned char *decoded;
+    int expected_length, actual_length, decoded_length;
+    int failed = 0;
+
+    actual_length = encode(input, length, actual);
+
+    if (literal_format) {
+        if (actual_length > (int) RL_LITERAL_BOUND(length))
+            return 1;
+    }
+    else {
+        expected_length = rl_encode_scalar(input, length, expected);
+        if (actual_length != expected_length ||
+            memcmp(actual, expected, expected_length) != 0) {
+            return 1;
+        }
+    }
+
+    decoded = rl_decode(actual, actual_length, &decoded_length);
+    if (decoded_length != length || memcmp(decoded, input, length) != 0)
+        failed = 1;
+    free(decoded);
+
+    return failed;
+}
+
+
+/*!
+ * A single run of every length from 0 up past two splits, followed by a
+ * different byte at every position in a run, so every boundary position in
+ * a block and every split point is covered.  Returns the number of failures.
+ */
+int run_edge_tests(encoder_fn encode) {
+    unsigned char input[MAX_INPUT];
+    int length, pos, failures = 0;
+
+    for (length = 0; length <= 600; length++) {
+        memset(input, 'A', length);
+        if (check_input(encode, input, length)) {
+            printf("Single run of %d bytes:\tFAIL\n", length);
+            failures++;
+        }
+    }
+
+    for (pos = 0; pos < 200; pos++) {
+        memset(input, 'A', 200);
+        input[pos] = 'B';
+        if (check_input(encode, input, 200)) {
+            printf("Lone byte at offset %d:\tFAIL\n", pos);
+            failures++;
+        }
+    }
+
+    if (failures == 0)
+        printf("Edge tests:\tPASS\n\n");
+    return failures;
+}
+
+
+/*!
+ * Encodes randomly generated inputs of every length up to MAX_INPUT, with
+ * runs drawn from a few different distributions:  all short runs, a mix of
+ * short and long runs, runs over only two byte values so neighbouring runs
+ * often look alike, and mostly single bytes with the odd run of two to
+ * four, so whole blocks hold nothing but runs of one or two.  Returns the
+ * number of failures.
+ */
+int run_random_tests(encoder_fn encode) {
+    unsigned char input[MAX_INPUT];
+    int length, i, run, style;
+    int failures = 0;
+
+    srand(24);
+    for (length = 0; length <= MAX_INPUT; length += 1 + length / 64) {
+        for (style = 0; style < 4; style++) {
+            i = 0;
+            while (i < length) {
+                if (style == 1 && rand() % 8 == 0)
+                    run = 1 + rand() % 600;
+                else if (style == 3)
+                    run = (rand() % 32 == 0) ? 2 + rand() % 3 : 1;
+                else
+                    run = 1 + rand() % 8;
+                if (run > length - i)
+                    run = length - i;
+                memset(input + i, (style == 2) ? rand() % 2 : rand() % 256,
+                       run);
+                i += run;
+            }
+
+            if (check_input(encode, input, length)) {
+                printf("Random test of %d bytes, style %d:\tFAIL\n",
+                       length, style);
+                failures++;
+            }
+        }
+    }
+
+    if (failures == 0)
+        printf("Random tests:\tPASS\n\n");
+    return failures;
+}
+
+
+/*!
+ * Checks that the literal format keeps bytes with no runs in them to their
+ * own size plus a few bytes of headers, and shrinks long runs to a few
+ * bytes no matter how long they are.  Returns the number of failures.
+ */
+int run_literal_size_tests(void) {
+    unsigned char input[MAX_INPUT];
+    unsigned char output[RL_LITERAL_BOUND(MAX_INPUT)];
+    int i, length, failures = 0;
+
+    for (i = 0; i < MAX_INPUT; i++)
+        input[i] = (unsigned char) (i * 7);
+    length = rl_encode_literal_buffer(input, MAX_INPUT, output);
+    if (length > MAX_INPUT + 10) {
+        printf("Literal format, no runs:  %d bytes for %d\tFAIL\n",
+               length, MAX_INPUT);
+        failures++;
+    }
+
+    memset(input, 'A', MAX_INPUT);
+    length = rl_encode_literal_buffer(input, MAX_INPUT, output);
+    if (length > 10) {
+        printf("Literal format, one run:  %d bytes for %d\tFAIL\n",
+               length, MAX_INPUT);
+        failures++;
+    }
+
+    if (failures == 0)
+        printf("Literal format sizes:\tPASS\n\n");
+    return failures;
+}
+
+
+/*!
+ * Feeds inputs to the streaming encoder in chunks of many sizes, so runs
+ * of every length, some longer than 255 bytes, are split across chunks at
+ * every offset.  The output must be exactly what rl_encode_buffer() writes
+ * for the whole input, and no call may write more than its bound.  Returns
+ * the number of failures.
+ */
+int run_chunk_tests(void) {
+    unsigned char input[MAX_INPUT];
+    unsigned char expected[RL_ENCODE_BOUND(MAX_INPUT)];
+    unsigned char actual[RL_ENCODE_BOUND(MAX_INPUT) + 2];
+    uint64_t expected_length, actual_length, written;
+    int chunk, pos, n, i, run, round, failures = 0;
+    rl_encoder e;
+
+    srand(24);
+    for (round = 0; round < 4; round++) {
+        i = 0;
+        while (i < MAX_INPUT) {
+            run = (rand() % 4 == 0) ? 1 + rand() % 700 : 1 + rand() % 4;
+            if (run > MAX_INPUT - i)
+                run = MAX_INPUT - i;
+            memset(input + i, (round == 3) ? rand() % 2 : rand() % 256, run);
+            i += run;
+        }
+        expected_length = rl_encode_buffer(input, MAX_INPUT, expected);
+
+        for (chunk = 1; chunk <= MAX_INPUT; chunk += 1 + chunk / 4) {
+            rl_encoder_init(&e);
+            actual_length = 0;
+            for (pos = 0; pos < MAX_INPUT; pos += n) {
+                n = (MAX_INPUT - pos < chunk) ? MAX_INPUT - pos : chunk;
+                written = rl_encoder_feed(&e, input + pos, n,
+                                          actual + actual_length);
+                if (written > RL_ENCODER_BOUND(n))
+                    break;
+                actual_length += written;
+            }
+            actual_length += rl_encoder_finish(&e, actual + actual_length);
+
+            if (pos < MAX_INPUT || actual_length != expected_length ||
+                memcmp(actual, expected, expected_length) != 0) {
+                printf("Chunks of %d bytes, round %d:\tFAIL\n",
+                       chunk, round);
+                failures++;
+            }
+        }
+    }
+
+    if (failures == 0)
+        printf("Streaming encoder:\tPASS\n\n");
+    return failures;
+}
+
+
+/*! Checks that rl_encode() returns a buffer holding the encoded input. */
+int run_alloc_test(void) {
+    unsigned char input[] = "AAABBBBBBBBBBBBCDDDD";
+    unsigned char expected[] = { 3, 'A', 12, 'B', 1, 'C', 4, 'D' };
+    unsigned char *actual;
+    uint64_t actual_length = 0;
+
+    actual = rl_encode(input, strlen((char *) input), &actual_length);
+    if (actual == NULL || actual_length != sizeof(expected) ||
+        memcmp(actual, expected, sizeof(expected)) != 0) {
+        printf("rl_encode:\tFAIL\n\n");
+        free(actual);
+        return 1;
+    }
+
+    printf("rl_encode:\tPASS\n\n");
+    free(actual);
+    return 0;
+}
+
+
+/*!
+ * Main entry-point for testing that the RLE encoder works.  Every variant
+ * this CPU supports is tested in both formats, followed by the dispatching
+ * functions themselves.
+ */
+int main() {
+    encoder encoders[] = {
+        { "sse2", rl_encode_sse2, 1, 0 },
+        { "avx2", rl_encode_avx2, 0, 0 },
+        { "rl_encode_buffer", rl_encode_buffer, 1, 0 },
+        { "literal sse2", rl_encode_literal_sse2, 1, 1 },
+        { "literal avx2", rl_encode_literal_avx2, 0, 1 },
+        { "rl_encode_literal_buffer", rl_encode_literal_buffer, 1, 1 },
+        { NULL, NULL, 0, 0 }
+    };
+    int e, failures = 0;
+
+    encoders[1].supported = rl_has_avx2();
+    encoders[4].supported = rl_has_avx2();
+
+    for (e = 0; encoders[e].name != NULL; e++) {
+        printf("=== Encoder:  %s\n\n", encoders[e].name);
+        if (!encoders[e].supported) {
+            printf("Not supported on this CPU; skipping.\n\n");
+            continue;
+        }
+
+        literal_format = encoders[e].literal;
+        failures += run_edge_tests(encoders[e].encode);
+        failures += run_random_tests(encoders[e].encode);
+    }
+
+    failures += run_literal_size_tests();
+    failures += run_chunk_tests();
+    failures += run_alloc_test();
+
+    return failures != 0;
+}
@@ -0,0 +1,232 @@
+/*
+ * Tests for the streaming decoder.  Each input is fed in chunks of every
+ * size from one byte up, so pairs are split at every possible place, and
+ * the output the sink receives must match what rl_decode() produces for
+ * the whole input at once.  The inputs decode to several times the size of
+ * the stream's buffer, so flushes happen in the middle of the input too.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rl_decode.h"
+#include "rl_literal.h"
+#include "rl_stream.h"
+
+
+/*! How many pairs each random input has. */
+#define NUM_PAIRS 3000
+
+
+/*! Where the sink collects the decoded output. */
+typedef struct collector {
+    unsigned char *data;
+    long long length;
+    long long capacity;
+    int calls;
+    int fail_after;     /*!< The sink fails on this call, or never if 0. */
+} collector;
+
+
+int collect(void *ctx, const unsigned char *data, int length) {
+    collector *c = (collector *) ctx;
+
+    c->calls++;
+    if (c->fail_after != 0 && c->calls >= c->fail_after)
+        return 1;
+
+    if (length > RL_STREAM_BUFFER || c->length + length > c->capacity)
+        return 1;
+    memcpy(c->data + c->length, data, length);
+    c->length += length;
+    return 0;
+}
+
+
+/*!
+ * Fills "input" with "pairs" random pairs, mostly short runs with some
+ * long ones, and some zero-length runs.
+ */
+void random_input(unsigned char *input, int pairs) {
+    int i;
+
+    for (i = 0; i < pairs; i++) {
+        switch (rand() % 8) {
+        case 0:
+            input[2 * i] = 1 + rand() % 255;
+            break;
+        case 1:
+            input[2 * i] = (rand() % 4 == 0) ? 0 : 255;
+            break;
+        default:
+            input[2 * i] = 1 + rand() % 8;
+        }
+        input[2 * i + 1] = rand() % 256;
+    }
+}
+
+
+/*!
+ * Decodes "input" through a stream, "chunk" bytes at a time.  Returns
+ * nonzero if the output differs from "expected".
+ */
+int check_chunks(unsigned char *input, int length, int chunk,
+                 unsigned char *expected, int expected_length) {
+    static rl_stream stream;
+    collector c;
+    int pos, n, failed;
+
+    c.capacity = expected_length;
+    c.data = malloc(c.capacity + 1);
+    c.length = 0;
+    c.calls = 0;
+    c.fail_after = 0;
+
+    rl_stream_init(&stream, collect, &c);
+    for (pos = 0; pos < length; pos += chunk) {
+        n = (length - pos < chunk) ? length - pos : chunk;
+        if (rl_stream_feed(&stream, input + pos, n) != 0)
+            break;
+    }
+
+    failed = rl_stream_finish(&stream) != 0 ||
+             c.length != expected_length ||
+             stream.output_length != expected_length ||
+             memcmp(c.data, expected, expected_length) != 0;
+
+    free(c.data);
+    return failed;
+}
+
+
+/*!
+ * Decodes "input" with every chunk size up to a few hundred bytes, and a
+ * few much larger ones.  Returns the number of failures.
+ */
+int check_all_chunks(unsigned char *input, int length, const char *name) {
+    unsigned char *expected;
+    int expected_length, chunk, failures = 0;
+
+    expected = rl_decode(input, length, &expected_length);
+    for (chunk = 1; chunk <= 2 * length; chunk += (chunk < 300) ? 1 : chunk) {
+        if (check_chunks(input, length, chunk, expected, expected_length)) {
+            printf("%s with %d-byte chunks:\tFAIL\n", name, chunk);
+            failures++;
+        }
+    }
+    free(expected);
+
+    return failures;
+}
+
+
+/*!
+ * Decodes random inputs in both formats.  The literal-format inputs are
+ * made by encoding the decoded random pairs again, which gives a mix of
+ * runs and literals.  Returns the number of failures.
+ */
+int run_chunk_tests(void) {
+    unsigned char input[2 * NUM_PAIRS];
+    unsigned char *decoded, *literal;
+    uint64_t literal_length;
+    int decoded_length, round, failures = 0;
+
+    srand(24);
+    for (round = 0; round < 4; round++) {
+        random_input(input, NUM_PAIRS);
+        failures += check_all_chunks(input, sizeof(input), "Original");
+
+        decoded = rl_decode(input, sizeof(input), &decoded_length);
+        literal = rl_encode_literal(decoded, decoded_length, &literal_length);
+        failures += check_all_chunks(literal, literal_length, "Literal");
+        free(literal);
+        free(decoded);
+    }
+
+    /* Inputs shorter than the tag, some of which start out like it. */
+    failures += check_all_chunks((unsigned char *) "", 0, "Empty");
+    failures += check_all_chunks((unsigned char *) "\0R", 2, "Short");
+    failures += check_all_chunks((unsigned char *) "\0RL\0", 4, "Near-tag");
+
+    if (failures == 0)
+        printf("Chunk tests:\tPASS\n\n");
+    return failures;
+}
+
+
+/*!
+ * Checks the error cases:  input that ends halfway through a pair, and a
+ * sink that stops accepting output.  Returns the number of failures.
+ */
+int run_error_tests(void) {
+    static rl_stream stream;
+    unsigned char input[2 * NUM_PAIRS];
+    collector c;
+    int failures = 0;
+
+    c.capacity = 255LL * NUM_PAIRS;
+    c.data = malloc(c.capacity);
+
+    /* A dangling count byte at the end of the input. */
+    c.length = 0;
+    c.calls = 0;
+    c.fail_after = 0;
+    input[0] = 3;
+    input[1] = 'A';
+    input[2] = 5;
+    rl_stream_init(&stream, collect, &c);
+    if (rl_stream_feed(&stream, input, 3) != 0 ||
+        rl_stream_finish(&stream) == 0 || c.length != 3) {
+        printf("Truncated input:\tFAIL\n");
+        failures++;
+    }
+    else {
+        printf("Truncated input:\tPASS\n");
+    }
+
+    /* The sink fails on its second call; decoding must stop there. */
+    c.length = 0;
+    c.calls = 0;
+    c.fail_after = 2;
+    memset(input, 255, sizeof(input));
+    rl_stream_init(&stream, collect, &c);
+    if (rl_stream_feed(&stream, input, sizeof(input)) == 0 ||
+        rl_stream_feed(&stream, input, 2) == 0 ||
+        rl_stream_finish(&stream) == 0 || c.calls != 2) {
+        printf("Failing sink:\tFAIL\n");
+        failures++;
+    }
+    else {
+        printf("Failing sink:\tPASS\n");
+    }
+
+    /* A literal-format stream that stops short of its decoded length. */
+    c.length = 0;
+    c.calls = 0;
+    c.fail_after = 0;
+    memcpy(input, RL_LITERAL_TAG "\x08\x07" "ab", 8);
+    rl_stream_init(&stream, collect, &c);
+    if (rl_stream_feed(&stream, input, 8) != 0 ||
+        rl_stream_finish(&stream) == 0) {
+        printf("Truncated literal:\tFAIL\n");
+        failures++;
+    }
+    else {
+        printf("Truncated literal:\tPASS\n");
+    }
+    printf("\n");
+
+    free(c.data);
+    return failures;
+}
+
+
+int main() {
+    int failures = 0;
+
+    failures += run_chunk_tests();
+    failures += run_error_tests();
+
+    return failures != 0;
+}
@@ -20,6 +20,16 @@
 #include "branch_unit.h"
 
 
+/*!
+ * This constant specifies the longest that a program may execute before the
+ * processor terminates.  Since this processor includes branching, we can't just
+ * run until we hit the instruction store depth; instead, we set a "max execute
+ * time," beyond which we assume that the program has a bug like an infinite
+ * loop in it.
+ */
+#define MAX_EXECUTE_TIME 100
+
+
 /*!
  * This struct encapsulates all of the components of the branching processor.
  */
@@ -0,0 +1,229 @@
+/*! \file
+ *
+ * This file contains the definitions for the fast mode of the branching
+ * processor.
+ *
+ * The instruction store is decoded once, into an array of FastOp structs, one
+ * per address.  Each op holds the address of the interpreter code that carries
+ * it out, so after each op, the interpreter jumps straight to the code for the
+ * next one (a "direct-threaded" interpreter, using GCC's computed goto).  There
+ * is no decoding, no switch, and no bus traffic left in the loop; the registers
+ * are a plain array, and the ALU status is a local variable.
+ *
+ * Each op does exactly what one clock of the bus-level model does:
+ *
+ *  - One-argument ops and the two-argument ALU ops write their result to the
+ *    destination register and set the status to whether the result was 0.
+ *  - MOV writes its result but leaves the status alone, as do the branches and
+ *    DONE, so a branch tests the status of the last ALU op before it.
+ *  - The two-argument ops come in a register and a constant version, since the
+ *    decoder already knows which kind of src1 each one has.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+
+#include "fast_processor.h"
+#include "instruction.h"
+
+
+/*!
+ * Decodes the instruction store into "ops", which must have room for
+ * FAST_PROGRAM_LENGTH ops.  The fields are filled in the same way that
+ * fetch_and_decode() fills in its output pins.  The code addresses are left
+ * for fast_run() to fill in.
+ */
+void fast_decode(InstructionStore *is, FastOp *ops) {
+    /* The instruction bytes, with zeroes after the end of the store. */
+    uint8_t bytes[FAST_PROGRAM_LENGTH + 1];
+    uint8_t instr_byte, operation, reg;
+    int addr, length;
+
+    memset(bytes, 0, sizeof(bytes));
+    memcpy(bytes, is->imemory, INSTRUCTION_STORE_DEPTH);
+
+    for (addr = 0; addr < FAST_PROGRAM_LENGTH; addr++) {
+        FastOp *op = &ops[addr];
+
+        instr_byte = bytes[addr];
+        operation = instr_byte >> 4;
+        reg = instr_byte & 0x07;
+        length = 1;
+
+        memset(op, 0, sizeof(FastOp));
+        op->dst = reg;
+        op->src1 = reg;
+
+        switch (operation) {
+
+          case OP_DONE: op->kind = FAST_DONE; break;
+
+          case OP_INC:  op->kind = FAST_INC;  break;
+          case OP_DEC:  op->kind = FAST_DEC;  break;
+          case OP_NEG:  op->kind = FAST_NEG;  break;
+          case OP_INV:  op->kind = FAST_INV;  break;
+          case OP_SHL:  op->kind = FAST_SHL;  break;
+          case OP_SHR:  op->kind = FAST_SHR;  break;
+
+          case OP_MOV:
+          case OP_ADD:
+          case OP_SUB:
+          case OP_AND:
+          case OP_OR:
+          case OP_XOR:
+            /* The second byte holds the src1 register or constant. */
+            length = 2;
+            op->src1 = bytes[addr + 1] & 0x07;
+            op->constant = bytes[addr + 1];
+
+            switch (operation) {
+              case OP_MOV: op->kind = FAST_MOV_R; break;
+              case OP_ADD: op->kind = FAST_ADD_R; break;
+              case OP_SUB: op->kind = FAST_SUB_R; break;
+              case OP_AND: op->kind = FAST_AND_R; break;
+              case OP_OR:  op->kind = FAST_OR_R;  break;
+              case OP_XOR: op->kind = FAST_XOR_R; break;
+            }
+
+            /* The _C kinds are in the same order as the _R kinds. */
+            if (!(instr_byte & (1 << 3)))
+                op->kind += FAST_MOV_C - FAST_MOV_R;
+            break;
+
+          case OP_BRA:  op->kind = FAST_BRA;  break;
+          case OP_BRZ:  op->kind = FAST_BRZ;  break;
+          case OP_BNZ:  op->kind = FAST_BNZ;  break;
+        }
+
+        /* Branch addresses are the low four bits of the instruction. */
+        op->target = &ops[instr_byte & 0x0F];
+
+        /* Only OP_DONE can be decoded near the end, so "next" stays in the
+         * array for every op that uses it.
+         */
+        op->next = (addr + length < FAST_PROGRAM_LENGTH) ?
+                   &ops[addr + length] : NULL;
+    }
+}
+
+
+/*!
+ * Runs the program in the instruction store against the register file, the
+ * way run() does, but in fast mode.  The program is given the same number of
+ * clocks as run() gives it when "max_time" is MAX_EXECUTE_TIME.  Returns the
+ * number of instructions executed, including the final DONE.
+ */
+int fast_run(InstructionStore *is, RegisterFile *rf, int max_time) {
+    /* The interpreter code for each kind of op, indexed by FAST_xxx. */
+    static const void *code[FAST_NUM_KINDS] = {
+        [FAST_DONE] = &&op_done,
+        [FAST_INC] = &&op_inc,     [FAST_DEC] = &&op_dec,
+        [FAST_NEG] = &&op_neg,     [FAST_INV] = &&op_inv,
+        [FAST_SHL] = &&op_shl,     [FAST_SHR] = &&op_shr,
+        [FAST_MOV_R] = &&op_mov_r, [FAST_ADD_R] = &&op_add_r,
+        [FAST_SUB_R] = &&op_sub_r, [FAST_AND_R] = &&op_and_r,
+        [FAST_OR_R] = &&op_or_r,   [FAST_XOR_R] = &&op_xor_r,
+        [FAST_MOV_C] = &&op_mov_c, [FAST_ADD_C] = &&op_add_c,
+        [FAST_SUB_C] = &&op_sub_c, [FAST_AND_C] = &&op_and_c,
+        [FAST_OR_C] = &&op_or_c,   [FAST_XOR_C] = &&op_xor_c,
+        [FAST_BRA] = &&op_bra,     [FAST_BRZ] = &&op_brz,
+        [FAST_BNZ] = &&op_bnz
+    };
+
+    FastOp ops[FAST_PROGRAM_LENGTH];
+    const FastOp *op;
+    uint32_t regs[NUM_REGISTERS];
+    uint32_t result;
+    int status = 0;    /* 1 if the last ALU result was 0, like ALU status. */
+    long clocks = max_time - 1;   /* Clocks left; run() uses T=1..max-1. */
+    int addr;
+
+    printf("Running processor (fast mode).\n\n");
+
+    printf("T=0\tRegister File: ");
+    rfprint(stdout, rf);
+
+    fast_decode(is, ops);
+    for (addr = 0; addr < FAST_PROGRAM_LENGTH; addr++)
+        ops[addr].code = code[ops[addr].kind];
+
+    memcpy(regs, rf->rfmem, sizeof(regs));
+    op = &ops[0];
+
+/* Moves on to the op at "next_op", if there is a clock left to run it on. */
+#define DISPATCH(next_op)                   \
+    do {                                    \
+        op = (next_op);                     \
+        if (--clocks < 0)                   \
+            goto out_of_time;               \
+        goto *op->code;                     \
+    } while (0)
+
+/* Writes an ALU result to the destination, sets the status, and moves on. */
+#define ALU_RESULT(value)                   \
+    do {                                    \
+        result = (value);                   \
+        regs[op->dst] = result;             \
+        status = (result == 0);             \
+        DISPATCH(op->next);                 \
+    } while (0)
+
+    DISPATCH(op);
+
+op_inc:    ALU_RESULT(regs[op->dst] + 1);
+op_dec:    ALU_RESULT(regs[op->dst] - 1);
+op_neg:    ALU_RESULT((uint32_t) (-(int32_t) regs[op->dst]));
+op_inv:    ALU_RESULT(~regs[op->dst]);
+op_shl:    ALU_RESULT(regs[op->dst] << 1);
+op_shr:    ALU_RESULT(regs[op->dst] >> 1);
+
+op_add_r:  ALU_RESULT(regs[op->dst] + regs[op->src1]);
+op_sub_r:  ALU_RESULT(regs[op->dst] - regs[op->src1]);
+op_and_r:  ALU_RESULT(regs[op->dst] & regs[op->src1]);
+op_or_r:   ALU_RESULT(regs[op->dst] | regs[op->src1]);
+op_xor_r:  ALU_RESULT(regs[op->dst] ^ regs[op->src1]);
+
+op_add_c:  ALU_RESULT(regs[op->dst] + op->constant);
+op_sub_c:  ALU_RESULT(regs[op->dst] - op->constant);
+op_and_c:  ALU_RESULT(regs[op->dst] & op->constant);
+op_or_c:   ALU_RESULT(regs[op->dst] | op->constant);
+op_xor_c:  ALU_RESULT(regs[op->dst] ^ op->constant);
+
+op_mov_r:
+    regs[op->dst] = regs[op->src1];
+    DISPATCH(op->next);
+
+op_mov_c:
+    regs[op->dst] = op->constant;
+    DISPATCH(op->next);
+
+op_bra:
+    DISPATCH(op->target);
+
+op_brz:
+    DISPATCH(status ? op->target : op->next);
+
+op_bnz:
+    DISPATCH(status ? op->next : op->target);
+
+#undef ALU_RESULT
+#undef DISPATCH
+
+op_done:
+out_of_time:
+    memcpy(rf->rfmem, regs, sizeof(regs));
+
+    printf("Register File: ");
+    rfprint(stdout, rf);
+
+    printf("\n");
+    if (clocks < 0) {
+        printf("ERROR:  Max execute time reached.\n"
+               "Does your program have an infinite loop in it?\n");
+        return max_time - 1;
+    }
+
+    printf("Program terminated normally.\n");
+    return max_time - 1 - clocks;
+}
@@ -0,0 +1,64 @@
+/*! \file
+ *
+ * This file contains the declarations for the fast mode of the branching
+ * processor.  Rather than moving every value over the buses between the
+ * components on each clock, the fast mode decodes the whole instruction store
+ * once, and then runs the decoded program directly against an array of
+ * registers.  It ends with the same register file as the bus-level model.
+ */
+
+
+#ifndef FAST_PROCESSOR_H
+#define FAST_PROCESSOR_H
+
+
+#include "instruction_store.h"
+#include "register_file.h"
+
+
+/*!
+ * The kinds of predecoded op.  Two-argument ops have a version for a register
+ * src1 (_R) and for a constant src1 (_C).
+ */
+enum {
+    FAST_DONE,
+    FAST_INC, FAST_DEC, FAST_NEG, FAST_INV, FAST_SHL, FAST_SHR,
+    FAST_MOV_R, FAST_ADD_R, FAST_SUB_R, FAST_AND_R, FAST_OR_R, FAST_XOR_R,
+    FAST_MOV_C, FAST_ADD_C, FAST_SUB_C, FAST_AND_C, FAST_OR_C, FAST_XOR_C,
+    FAST_BRA, FAST_BRZ, FAST_BNZ,
+    FAST_NUM_KINDS
+};
+
+
+/*!
+ * One predecoded instruction.  Since a branch can land on any address, there
+ * is one of these for every address in the instruction store, decoded as if
+ * an instruction started there.  The operands are what the decoder would have
+ * put on its output pins, and "next" and "target" point straight at the
+ * instructions the program counter would move to.
+ */
+typedef struct FastOp {
+    const void *code;              /*!< The interpreter's code for the op. */
+    const struct FastOp *next;     /*!< The instruction that follows this one. */
+    const struct FastOp *target;   /*!< Where a branch goes. */
+    uint32_t constant;             /*!< The constant src1, if there is one. */
+    uint8_t kind;                  /*!< Which FAST_xxx operation this is. */
+    uint8_t src1;                  /*!< The src1 register. */
+    uint8_t dst;                   /*!< The src2 and destination register. */
+} FastOp;
+
+
+/*!
+ * There are two extra ops past the end of the instruction store, since the
+ * last instruction may be two bytes long, and the program counter may then
+ * move past both of them.  The bytes there read as zero, which is OP_DONE.
+ */
+#define FAST_PROGRAM_LENGTH (INSTRUCTION_STORE_DEPTH + 2)
+
+
+/* Documentation appears in fast_processor.c. */
+void fast_decode(InstructionStore *is, FastOp *ops);
+int fast_run(InstructionStore *is, RegisterFile *rf, int max_time);
+
+
+#endif /* FAST_PROCESSOR_H */
@@ -0,0 +1,354 @@
+/*! \file
+ *
+ * This file contains the definitions for the JIT compiler of the branching
+ * processor.
+ *
+ * The program is decoded with fast_decode(), so, like the fast mode, there is
+ * one translated instruction for every address in the instruction store, laid
+ * out in address order.  The generated code keeps the processor state in host
+ * registers:
+ *
+ *  - The eight processor registers live in r8d through r15d, so register n
+ *    is host register 8 + n, and its low three bits are n.
+ *  - The ALU status lives in dl:  after every ALU op, SETZ stores whether the
+ *    result was 0.  Keeping it out of the host flags means MOV, the branches
+ *    and the clock guard can't disturb it.
+ *  - rsi counts the clocks left.  Every instruction starts with a guard that
+ *    leaves the program if there are none, just as run() stops at its max
+ *    execute time.
+ *  - rdi points at the register array, which is loaded on entry and stored
+ *    back on the way out.
+ *
+ * Branches and the jump from an instruction to the one after it are emitted
+ * with 32-bit displacements, and patched once every instruction's code address
+ * is known.  An instruction that is followed directly by its successor in the
+ * code just falls through instead.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "jit.h"
+#include "fast_processor.h"
+
+
+/*! The most bytes any one translated instruction takes. */
+#define JIT_MAX_OP_BYTES 32
+
+/*! Room for the prologue and the exit paths. */
+#define JIT_EXTRA_BYTES 128
+
+
+/*! A 32-bit displacement that must be patched to point at an instruction. */
+typedef struct Fixup {
+    size_t offset;   /*!< Where the displacement is in the code. */
+    int addr;        /*!< The instruction it must point at. */
+} Fixup;
+
+
+/*! The state of a translation in progress. */
+typedef struct Emitter {
+    unsigned char *code;
+    size_t length;
+
+    /*! Where the code for each instruction starts. */
+    size_t op_offset[FAST_PROGRAM_LENGTH];
+
+    /*! Every jump to an instruction, two at most per instruction. */
+    Fixup fixups[2 * FAST_PROGRAM_LENGTH];
+    int num_fixups;
+
+    /*! Jumps to the out-of-time exit, which is emitted last. */
+    size_t timeout_fixups[FAST_PROGRAM_LENGTH];
+    int num_timeout_fixups;
+} Emitter;
+
+
+static void emit(Emitter *e, const unsigned char *bytes, size_t count) {
+    memcpy(e->code + e->length, bytes, count);
+    e->length += count;
+}
+
+static void emit_byte(Emitter *e, unsigned char byte) {
+    e->code[e->length++] = byte;
+}
+
+static void emit_u32(Emitter *e, uint32_t value) {
+    memcpy(e->code + e->length, &value, sizeof(value));
+    e->length += sizeof(value);
+}
+
+/* Emits a displacement to be patched to point at instruction "addr". */
+static void emit_fixup(Emitter *e, int addr) {
+    e->fixups[e->num_fixups].offset = e->length;
+    e->fixups[e->num_fixups].addr = addr;
+    e->num_fixups++;
+    emit_u32(e, 0);
+}
+
+/* Stores a displacement at "offset" that jumps to "target". */
+static void patch(Emitter *e, size_t offset, size_t target) {
+    int32_t rel = (int32_t) (target - (offset + 4));
+    memcpy(e->code + offset, &rel, sizeof(rel));
+}
+
+
+/* Emits "jmp" to instruction "addr", unless the code for it comes next. */
+static void emit_jump(Emitter *e, int from, int addr) {
+    if (addr == from + 1)
+        return;
+    emit_byte(e, 0xE9);                   /* jmp rel32 */
+    emit_fixup(e, addr);
+}
+
+
+/* Emits the code for one predecoded instruction at address "addr". */
+static void emit_op(Emitter *e, const FastOp *ops, int addr) {
+    const FastOp *op = &ops[addr];
+    int next = op->next ? (int) (op->next - ops) : 0;
+    int target = (int) (op->target - ops);
+    unsigned char dst = op->dst, src = op->src1;
+
+    /* The ModRM byte of each ALU op that takes a register or immediate src1:
+     * the opcode for "op r/m32, r32", and the /digit of "op r/m32, imm32".
+     */
+    static const unsigned char reg_opcode[FAST_NUM_KINDS] = {
+        [FAST_ADD_R] = 0x01, [FAST_SUB_R] = 0x29, [FAST_AND_R] = 0x21,
+        [FAST_OR_R] = 0x09,  [FAST_XOR_R] = 0x31,
+    };
+    static const unsigned char imm_digit[FAST_NUM_KINDS] = {
+        [FAST_ADD_C] = 0, [FAST_SUB_C] = 5, [FAST_AND_C] = 4,
+        [FAST_OR_C] = 1,  [FAST_XOR_C] = 6,
+    };
+
+    e->op_offset[addr] = e->length;
+
+    /* The guard:  sub rsi, 1; jb out_of_time. */
+    emit(e, (const unsigned char []) { 0x48, 0x83, 0xEE, 0x01, 0x0F, 0x82 },
+         6);
+    e->timeout_fixups[e->num_timeout_fixups++] = e->length;
+    emit_u32(e, 0);
+
+    switch (op->kind) {
+
+      case FAST_DONE:
+        /* Let the exit code after the last instruction handle it. */
+        emit_byte(e, 0xE9);
+        emit_fixup(e, FAST_PROGRAM_LENGTH);
+        return;
+
+      /* One-argument ops, as "op r32" with REX.B selecting r8d-r15d. */
+      case FAST_INC:
+        emit(e, (const unsigned char []) { 0x41, 0xFF, 0xC0 | dst }, 3);
+        break;
+      case FAST_DEC:
+        emit(e, (const unsigned char []) { 0x41, 0xFF, 0xC8 | dst }, 3);
+        break;
+      case FAST_NEG:
+        emit(e, (const unsigned char []) { 0x41, 0xF7, 0xD8 | dst }, 3);
+        break;
+      case FAST_SHL:
+        emit(e, (const unsigned char []) { 0x41, 0xD1, 0xE0 | dst }, 3);
+        break;
+      case FAST_SHR:
+        emit(e, (const unsigned char []) { 0x41, 0xD1, 0xE8 | dst }, 3);
+        break;
+
+      /* NOT leaves the flags alone, so invert with XOR r32, -1 instead. */
+      case FAST_INV:
+        emit(e, (const unsigned char []) { 0x41, 0x83, 0xF0 | dst, 0xFF }, 4);
+        break;
+
+      /* MOV leaves the status alone, so it skips the SETZ below. */
+      case FAST_MOV_R:
+        emit(e, (const unsigned char []) {
+            0x45, 0x89, 0xC0 | (src << 3) | dst }, 3);
+        emit_jump(e, addr, next);
+        return;
+
+      case FAST_MOV_C:
+        emit(e, (const unsigned char []) { 0x41, 0xB8 + dst }, 2);
+        emit_u32(e, op->constant);
+        emit_jump(e, addr, next);
+        return;
+
+      /* Two-argument ops with a register src1:  REX.R and REX.B both set. */
+      case FAST_ADD_R:
+      case FAST_SUB_R:
+      case FAST_AND_R:
+      case FAST_OR_R:
+      case FAST_XOR_R:
+        emit(e, (const unsigned char []) {
+            0x45, reg_opcode[op->kind], 0xC0 | (src << 3) | dst }, 3);
+        break;
+
+      /* Two-argument ops with a constant src1:  "op r32, imm32". */
+      case FAST_ADD_C:
+      case FAST_SUB_C:
+      case FAST_AND_C:
+      case FAST_OR_C:
+      case FAST_XOR_C:
+        emit(e, (const unsigned char []) {
+            0x41, 0x81, 0xC0 | (imm_digit[op->kind] << 3) | dst }, 3);
+        emit_u32(e, op->constant);
+        break;
+
+      case FAST_BRA:
+        emit_byte(e, 0xE9);                       /* jmp target */
+        emit_fixup(e, target);
+        return;
+
+      case FAST_BRZ:
+      case FAST_BNZ:
+        emit(e, (const unsigned char []) { 0x84, 0xD2 }, 2);  /* test dl, dl */
+        /* BRZ branches if the status is set (jnz), BNZ if it isn't (jz). */
+        emit(e, (const unsigned char []) {
+            0x0F, op->kind == FAST_BRZ ? 0x85 : 0x84 }, 2);
+        emit_fixup(e, target);
+        emit_jump(e, addr, next);
+        return;
+    }
+
+    /* Every ALU op that gets here sets the status from its result. */
+    emit(e, (const unsigned char []) { 0x0F, 0x94, 0xC2 }, 3);  /* setz dl */
+    emit_jump(e, addr, next);
+}
+
+
+/* Emits a MOV between each processor register and its slot in [rdi]. */
+static void emit_register_moves(Emitter *e, unsigned char opcode) {
+    int n;
+
+    for (n = 0; n < NUM_REGISTERS; n++) {
+        /* REX.R, then "mov r32, [rdi + 4n]" (8B) or the reverse (89). */
+        emit(e, (const unsigned char []) {
+            0x44, opcode, 0x47 | (n << 3), 4 * n }, 4);
+    }
+}
+
+
+/*!
+ * Compiles the program in the instruction store into native code.  Returns
+ * NULL if this isn't an x86-64 host, or if executable memory can't be had.
+ * The result should be freed with jit_free().
+ */
+JitProgram * jit_compile(InstructionStore *is) {
+#if defined(__x86_64__)
+    FastOp ops[FAST_PROGRAM_LENGTH];
+    JitProgram *jit;
+    Emitter *e;
+    size_t done_offset, timeout_offset;
+    int addr, i;
+
+    jit = malloc(sizeof(JitProgram));
+    e = malloc(sizeof(Emitter));
+    if (!jit || !e) {
+        fprintf(stderr, "Out of memory compiling the program!\n");
+        exit(11);
+    }
+    memset(e, 0, sizeof(Emitter));
+
+    jit->size = FAST_PROGRAM_LENGTH * JIT_MAX_OP_BYTES + JIT_EXTRA_BYTES;
+    jit->code = mmap(NULL, jit->size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (jit->code == MAP_FAILED) {
+        free(jit);
+        free(e);
+        return NULL;
+    }
+    e->code = jit->code;
+
+    fast_decode(is, ops);
+
+    /* Prologue:  save r12-r15, load the registers, and clear the status. */
+    emit(e, (const unsigned char []) {
+        0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57 }, 8);
+    emit_register_moves(e, 0x8B);
+    emit(e, (const unsigned char []) { 0x31, 0xD2 }, 2);     /* xor edx, edx */
+
+    for (addr = 0; addr < FAST_PROGRAM_LENGTH; addr++)
+        emit_op(e, ops, addr);
+
+    /* DONE:  return the clocks left, which the guard has already counted
+     * DONE's clock out of.
+     */
+    done_offset = e->length;
+    emit(e, (const unsigned char []) { 0x48, 0x89, 0xF0 }, 3); /* rax = rsi */
+    emit(e, (const unsigned char []) { 0xEB, 7 }, 2);           /* jmp store */
+
+    /* Out of time:  return -1. */
+    timeout_offset = e->length;
+    emit(e, (const unsigned char []) {
+        0x48, 0xC7, 0xC0, 0xFF, 0xFF, 0xFF, 0xFF }, 7);   /* mov rax, -1 */
+
+    /* Store the registers, restore r12-r15, and return. */
+    emit_register_moves(e, 0x89);
+    emit(e, (const unsigned char []) {
+        0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0xC3 }, 9);
+
+    /* Now that everything has an address, patch the jumps. */
+    for (i = 0; i < e->num_fixups; i++) {
+        addr = e->fixups[i].addr;
+        patch(e, e->fixups[i].offset, addr == FAST_PROGRAM_LENGTH ?
+              done_offset : e->op_offset[addr]);
+    }
+    for (i = 0; i < e->num_timeout_fixups; i++)
+        patch(e, e->timeout_fixups[i], timeout_offset);
+
+    free(e);
+
+    /* The code is never writable and executable at the same time. */
+    if (mprotect(jit->code, jit->size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(jit->code, jit->size);
+        free(jit);
+        return NULL;
+    }
+
+    jit->entry = (long (*)(uint32_t *, long)) jit->code;
+    return jit;
+#else
+    (void) is;
+    return NULL;
+#endif
+}
+
+
+/*! Frees a compiled program. */
+void jit_free(JitProgram *jit) {
+    munmap(jit->code, jit->size);
+    free(jit);
+}
+
+
+/*!
+ * Runs a compiled program against the register file, the way run() does.  The
+ * program is given the same number of clocks as run() gives it when
+ * "max_time" is MAX_EXECUTE_TIME.  Returns the number of instructions
+ * executed, including the final DONE.
+ */
+int jit_run(JitProgram *jit, RegisterFile *rf, int max_time) {
+    long left;
+
+    printf("Running processor (JIT).\n\n");
+
+    printf("T=0\tRegister File: ");
+    rfprint(stdout, rf);
+
+    left = jit->entry(rf->rfmem, max_time - 1);
+
+    printf("Register File: ");
+    rfprint(stdout, rf);
+
+    printf("\n");
+    if (left < 0) {
+        printf("ERROR:  Max execute time reached.\n"
+               "Does your program have an infinite loop in it?\n");
+        return max_time - 1;
+    }
+
+    printf("Program terminated normally.\n");
+    return max_time - 1 - left;
+}
@@ -0,0 +1,42 @@
+/*! \file
+ *
+ * This file contains the declarations for the JIT compiler of the branching
+ * processor, which translates a program in the instruction store into native
+ * x86-64 code.  The compiled program can then be run any number of times
+ * against different register files, ending with the same register file that
+ * the bus-level model would.
+ */
+
+
+#ifndef JIT_H
+#define JIT_H
+
+
+#include "instruction_store.h"
+#include "register_file.h"
+
+
+/*!
+ * A compiled program.  The code lives in its own mapping, which is writable
+ * while the program is compiled, and only executable afterwards.
+ */
+typedef struct JitProgram {
+    unsigned char *code;   /*!< The start of the mapping. */
+    size_t size;           /*!< The size of the mapping, in bytes. */
+
+    /*!
+     * The compiled code.  It runs the program against "regs" for at most
+     * "clocks" instructions, and returns how many of those clocks were left
+     * when DONE ran, or -1 if the program ran out of clocks first.
+     */
+    long (*entry)(uint32_t *regs, long clocks);
+} JitProgram;
+
+
+/* Documentation appears in jit.c. */
+JitProgram * jit_compile(InstructionStore *is);
+void jit_free(JitProgram *jit);
+int jit_run(JitProgram *jit, RegisterFile *rf, int max_time);
+
+
+#endif /* JIT_H */
@@ -8,6 +8,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "instruction_store.h"
 #include "register_file.h"
@@ -15,26 +16,70 @@
 
 #ifdef BRANCHING
 #include "branching_processor.h"
+#include "fast_processor.h"
+#include "jit.h"
 #else
 #include "simple_processor.h"
 #endif
 
 
 
+static void usage() {
+    fprintf(stderr, "Usage: run [-f | -j [-n max-time]] instruction-file "
+                    "initial-register-file-contents "
+                    "final-register-file-contents\n");
+#ifdef BRANCHING
+    fprintf(stderr, "\t-f runs the predecoded fast mode instead of the "
+                    "bus-level model\n"
+                    "\t-j compiles the program to native code and runs that\n"
+                    "\t-n sets the -f or -j max execute time (default "
+                    "%d)\n", MAX_EXECUTE_TIME);
+#endif
+    exit(1);
+}
+
+
 /*! Run the processor against an initial state and set of instructions. */
 int main (int argc,  char **argv) {
     FILE *ifd;     /* File for loading the instructions from. */
     FILE *rifd;    /* File for loading the initial register-file from. */
     FILE *rofd;    /* File for storing the final register-file to. */
     Processor *proc;  /* The processor state to run with. */
+    int fast = 0;     /* Whether to run in fast mode. */
+    int jit = 0;      /* Whether to run the program compiled. */
+    int max_time = 0; /* The -f or -j max execute time, if given. */
+    int c;
 
-    if (argc < 4) {
-        fprintf(stderr, "Usage: run instruction-file "
-                        "initial-register-file-contents "
-                        "final-register-file-contents\n");
-        exit(1);
+    while ((c = getopt(argc, argv, "fjn:")) != -1) {
+        switch (c) {
+#ifdef BRANCHING
+        case 'f':
+            fast = 1;
+            break;
+
+        case 'j':
+            jit = 1;
+            break;
+
+        case 'n':
+            max_time = atoi(optarg);
+            if (max_time < 1)
+                usage();
+            break;
+#endif
+
+        default:
+            usage();
+        }
     }
 
+    /* A longer time only makes sense for the fast mode and the JIT; the
+     * bus-level model prints every clock.
+     */
+    if (argc - optind < 3 || (fast && jit) || (max_time != 0 && !fast && !jit))
+        usage();
+    argv += optind - 1;
+
     proc = build_processor();
 
     ifd = fopen(argv[1], "r");
@@ -60,7 +105,33 @@ int main (int argc,  char **argv) {
         exit(2);
     }
 
+#ifdef BRANCHING
+    if (max_time == 0)
+        max_time = MAX_EXECUTE_TIME;
+
+    if (jit) {
+        JitProgram *program = jit_compile(proc->is);
+
+        /* Not every host can run the compiled code, but the fast mode gives
+         * the same answer anywhere.
+         */
+        if (program) {
+            jit_run(program, proc->rf, max_time);
+            jit_free(program);
+        }
+        else {
+            fprintf(stderr, "Can't compile the program here; "
+                            "using the fast mode instead.\n");
+            fast_run(proc->is, proc->rf, max_time);
+        }
+    }
+    else if (fast)
+        fast_run(proc->is, proc->rf, max_time);
+    else
+        run(proc);
+#else
     run(proc);
+#endif
 
     write_register_file_to_fd(rofd, proc->rf);
     fclose(rofd);